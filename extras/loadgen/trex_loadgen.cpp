@@ -0,0 +1,606 @@
+// trex_loadgen.cpp — synthetic LOOT/DROP fleet for sizing a T-Rex server.
+//
+// Emulates N loot and M drop stations in one process, all speaking the real
+// protocol through the Transport API (host backend): HELLO at start, HEARTBEAT,
+// LOOT_HOLD_START -> LOOT_TICKs -> LOOT_HOLD_STOP, MG_RESULT at loot stations
+// and DROP_REQUEST at drop stations, each as a Poisson process with the given
+// per-station rate. It measures request -> answer latency for
+//   hello  HELLO           -> STATION_UPDATE (same stationId)
+//   hold   LOOT_HOLD_START -> LOOT_HOLD_ACK  (same holdId)
+//   stop   LOOT_HOLD_STOP  -> HOLD_END       (same holdId)
+//   drop   DROP_REQUEST    -> DROP_RESULT    (oldest open request on that reader;
+//                                             the result doesn't name the station)
+// and writes one JSON document: throughput, p50/p99/p999/max per pair, and
+// every way a request or message got lost.
+//
+// The server is whatever listens on the host group and channel: a host build
+// of the game, or the reference server built in here (--serve in another
+// terminal, or --spawn-server to fork it for a self-contained run).
+//
+// Build (from this directory):
+//   g++ -std=c++17 -O2 -DTREX_USE_HOST=1 -I../../src trex_loadgen.cpp ../../src/TrexTransportHost.cpp ../../src/TrexTransportCommon.cpp -o trex_loadgen
+//
+// Examples:
+//   ./trex_loadgen --spawn-server --stations 40 --seconds 20 > run.json
+//   ./trex_loadgen --spawn-server --stations 10,20,40,80,160 --hold-hz 1 --loss 2 --json ramp.json
+//   ./trex_loadgen --serve --channel 6          # reference server only
+//
+// A comma list for --stations runs one step per count (same server) and
+// reports each step. Exit status is non-zero if a malformed message arrived.
+
+#include "TrexBuildConfig.h"
+#include "TrexMsgRegistry.h"
+#include "TrexProtocol.h"
+#include "TrexStats.h"
+#include "TrexTransport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <random>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+static uint64_t nowUs() {
+  using namespace std::chrono;
+  static const auto t0 = steady_clock::now();
+  return (uint64_t)duration_cast<microseconds>(steady_clock::now() - t0).count();
+}
+
+// ---------------------------------------------------------------- options
+struct LoadOptions {
+  std::vector<int> stations{20};   // loot stations per step
+  int      drops       = 4;        // drop stations
+  int      seconds     = 10;       // per step
+  double   holdHz      = 0.5;      // per loot station, while idle
+  uint32_t holdMs      = 1500;     // hold time before LOOT_HOLD_STOP
+  double   dropHz      = 0.2;      // per drop station
+  double   mgHz        = 0.05;     // MG_RESULT per loot station
+  uint32_t heartbeatMs = 1000;
+  uint32_t timeoutMs   = 1000;     // no answer by then = lost request
+  double   lossPct     = 0.0;      // per message, each direction
+  uint8_t  channel     = 6;
+  bool     compact     = false;
+  uint32_t statusHz    = 10;       // reference server GAME_STATUS rate
+  uint32_t seed        = 1;
+  const char* json     = nullptr;  // default stdout
+  bool     serve       = false;
+  bool     spawn       = false;
+};
+
+static void usage() {
+  fprintf(stderr,
+    "usage: trex_loadgen [--stations N[,N...]] [--drops M] [--seconds S] [--hold-hz HZ]\n"
+    "                    [--hold-ms MS] [--drop-hz HZ] [--mg-hz HZ] [--heartbeat-ms MS]\n"
+    "                    [--timeout-ms MS] [--loss PCT] [--channel CH] [--compact]\n"
+    "                    [--status-hz HZ] [--seed N] [--json FILE] [--spawn-server]\n"
+    "       trex_loadgen --serve [--channel CH] [--compact] [--status-hz HZ]\n");
+}
+
+static bool parseArgs(int argc, char** argv, LoadOptions& o) {
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    auto take = [&](const char* name) { if (strcmp(a, name) == 0 && v) { ++i; return true; } return false; };
+    if (take("--stations")) {
+      o.stations.clear();
+      for (const char* p = v; *p; ) {
+        o.stations.push_back(atoi(p));
+        p = strchr(p, ',');
+        if (!p) break;
+        ++p;
+      }
+    }
+    else if (take("--drops"))        o.drops       = atoi(v);
+    else if (take("--seconds"))      o.seconds     = atoi(v);
+    else if (take("--hold-hz"))      o.holdHz      = atof(v);
+    else if (take("--hold-ms"))      o.holdMs      = (uint32_t)atoi(v);
+    else if (take("--drop-hz"))      o.dropHz      = atof(v);
+    else if (take("--mg-hz"))        o.mgHz        = atof(v);
+    else if (take("--heartbeat-ms")) o.heartbeatMs = (uint32_t)atoi(v);
+    else if (take("--timeout-ms"))   o.timeoutMs   = (uint32_t)atoi(v);
+    else if (take("--loss"))         o.lossPct     = atof(v);
+    else if (take("--channel"))      o.channel     = (uint8_t)atoi(v);
+    else if (take("--status-hz"))    o.statusHz    = (uint32_t)atoi(v);
+    else if (take("--seed"))         o.seed        = (uint32_t)atoi(v);
+    else if (take("--json"))         o.json        = v;
+    else if (strcmp(a, "--compact") == 0)      o.compact = true;
+    else if (strcmp(a, "--serve") == 0)        o.serve   = true;
+    else if (strcmp(a, "--spawn-server") == 0) o.spawn   = true;
+    else { usage(); return false; }
+  }
+  int most = 0;
+  for (int n : o.stations) {
+    if (n < 0) { usage(); return false; }
+    most = std::max(most, n);
+  }
+  if (o.stations.empty() || o.drops < 0 || most + o.drops < 1 || most + o.drops > 250 ||
+      o.seconds < 1 || o.timeoutMs == 0) {
+    usage();
+    return false;
+  }
+  return true;
+}
+
+static bool initTransport(const LoadOptions& o, uint8_t stationId, RxHandler rx) {
+  TransportConfig cfg{};
+  cfg.wifiChannel    = o.channel;
+  cfg.txFramed       = true;
+  cfg.wireVersion    = o.compact ? TREX_WIRE_VERSION_COMPACT : TREX_WIRE_VERSION;
+  cfg.rxAcceptLegacy = true;
+  cfg.stationId      = stationId;
+  if (Transport::init(cfg, rx)) return true;
+  fprintf(stderr, "Transport::init failed\n");
+  return false;
+}
+
+// ---------------------------------------------------------------- reference server
+// Just enough game to answer every request the way the real server does; no
+// rules, so its own cost stays small next to the transport's.
+namespace RefServer {
+
+struct Hold { uint8_t sid; uint8_t carried; uint64_t nextTickUs; };
+
+static volatile sig_atomic_t            g_stop = 0;
+static std::unordered_map<uint32_t, Hold> g_holds;
+static uint32_t                         g_teamScore = 0;
+static uint16_t                         g_inventory = 0;
+static constexpr uint8_t                kTickHz     = 2;
+static constexpr uint8_t                kMaxCarry   = 8;
+
+template <class P>
+static void reply(uint8_t sid, MsgType t, const P& p) {
+  static TxFrame f;
+  *f.begin<P>(t, 0) = p;
+  Transport::sendToStation(sid, f);
+}
+
+struct Handler {
+  void on(const MsgHeader& h, const HelloPayload&) {
+    StationUpdatePayload u{h.srcStationId, g_inventory, 400};
+    reply(h.srcStationId, MsgType::STATION_UPDATE, u);
+  }
+  void on(const MsgHeader& h, const LootHoldStartPayload& s) {
+    LootHoldAckPayload a{};
+    a.holdId = s.holdId; a.accepted = 1; a.rateHz = kTickHz; a.maxCarry = kMaxCarry;
+    a.inventory = g_inventory; a.capacity = 400;
+    g_holds[s.holdId] = Hold{h.srcStationId, 0, nowUs() + 1000000 / kTickHz};
+    reply(h.srcStationId, MsgType::LOOT_HOLD_ACK, a);
+  }
+  void on(const MsgHeader& h, const LootHoldStopPayload& s) {
+    g_holds.erase(s.holdId);
+    reply(h.srcStationId, MsgType::HOLD_END, HoldEndPayload{s.holdId, 0});
+  }
+  void on(const MsgHeader& h, const DropRequestPayload& d) {
+    g_teamScore += 1;
+    reply(h.srcStationId, MsgType::DROP_RESULT, DropResultPayload{1, g_teamScore, d.readerIndex});
+  }
+  void on(const MsgHeader&, const MgResultPayload& m) { g_teamScore += m.success; }
+};
+
+// A hold whose LOOT_HOLD_STOP never arrives ends itself once the station
+// carries its maximum, so lost requests don't pile up.
+static void tick(uint64_t now) {
+  for (auto it = g_holds.begin(); it != g_holds.end();) {
+    Hold& h = it->second;
+    if ((int64_t)(now - h.nextTickUs) < 0) { ++it; continue; }
+    h.nextTickUs += 1000000 / kTickHz;
+    ++h.carried;
+    ++g_inventory;
+    reply(h.sid, MsgType::LOOT_TICK, LootTickPayload{it->first, h.carried, g_inventory});
+    if (h.carried < kMaxCarry) { ++it; continue; }
+    reply(h.sid, MsgType::HOLD_END, HoldEndPayload{it->first, 1});
+    it = g_holds.erase(it);
+  }
+}
+
+static int run(const LoadOptions& o) {
+  static Handler                handler;
+  static MsgDispatcher<Handler> rx(handler);
+  if (!initTransport(o, 0, [](const uint8_t* d, uint16_t n) { rx.dispatch(d, n); })) return 2;
+  signal(SIGTERM, [](int) { g_stop = 1; });
+  signal(SIGINT,  [](int) { g_stop = 1; });
+  const uint64_t statusUs = o.statusHz ? 1000000 / o.statusHz : 0;
+  uint64_t nextStatus = nowUs();
+  while (!g_stop) {
+    const uint64_t now = nowUs();
+    Transport::loop();
+    tick(now);
+    if (statusUs && (int64_t)(now - nextStatus) >= 0) {
+      nextStatus += statusUs;
+      GameStatusPayload gs{};
+      gs.teamScore = g_teamScore;
+      static TxFrame f;
+      *f.begin<GameStatusPayload>(MsgType::GAME_STATUS, 0) = gs;
+      Transport::broadcast(f);
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+  Transport::loop();
+  return 0;
+}
+
+} // namespace RefServer
+
+// ---------------------------------------------------------------- load side
+enum Pair : uint8_t { PAIR_HELLO, PAIR_HOLD, PAIR_STOP, PAIR_DROP, PAIR_COUNT };
+static const char* const kPairName[PAIR_COUNT] = {"hello", "hold", "stop", "drop"};
+
+struct Station {
+  enum HoldState : uint8_t { IDLE, WAIT_ACK, HOLDING, WAIT_END };
+  uint8_t   id      = 0;
+  bool      drop    = false;
+  uint16_t  seq     = 0;
+  HoldState hold    = IDLE;
+  uint32_t  holdId  = 0;
+  uint32_t  holdNo  = 0;
+  uint64_t  sentUs  = 0;        // current hold request / stop
+  uint64_t  helloUs = 0;        // 0 = no HELLO open
+  uint64_t  dropUs  = 0;        // 0 = no DROP_REQUEST open
+  uint32_t  dropNo  = 0;
+  uint64_t  nextHoldUs = 0, nextDropUs = 0, nextMgUs = 0, nextBeatUs = 0, holdEndUs = 0;
+};
+
+struct RunStats {
+  uint64_t txMsgs = 0, rxMsgs = 0;
+  uint64_t txByType[256] = {}, rxByType[256] = {};
+  std::vector<uint32_t> latUs[PAIR_COUNT];
+  uint64_t timeouts[PAIR_COUNT] = {};
+  uint64_t sent[PAIR_COUNT]     = {};
+  uint64_t lostUp = 0, lostDown = 0, sendFail = 0;
+  uint64_t denied = 0, ticks = 0, unmatched = 0, malformed = 0;
+  double   seconds = 0;
+};
+
+class Fleet {
+public:
+  Fleet(const LoadOptions& o, int loot) : opt_(o), rng_(o.seed + (uint32_t)loot) {
+    st_.resize((size_t)(loot + o.drops));
+    const uint64_t now = nowUs();
+    for (size_t i = 0; i < st_.size(); ++i) {
+      Station& s   = st_[i];
+      s.id         = (uint8_t)(i + 1);
+      s.drop       = (int)i >= loot;
+      s.nextBeatUs = now + (uint64_t)(unit(rng_) * o.heartbeatMs * 1000);
+      s.nextHoldUs = now + next(o.holdHz);
+      s.nextDropUs = now + next(o.dropHz);
+      s.nextMgUs   = now + next(o.mgHz);
+      byId_[s.id]  = &s;
+    }
+  }
+
+  // Sends HELLO from every station, then runs the load for opt.seconds.
+  RunStats run() {
+    const uint64_t start = nowUs(), end = start + (uint64_t)opt_.seconds * 1000000;
+    for (Station& s : st_) {
+      HelloPayload hp{};
+      hp.stationType = (uint8_t)(s.drop ? StationType::DROP : StationType::LOOT);
+      hp.stationId   = s.id;
+      hp.fwMajor     = 1;
+      hp.wifiChannel = opt_.channel;
+      if (send(s, MsgType::HELLO, hp)) s.helloUs = nowUs();
+      ++r_.sent[PAIR_HELLO];
+    }
+    for (uint64_t now = nowUs(); now < end; now = nowUs()) {
+      Transport::loop();
+      for (Station& s : st_) step(s, now);
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    // Let answers to the last requests arrive; new ones are no longer sent.
+    for (const uint64_t drain = nowUs() + (uint64_t)opt_.timeoutMs * 1000; nowUs() < drain;) {
+      Transport::loop();
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    for (Station& s : st_) expireAll(s);
+    r_.seconds = (end - start) / 1e6;
+    return std::move(r_);
+  }
+
+  void onRx(const uint8_t* data, uint16_t len) {
+    MsgHeader h;
+    if (len < sizeof(h)) { ++r_.malformed; return; }
+    memcpy(&h, data, sizeof(h));
+    if ((size_t)h.payloadLen + sizeof(h) > len) { ++r_.malformed; return; }
+    if (h.srcStationId != 0) return;   // another load generator
+    if (lose()) { ++r_.lostDown; return; }
+    ++r_.rxMsgs;
+    ++r_.rxByType[h.type];
+    const uint8_t* p   = data + sizeof(h);
+    const uint64_t now = nowUs();
+    switch ((MsgType)h.type) {
+      case MsgType::STATION_UPDATE: {
+        StationUpdatePayload u;
+        if (!read(h, p, u)) return;
+        Station* s = byId(u.stationId);
+        if (s && s->helloUs) { done(PAIR_HELLO, now - s->helloUs); s->helloUs = 0; }
+        break;
+      }
+      case MsgType::LOOT_HOLD_ACK: {
+        LootHoldAckPayload a;
+        if (!read(h, p, a)) return;
+        Station* s = byHold(a.holdId);
+        if (!s || s->hold != Station::WAIT_ACK) { ++r_.unmatched; return; }
+        done(PAIR_HOLD, now - s->sentUs);
+        if (a.accepted) { s->hold = Station::HOLDING; s->holdEndUs = now + (uint64_t)opt_.holdMs * 1000; }
+        else            { ++r_.denied; idle(*s, now); }
+        break;
+      }
+      case MsgType::LOOT_TICK: {
+        LootTickPayload t;
+        if (!read(h, p, t)) return;
+        Station* s = byHold(t.holdId);
+        if (s && s->hold == Station::HOLDING) ++r_.ticks;
+        break;
+      }
+      case MsgType::HOLD_END: {
+        HoldEndPayload e;
+        if (!read(h, p, e)) return;
+        Station* s = byHold(e.holdId);
+        if (!s || s->hold == Station::IDLE || s->hold == Station::WAIT_ACK) { ++r_.unmatched; return; }
+        if (s->hold == Station::WAIT_END) done(PAIR_STOP, now - s->sentUs);   // else ended by the server
+        idle(*s, now);
+        break;
+      }
+      case MsgType::DROP_RESULT: {
+        DropResultPayload d;
+        if (!read(h, p, d)) return;
+        auto& q = openDrops_[d.readerIndex & 3];
+        while (!q.empty() && (!q.front().first->dropUs || q.front().first->dropNo != q.front().second)) q.pop_front();
+        if (q.empty()) { ++r_.unmatched; return; }
+        Station& s = *q.front().first;
+        q.pop_front();
+        done(PAIR_DROP, now - s.dropUs);
+        s.dropUs = 0;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+private:
+  static std::uniform_real_distribution<double>& unitDist() { static std::uniform_real_distribution<double> d(0.0, 1.0); return d; }
+  double   unit(std::mt19937& r) { return unitDist()(r); }
+  // Exponential inter-arrival time in µs; "never" for rate 0.
+  uint64_t next(double hz) { return hz > 0 ? (uint64_t)(-std::log(1.0 - unit(rng_)) / hz * 1e6) : UINT64_MAX / 2; }
+  bool     lose() { return opt_.lossPct > 0 && unit(rng_) * 100.0 < opt_.lossPct; }
+
+  template <class P>
+  static bool read(const MsgHeader& h, const uint8_t* p, P& out) {
+    if (h.payloadLen < msgMinLenOf(h.type)) return false;
+    memset(&out, 0, sizeof(out));
+    memcpy(&out, p, std::min<size_t>(h.payloadLen, sizeof(out)));
+    return true;
+  }
+  static uint16_t msgMinLenOf(uint8_t type) {
+    switch ((MsgType)type) {
+      case MsgType::STATION_UPDATE: return msgMinLen<MsgType::STATION_UPDATE>();
+      case MsgType::LOOT_HOLD_ACK:  return msgMinLen<MsgType::LOOT_HOLD_ACK>();
+      case MsgType::LOOT_TICK:      return msgMinLen<MsgType::LOOT_TICK>();
+      case MsgType::HOLD_END:       return msgMinLen<MsgType::HOLD_END>();
+      case MsgType::DROP_RESULT:    return msgMinLen<MsgType::DROP_RESULT>();
+      default:                      return 0;
+    }
+  }
+
+  Station* byId(uint8_t id) { return byId_[id]; }
+  Station* byHold(uint32_t holdId) {
+    Station* s = byId((uint8_t)(holdId >> 24));
+    return s && s->holdId == holdId ? s : nullptr;
+  }
+
+  void done(Pair p, uint64_t us) { r_.latUs[p].push_back((uint32_t)std::min<uint64_t>(us, UINT32_MAX)); }
+
+  void idle(Station& s, uint64_t now) {
+    s.hold       = Station::IDLE;
+    s.nextHoldUs = now + next(opt_.holdHz);
+  }
+
+  // Messages carry the emulated station's id and its own seq; the transport
+  // only adds the wire header.
+  template <class P>
+  bool send(Station& s, MsgType t, const P& p) {
+    uint8_t   buf[sizeof(MsgHeader) + sizeof(P)];
+    MsgHeader h{TREX_PROTO_VERSION, (uint8_t)t, s.id, 0, (uint16_t)sizeof(P), s.seq++};
+    memcpy(buf, &h, sizeof(h));
+    memcpy(buf + sizeof(h), &p, sizeof(P));
+    if (lose()) { ++r_.lostUp; return true; }   // sent into the void; answers time out
+    if (!Transport::sendToServer(buf, sizeof(buf))) { ++r_.sendFail; return false; }
+    ++r_.txMsgs;
+    ++r_.txByType[(uint8_t)t];
+    return true;
+  }
+  bool sendEmpty(Station& s, MsgType t) {
+    MsgHeader h{TREX_PROTO_VERSION, (uint8_t)t, s.id, 0, 0, s.seq++};
+    if (lose()) { ++r_.lostUp; return true; }
+    if (!Transport::sendToServer((const uint8_t*)&h, sizeof(h))) { ++r_.sendFail; return false; }
+    ++r_.txMsgs;
+    ++r_.txByType[(uint8_t)t];
+    return true;
+  }
+
+  void expire(Station& s, uint64_t now) {
+    const uint64_t to = (uint64_t)opt_.timeoutMs * 1000;
+    if (s.helloUs && now - s.helloUs > to) { ++r_.timeouts[PAIR_HELLO]; s.helloUs = 0; }
+    if (s.dropUs && now - s.dropUs > to)   { ++r_.timeouts[PAIR_DROP];  s.dropUs  = 0; }
+    if (s.hold == Station::WAIT_ACK && now - s.sentUs > to) { ++r_.timeouts[PAIR_HOLD]; idle(s, now); }
+    if (s.hold == Station::WAIT_END && now - s.sentUs > to) { ++r_.timeouts[PAIR_STOP]; idle(s, now); }
+  }
+  void expireAll(Station& s) {
+    if (s.helloUs) ++r_.timeouts[PAIR_HELLO];
+    if (s.dropUs)  ++r_.timeouts[PAIR_DROP];
+    if (s.hold == Station::WAIT_ACK) ++r_.timeouts[PAIR_HOLD];
+    if (s.hold == Station::WAIT_END) ++r_.timeouts[PAIR_STOP];
+  }
+
+  void step(Station& s, uint64_t now) {
+    expire(s, now);
+    if ((int64_t)(now - s.nextBeatUs) >= 0) {
+      s.nextBeatUs += (uint64_t)opt_.heartbeatMs * 1000;
+      sendEmpty(s, MsgType::HEARTBEAT);
+    }
+    if (s.drop) {
+      if (!s.dropUs && (int64_t)(now - s.nextDropUs) >= 0) {
+        s.nextDropUs = now + next(opt_.dropHz);
+        DropRequestPayload d{};
+        d.uid.len     = 4;
+        d.uid.bytes[0] = s.id;
+        memcpy(d.uid.bytes + 1, &s.dropNo, 3);
+        d.readerIndex = (uint8_t)(s.dropNo & 3);
+        ++s.dropNo;
+        ++r_.sent[PAIR_DROP];
+        if (send(s, MsgType::DROP_REQUEST, d)) {
+          s.dropUs = now;
+          openDrops_[d.readerIndex].emplace_back(&s, s.dropNo);
+        }
+      }
+      return;
+    }
+    if ((int64_t)(now - s.nextMgUs) >= 0) {
+      s.nextMgUs = now + next(opt_.mgHz);
+      MgResultPayload m{};
+      m.uid.len   = 4;
+      m.stationId = s.id;
+      m.success   = unit(rng_) < 0.5;
+      send(s, MsgType::MG_RESULT, m);
+    }
+    if (s.hold == Station::IDLE && (int64_t)(now - s.nextHoldUs) >= 0) {
+      s.holdId = ((uint32_t)s.id << 24) | (++s.holdNo & 0xFFFFFF);
+      LootHoldStartPayload hs{};
+      hs.holdId    = s.holdId;
+      hs.stationId = s.id;
+      hs.uid.len   = 4;
+      memcpy(hs.uid.bytes, &hs.holdId, 4);
+      ++r_.sent[PAIR_HOLD];
+      if (send(s, MsgType::LOOT_HOLD_START, hs)) { s.hold = Station::WAIT_ACK; s.sentUs = now; }
+      else idle(s, now);
+    } else if (s.hold == Station::HOLDING && (int64_t)(now - s.holdEndUs) >= 0) {
+      ++r_.sent[PAIR_STOP];
+      if (send(s, MsgType::LOOT_HOLD_STOP, LootHoldStopPayload{s.holdId})) { s.hold = Station::WAIT_END; s.sentUs = now; }
+    }
+  }
+
+  const LoadOptions&   opt_;
+  std::mt19937         rng_;
+  std::vector<Station> st_;
+  Station*             byId_[256] = {};
+  std::deque<std::pair<Station*, uint32_t>> openDrops_[4];   // (station, dropNo) per reader
+  RunStats             r_;
+};
+
+// ---------------------------------------------------------------- report
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t k = (size_t)std::ceil(p * sorted.size());   // nearest rank
+  return sorted[k ? k - 1 : 0];
+}
+
+static void writeTypes(FILE* f, const uint64_t* byType) {
+  bool first = true;
+  fprintf(f, "{");
+  for (int t = 0; t < 256; ++t) {
+    if (!byType[t]) continue;
+    const char* name = msgTypeName((uint8_t)t);
+    if (name) fprintf(f, "%s\"%s\": %llu", first ? "" : ", ", name, (unsigned long long)byType[t]);
+    else      fprintf(f, "%s\"type%d\": %llu", first ? "" : ", ", t, (unsigned long long)byType[t]);
+    first = false;
+  }
+  fprintf(f, "}");
+}
+
+static void writeRun(FILE* f, int loot, int drops, RunStats& r) {
+  const double s = r.seconds;
+  fprintf(f, "    {\n      \"stations\": %d, \"loot\": %d, \"drop\": %d, \"seconds\": %.3f,\n",
+          loot + drops, loot, drops, s);
+  fprintf(f, "      \"tx\": {\"msgs\": %llu, \"msgsPerSec\": %.1f, \"byType\": ",
+          (unsigned long long)r.txMsgs, r.txMsgs / s);
+  writeTypes(f, r.txByType);
+  fprintf(f, "},\n      \"rx\": {\"msgs\": %llu, \"msgsPerSec\": %.1f, \"byType\": ",
+          (unsigned long long)r.rxMsgs, r.rxMsgs / s);
+  writeTypes(f, r.rxByType);
+  fprintf(f, "},\n      \"latencyUs\": {\n");
+  for (int p = 0; p < PAIR_COUNT; ++p) {
+    auto& v = r.latUs[p];
+    std::sort(v.begin(), v.end());
+    fprintf(f, "        \"%s\": {\"sent\": %llu, \"answered\": %zu, \"timeouts\": %llu, "
+               "\"p50\": %u, \"p99\": %u, \"p999\": %u, \"max\": %u}%s\n",
+            kPairName[p], (unsigned long long)r.sent[p], v.size(), (unsigned long long)r.timeouts[p],
+            percentile(v, 0.50), percentile(v, 0.99), percentile(v, 0.999), v.empty() ? 0 : v.back(),
+            p + 1 < PAIR_COUNT ? "," : "");
+  }
+  const TrexStats::Block& ts = TrexStats::get();
+  uint32_t rxDrops = 0;
+  for (int i = 0; i < TrexStats::RXDROP_COUNT; ++i) rxDrops += TrexStats::read(ts.rxDrop[i]);
+  uint32_t txErrs = 0;
+  for (int i = 0; i < TrexStats::TXERR_COUNT; ++i) txErrs += TrexStats::read(ts.txErr[i]);
+  fprintf(f, "      },\n      \"drops\": {\"lostUp\": %llu, \"lostDown\": %llu, \"sendFailures\": %llu, "
+             "\"transportRxDrops\": %u, \"transportTxErrors\": %u, \"unmatched\": %llu, \"malformed\": %llu, "
+             "\"denied\": %llu},\n",
+          (unsigned long long)r.lostUp, (unsigned long long)r.lostDown, (unsigned long long)r.sendFail,
+          rxDrops, txErrs, (unsigned long long)r.unmatched, (unsigned long long)r.malformed,
+          (unsigned long long)r.denied);
+  fprintf(f, "      \"lootTicks\": %llu\n    }", (unsigned long long)r.ticks);
+}
+
+// ---------------------------------------------------------------- main
+static Fleet* g_fleet = nullptr;
+
+int main(int argc, char** argv) {
+  LoadOptions opt;
+  if (!parseArgs(argc, argv, opt)) return 2;
+  if (opt.serve) return RefServer::run(opt);
+
+  pid_t server = 0;
+  if (opt.spawn) {
+    server = fork();
+    if (server == 0) _exit(RefServer::run(opt));
+    if (server < 0) { perror("fork"); return 2; }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));   // server socket up
+  }
+  // stationId 0xFE: the fleet's own ids travel in each MsgHeader.
+  if (!initTransport(opt, 0xFE, [](const uint8_t* d, uint16_t n) { if (g_fleet) g_fleet->onRx(d, n); })) return 2;
+
+  FILE* out = opt.json ? fopen(opt.json, "w") : stdout;
+  if (!out) { perror(opt.json); return 2; }
+  fprintf(out, "{\n  \"tool\": \"trex_loadgen\", \"format\": 1,\n");
+  fprintf(out, "  \"config\": {\"drops\": %d, \"seconds\": %d, \"holdHz\": %g, \"holdMs\": %u, \"dropHz\": %g, "
+               "\"mgHz\": %g, \"heartbeatMs\": %u, \"timeoutMs\": %u, \"lossPct\": %g, \"channel\": %u, "
+               "\"compact\": %s, \"seed\": %u, \"server\": \"%s\"},\n  \"runs\": [\n",
+          opt.drops, opt.seconds, opt.holdHz, opt.holdMs, opt.dropHz, opt.mgHz, opt.heartbeatMs,
+          opt.timeoutMs, opt.lossPct, opt.channel, opt.compact ? "true" : "false", opt.seed,
+          opt.spawn ? "reference" : "external");
+
+  uint64_t malformed = 0;
+  for (size_t i = 0; i < opt.stations.size(); ++i) {
+    const int loot = opt.stations[i];
+    TrexStats::reset();
+    Fleet fleet(opt, loot);
+    g_fleet = &fleet;
+    RunStats r = fleet.run();
+    g_fleet = nullptr;
+    malformed += r.malformed;
+    writeRun(out, loot, opt.drops, r);
+    fprintf(out, "%s\n", i + 1 < opt.stations.size() ? "," : "");
+    fflush(out);
+    fprintf(stderr, "%d stations: %.0f msgs/s out, %.0f in, hold ack p50=%uus p99=%uus, %llu timeouts\n",
+            loot + opt.drops, r.txMsgs / r.seconds, r.rxMsgs / r.seconds,
+            percentile(r.latUs[PAIR_HOLD], 0.50), percentile(r.latUs[PAIR_HOLD], 0.99),
+            (unsigned long long)(r.timeouts[PAIR_HOLD] + r.timeouts[PAIR_STOP] + r.timeouts[PAIR_DROP]));
+  }
+  fprintf(out, "  ]\n}\n");
+  if (out != stdout) fclose(out);
+
+  if (server > 0) {
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+  }
+  return malformed ? 1 : 0;
+}
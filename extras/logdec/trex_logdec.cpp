@@ -0,0 +1,203 @@
+// trex_logdec.cpp — decodes TrexLog binary records on a PC.
+//
+// Records carry a format string *address* and raw arguments (see
+// src/TrexLog.h); the strings themselves are read from the firmware ELF that
+// produced them, so the ELF must come from the same build.
+//
+// Build (from this directory):
+//   g++ -std=c++17 -O2 -I../../src trex_logdec.cpp -o trex_logdec
+//
+// Examples:
+//   ./trex_logdec build/trex.ino.elf capture.bin          # file from a binary sink
+//   ./trex_logdec build/trex.ino.elf --udp 32459          # live, TrexLog::Config.udpPort
+//   nc -ul 32459 > capture.bin                            # (capture for later)
+//   ./trex_logdec --selftest                              # hostile records (build with
+//                                                         # -fsanitize=address to check)
+//
+// Output matches the text sinks: "[    12.345] I game  loot 3 -> 4".
+
+#include "TrexLog.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using Bytes = std::vector<uint8_t>;
+
+static bool readFile(const char* path, Bytes& out) {
+  FILE* f = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+  if (!f) { fprintf(stderr, "cannot open %s\n", path); return false; }
+  uint8_t buf[65536];
+  size_t  n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+  if (f != stdin) fclose(f);
+  return true;
+}
+
+// ---------------------------------------------------------------- ELF
+// Just enough ELF32/ELF64 (little-endian) to map addresses of allocated
+// PROGBITS sections back to file bytes.
+class Elf {
+public:
+  bool load(const char* path) {
+    if (!readFile(path, img_)) return false;
+    if (img_.size() < 64 || memcmp(img_.data(), "\x7f" "ELF", 4) != 0 || img_[5] != 1) {
+      fprintf(stderr, "%s: not a little-endian ELF file\n", path);
+      return false;
+    }
+    const bool   is64  = img_[4] == 2;
+    const uint64_t shoff = is64 ? rd(0x28, 8) : rd(0x20, 4);
+    const unsigned shent = (unsigned)rd(is64 ? 0x3A : 0x2E, 2);
+    const unsigned shnum = (unsigned)rd(is64 ? 0x3C : 0x30, 2);
+    for (unsigned i = 0; i < shnum; ++i) {
+      const uint64_t sh = shoff + (uint64_t)i * shent;
+      if (sh + shent > img_.size()) break;
+      const uint32_t type  = (uint32_t)rd(sh + 4, 4);
+      const uint64_t flags = rd(sh + 8, is64 ? 8 : 4);
+      Section s;
+      s.addr = rd(sh + (is64 ? 16 : 12), is64 ? 8 : 4);
+      s.off  = rd(sh + (is64 ? 24 : 16), is64 ? 8 : 4);
+      s.size = rd(sh + (is64 ? 32 : 20), is64 ? 8 : 4);
+      if (type == 1 /*PROGBITS*/ && (flags & 2 /*ALLOC*/) && s.off + s.size <= img_.size()) secs_.push_back(s);
+    }
+    for (const Section& s : secs_) {
+      const uint8_t* b   = &img_[s.off];
+      const size_t   len = sizeof(TrexLog::kAnchor);   // includes the NUL
+      for (uint64_t i = 0; i + len <= s.size; ++i) {
+        if (memcmp(b + i, TrexLog::kAnchor, len) == 0) { anchor_ = s.addr + i; return true; }
+      }
+    }
+    fprintf(stderr, "%s: no TrexLog anchor (firmware built without TrexLog?)\n", path);
+    return false;
+  }
+
+  // Format string for a record, nullptr if the offset is outside the image.
+  const char* format(int32_t off) const {
+    const uint64_t addr = anchor_ + (int64_t)off;
+    for (const Section& s : secs_) {
+      if (addr >= s.addr && addr < s.addr + s.size) {
+        const char* p = (const char*)&img_[s.off + (addr - s.addr)];
+        return memchr(p, 0, s.addr + s.size - addr) ? p : nullptr;
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  struct Section { uint64_t addr, off, size; };
+  uint64_t rd(uint64_t at, unsigned n) const {
+    uint64_t v = 0;
+    for (unsigned i = 0; i < n && at + i < img_.size(); ++i) v |= (uint64_t)img_[at + i] << (8 * i);
+    return v;
+  }
+  Bytes                img_;
+  std::vector<Section> secs_;
+  uint64_t             anchor_ = 0;
+};
+
+// ---------------------------------------------------------------- records
+struct Counts { unsigned records = 0, unknown = 0, skipped = 0; };
+
+// Decodes a stream of StreamHdr / records; resyncs on the next header after
+// anything that doesn't parse.
+static void decode(const Elf& elf, const uint8_t* d, size_t n, Counts& c) {
+  size_t i = 0;
+  bool   synced = false;
+  char   line[TrexLog::kMaxRecord + 128];
+  while (i < n) {
+    if (n - i >= sizeof(TrexLog::StreamHdr) && memcmp(d + i, &TrexLog::kStreamHdr, sizeof(TrexLog::kStreamHdr)) == 0) {
+      i += sizeof(TrexLog::StreamHdr);
+      synced = true;
+      continue;
+    }
+    TrexLog::RecHdr h;
+    if (synced && n - i >= sizeof(h)) {
+      memcpy(&h, d + i, sizeof(h));
+      if (h.state == TrexLog::REC_READY && h.len >= sizeof(h) && h.len % 4 == 0 &&
+          h.len <= TrexLog::kMaxRecord && h.len <= n - i) {
+        const char* fmt = elf.format(h.fmt);
+        if (!fmt) { ++c.unknown; fmt = "<format not in ELF>"; }
+        alignas(4) uint8_t rec[TrexLog::kMaxRecord];
+        memcpy(rec, d + i, h.len);
+        TrexLog::formatLine(*(const TrexLog::RecHdr*)rec, fmt, line, sizeof(line));
+        fputs(line, stdout);
+        ++c.records;
+        i += h.len;
+        continue;
+      }
+    }
+    synced = false;
+    ++c.skipped;
+    ++i;
+  }
+}
+
+// ---------------------------------------------------------------- self test
+// Records as they could arrive from a file or the network, not as the
+// firmware writes them; each must decode to the expected text without
+// touching memory outside the record.
+static int selfTest() {
+  struct Case { const char* name; const char* fmt; Bytes args; std::string want; };
+  Bytes big = {'s', 200};                 // claims 200 chars, kMaxStr is 63
+  big.insert(big.end(), 200, 'A');
+  big.push_back('i');
+  for (int b : {7, 0, 0, 0}) big.push_back((uint8_t)b);
+  Bytes stars = {'i', 0, 0, 0, 0x80, 'i', 0, 0, 0, 0x80, 'i', 0xFD, 0xFF, 0xFF, 0xFF};   // INT_MIN, INT_MIN, -3
+  const Case cases[] = {
+    {"oversized %s",       "%s|%d",            big,   std::string(TrexLog::kMaxStr, 'A') + "|7"},
+    {"%s past the end",    "%s",               {'s', 10, 'x'}, "<?>"},
+    {"INT_MIN * and .*",   "%-+ #0*.*d|",      stars, ""},
+    {"over-long spec",     "%-----------------------------------8d|%d", {'i', 1, 0, 0, 0, 'i', 2, 0, 0, 0}, "<?>|2"},
+  };
+  int failed = 0;
+  for (const Case& t : cases) {
+    char out[512];
+    const size_t n = TrexLog::format(t.fmt, t.args.data(), t.args.size(), out, sizeof(out));
+    const bool ok = n < sizeof(out) && (t.want.empty() || t.want == out);
+    printf("%-18s %s  \"%s\"\n", t.name, ok ? "ok  " : "FAIL", out);
+    failed += !ok;
+  }
+  return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 2 && !strcmp(argv[1], "--selftest")) return selfTest();
+  if (argc != 3 && !(argc == 4 && !strcmp(argv[2], "--udp"))) {
+    fprintf(stderr, "usage: trex_logdec FIRMWARE.elf LOG.bin|-\n"
+                    "       trex_logdec FIRMWARE.elf --udp PORT\n"
+                    "       trex_logdec --selftest\n");
+    return 2;
+  }
+  Elf elf;
+  if (!elf.load(argv[1])) return 1;
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  Counts c;
+
+  if (argc == 3) {
+    Bytes log;
+    if (!readFile(argv[2], log)) return 1;
+    decode(elf, log.data(), log.size(), c);
+    fprintf(stderr, "%u records, %u with unknown format, %u bytes skipped\n", c.records, c.unknown, c.skipped);
+    return c.unknown ? 1 : 0;
+  }
+
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in a{};
+  a.sin_family      = AF_INET;
+  a.sin_port        = htons((uint16_t)atoi(argv[3]));
+  a.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (fd < 0 || bind(fd, (sockaddr*)&a, sizeof(a)) != 0) { perror("udp"); return 1; }
+  uint8_t buf[2048];
+  for (;;) {
+    const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n > 0) decode(elf, buf, (size_t)n, c);
+  }
+}
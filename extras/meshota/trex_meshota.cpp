@@ -0,0 +1,156 @@
+// trex_meshota.cpp — host harness for MeshOta (broadcast firmware + NACK repair).
+//
+// Runs one MeshOta::Sender and N MeshOta::Receivers in one process on a
+// virtual millisecond clock, with memory source and sinks. Every frame, each
+// way, is dropped independently with the given probability per receiver, as
+// on a lossy broadcast channel. Prints passes, chunks sent / repaired and the
+// virtual time the campaign took; every sink is compared with the image at
+// the end.
+//
+// Build (from this directory):
+//   g++ -std=c++17 -O2 -DTREX_USE_HOST=1 -I../../src trex_meshota.cpp ../../src/TrexTransportHost.cpp ../../src/TrexTransportCommon.cpp -o trex_meshota
+//
+// Examples:
+//   ./trex_meshota --receivers 30 --size 300000 --loss 0
+//   ./trex_meshota --receivers 30 --size 300000 --loss 20 --seed 7
+//
+// Exit status is non-zero unless every receiver ends with the exact image.
+
+#include "TrexMeshOta.h"
+#include "TrexProtocol.h"
+#include "TrexTransport.h"
+
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// ---------------------------------------------------------------- options
+struct Options {
+  int      receivers = 30;
+  uint32_t size      = 300000;
+  double   loss      = 0;        // percent, per frame per receiver, both ways
+  uint32_t seed      = 1;
+  uint32_t limitS    = 3600;     // give up after this much virtual time
+};
+
+static void usage() {
+  fprintf(stderr, "usage: trex_meshota [--receivers N] [--size BYTES] [--loss PCT] [--seed N] [--limit S]\n");
+  exit(2);
+}
+
+static Options parseArgs(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    auto val = [&]() -> const char* { if (i + 1 >= argc) usage(); return argv[++i]; };
+    if      (!strcmp(a, "--receivers")) o.receivers = atoi(val());
+    else if (!strcmp(a, "--size"))      o.size      = (uint32_t)strtoul(val(), nullptr, 0);
+    else if (!strcmp(a, "--loss"))      o.loss      = atof(val());
+    else if (!strcmp(a, "--seed"))      o.seed      = (uint32_t)strtoul(val(), nullptr, 0);
+    else if (!strcmp(a, "--limit"))     o.limitS    = (uint32_t)strtoul(val(), nullptr, 0);
+    else usage();
+  }
+  if (o.receivers < 1 || o.receivers > 254 || !o.size) usage();
+  return o;
+}
+
+// ---------------------------------------------------------------- image
+struct MemSource {
+  std::vector<uint8_t> img;
+  bool read(uint32_t off, uint8_t* dst, uint16_t n) {
+    if (off + n > img.size()) return false;
+    memcpy(dst, img.data() + off, n);
+    return true;
+  }
+};
+
+struct MemSink {
+  std::vector<uint8_t> buf;
+  bool open = false;
+  bool begin(uint32_t size) { buf.assign(size, 0); open = true; return true; }
+  bool write(uint32_t off, const uint8_t* d, uint16_t n) {
+    if (!open || off + n > buf.size()) return false;
+    memcpy(buf.data() + off, d, n);
+    return true;
+  }
+  bool finish(uint32_t size, uint32_t crc) {
+    open = false;
+    return size == buf.size() && MeshOta::crc32Update(0, buf.data(), size) == crc;
+  }
+  void abort() { open = false; }
+};
+
+// ---------------------------------------------------------------- main
+int main(int argc, char** argv) {
+  const Options opt = parseArgs(argc, argv);
+  std::mt19937 rng(opt.seed);
+  std::uniform_real_distribution<double> pct(0, 100);
+  auto lost = [&]() { return opt.loss > 0 && pct(rng) < opt.loss; };
+
+  MemSource src;
+  src.img.resize(opt.size);
+  for (auto& b : src.img) b = (uint8_t)rng();
+
+  static MeshOta::Sender<MemSource> tx(src);
+  std::vector<MeshOta::Receiver<MemSink>> rx(opt.receivers);
+  for (int i = 0; i < opt.receivers; ++i) rx[i].begin(StationType::LOOT, (uint8_t)(i + 1), 1, 0);
+
+  uint32_t now = 0;
+  if (!tx.start(0x4D4F5441, opt.size, StationType::LOOT, 0, 1, 1, 0, now)) {
+    fprintf(stderr, "image rejected (empty or larger than %u chunks)\n", MeshOta::kMaxChunks);
+    return 2;
+  }
+
+  static TxFrame f;
+  uint32_t framesDown = 0, framesUp = 0;
+  auto busy = [&]() {
+    if (tx.active()) return true;
+    for (auto& r : rx) if (r.state() == MeshOta::Receiver<MemSink>::RECEIVING) return true;
+    return false;
+  };
+
+  for (; busy() && now < opt.limitS * 1000u; ++now) {
+    while (tx.poll(now, f)) {
+      ++framesDown;
+      const MsgHeader& h = *f.header();
+      for (auto& r : rx) {
+        if (lost()) continue;
+        if ((MsgType)h.type == MsgType::OTA_OFFER)
+          r.onOffer(*reinterpret_cast<const OtaOfferPayload*>(f.payload()), now);
+        else if ((MsgType)h.type == MsgType::OTA_CHUNK)
+          r.onChunk(*reinterpret_cast<const OtaChunkPayload*>(f.payload()), h.payloadLen, now);
+      }
+    }
+    for (auto& r : rx) {
+      while (r.poll(now, f)) {
+        ++framesUp;
+        if (lost()) continue;
+        const MsgHeader& h = *f.header();
+        if ((MsgType)h.type == MsgType::OTA_NACK) {
+          OtaNackPayload n{};
+          memcpy(&n, f.payload(), h.payloadLen < sizeof(n) ? h.payloadLen : sizeof(n));
+          tx.onNack(n, h.payloadLen);
+        } else if ((MsgType)h.type == MsgType::OTA_STATUS) {
+          tx.onStatus(*reinterpret_cast<const OtaStatusPayload*>(f.payload()));
+        }
+      }
+    }
+  }
+
+  int ok = 0, failed = 0, incomplete = 0;
+  for (auto& r : rx) {
+    if (r.succeeded() && r.sink().buf == src.img) ++ok;
+    else if (r.state() == MeshOta::Receiver<MemSink>::RECEIVING) ++incomplete;
+    else ++failed;
+  }
+  const auto& s = tx.stats();
+  const uint16_t chunks = tx.offer().chunkCount;
+  printf("receivers=%d size=%u chunks=%u loss=%.1f%% seed=%u\n", opt.receivers, opt.size, chunks, opt.loss, opt.seed);
+  printf("passes=%u chunksSent=%u repairs=%u (%.1f%% of image) nacksRx=%u framesDown=%u framesUp=%u\n",
+         s.passes, s.chunksSent, s.repairsSent, chunks ? 100.0 * s.repairsSent / chunks : 0.0, s.nacksRx,
+         framesDown, framesUp);
+  printf("done in %.1f s virtual: ok=%d failed=%d incomplete=%d\n", now / 1000.0, ok, failed, incomplete);
+  return ok == opt.receivers ? 0 : 1;
+}
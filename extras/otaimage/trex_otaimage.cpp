@@ -0,0 +1,307 @@
+// trex_otaimage.cpp — builds TRXZ OTA artifacts (see src/TrexOtaImage.h).
+//
+// pack compresses a firmware image; delta encodes it against the firmware the
+// stations already run (they check the base version before touching flash).
+// Every artifact is decoded again with the firmware's own Decoder and compared
+// byte for byte before it is written, and apply does the same for an existing
+// file.
+//
+// Build (from this directory):
+//   g++ -std=c++17 -O2 -I../../src trex_otaimage.cpp -o trex_otaimage
+//
+// Examples:
+//   ./trex_otaimage pack  build/trex.bin trex-1.4.trxz --version 1.4
+//   ./trex_otaimage delta trex-1.3.bin build/trex.bin trex-1.3-1.4.trxz --base 1.3 --version 1.4
+//   ./trex_otaimage apply trex-1.3-1.4.trxz out.bin --base trex-1.3.bin --base-version 1.3
+
+#include "TrexOtaImage.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using Bytes = std::vector<uint8_t>;
+
+static bool readFile(const char* path, Bytes& out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) { fprintf(stderr, "cannot open %s\n", path); return false; }
+  uint8_t buf[65536];
+  size_t  n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static bool writeFile(const char* path, const Bytes& data) {
+  FILE* f = fopen(path, "wb");
+  if (!f) { fprintf(stderr, "cannot create %s\n", path); return false; }
+  const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+static bool parseVersion(const char* s, uint8_t& major, uint8_t& minor) {
+  unsigned a, b;
+  if (sscanf(s, "%u.%u", &a, &b) != 2 || a > 255 || b > 255) return false;
+  major = (uint8_t)a;
+  minor = (uint8_t)b;
+  return true;
+}
+
+// ---------------------------------------------------------------- encoder
+static void putVarint(Bytes& out, uint32_t v) {
+  while (v >= 0x80) { out.push_back((uint8_t)(v | 0x80)); v >>= 7; }
+  out.push_back((uint8_t)v);
+}
+
+class Encoder {
+public:
+  Encoder(const Bytes& img, const Bytes* base) : img_(img), base_(base) {}
+
+  Bytes encode(OtaImage::Header h) {
+    Bytes out((const uint8_t*)&h, (const uint8_t*)&h + sizeof(h));
+    if (base_) indexBase();
+    std::vector<int32_t> head(1u << kHashBits, -1), prev(img_.size(), -1);
+    size_t i = 0, lit = 0;
+    while (i < img_.size()) {
+      uint32_t bestLen = 0, bestDist = 0, baseLen = 0, baseAt = 0;
+      if (i + kMinCopy <= img_.size()) {
+        const uint32_t hv = hash4(&img_[i]);
+        uint32_t       walk = 0;
+        for (int32_t c = head[hv]; c >= 0 && i - (size_t)c <= OtaImage::kWindow && walk < kMaxWalk;
+             c = prev[c], ++walk) {
+          const uint32_t n = matchLen(&img_[c], &img_[i], img_.size() - i);
+          if (n > bestLen) { bestLen = n; bestDist = (uint32_t)(i - c); }
+        }
+      }
+      if (base_) findBase(i, baseLen, baseAt);
+      // A base copy costs a few bytes more than a window copy; take it when it wins.
+      const bool useBase = baseLen >= kMinBase && baseLen + 2 >= bestLen;
+      const bool useCopy = !useBase && bestLen >= kMinCopy;
+      if (!useBase && !useCopy) {
+        insert(head, prev, i);
+        ++i;
+        ++lit;
+        continue;
+      }
+      flushLiterals(out, i, lit);
+      const uint32_t len = useBase ? baseLen : bestLen;
+      if (useBase) {
+        putVarint(out, len << 2 | OtaImage::OP_BASE);
+        const int32_t d = (int32_t)(baseAt - baseEnd_);
+        putVarint(out, ((uint32_t)d << 1) ^ (uint32_t)(d >> 31));   // zigzag
+        baseEnd_ = baseAt + len;
+        ++baseOps_;
+      } else {
+        putVarint(out, len << 2 | OtaImage::OP_COPY);
+        putVarint(out, bestDist);
+        ++copyOps_;
+      }
+      for (uint32_t k = 0; k < len; ++k) insert(head, prev, i + k);
+      i += len;
+    }
+    flushLiterals(out, i, lit);
+    putVarint(out, OtaImage::OP_END);
+    return out;
+  }
+
+  uint32_t copyOps() const { return copyOps_; }
+  uint32_t baseOps() const { return baseOps_; }
+  uint32_t litOps()  const { return litOps_; }
+
+private:
+  static constexpr unsigned kHashBits = 16;
+  static constexpr uint32_t kMinCopy  = 4;
+  static constexpr uint32_t kMinBase  = 8;
+  static constexpr uint32_t kMaxWalk  = 64;
+
+  static uint32_t hash4(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - kHashBits);
+  }
+  static uint64_t hash8(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v * 0x9E3779B97F4A7C15ull;
+  }
+  static uint32_t matchLen(const uint8_t* a, const uint8_t* b, size_t max) {
+    uint32_t n = 0;
+    while (n < max && a[n] == b[n]) ++n;
+    return n;
+  }
+
+  void insert(std::vector<int32_t>& head, std::vector<int32_t>& prev, size_t i) {
+    if (i + kMinCopy > img_.size()) return;
+    const uint32_t hv = hash4(&img_[i]);
+    prev[i]  = head[hv];
+    head[hv] = (int32_t)i;
+  }
+
+  // 8-byte fingerprints of the base at every 4th offset; first hit wins.
+  void indexBase() {
+    const Bytes& b = *base_;
+    baseIdx_.assign(1u << 20, -1);
+    for (size_t j = 0; j + kMinBase <= b.size(); j += 4) {
+      int32_t& slot = baseIdx_[hash8(&b[j]) >> 44];
+      if (slot < 0) slot = (int32_t)j;
+    }
+  }
+
+  // Candidates: carrying on where the last base copy left off (code that
+  // only shifted), then the fingerprint index probed at i..i+3.
+  void findBase(size_t i, uint32_t& bestLen, uint32_t& bestAt) {
+    const Bytes& b    = *base_;
+    auto         test = [&](int64_t at) {
+      if (at < 0 || (size_t)at >= b.size()) return;
+      const uint32_t n = matchLen(&b[at], &img_[i], std::min(b.size() - at, img_.size() - i));
+      if (n > bestLen) { bestLen = n; bestAt = (uint32_t)at; }
+    };
+    test((int64_t)i + shift_);
+    if (i + kMinBase + 3 <= img_.size()) {
+      for (uint32_t k = 0; k < 4; ++k) {
+        const int32_t at = baseIdx_[hash8(&img_[i + k]) >> 44];
+        if (at >= (int32_t)k) test(at - (int32_t)k);
+      }
+    }
+    if (bestLen >= kMinBase) shift_ = (int64_t)bestAt - (int64_t)i;
+  }
+
+  void flushLiterals(Bytes& out, size_t end, size_t& lit) {
+    if (!lit) return;
+    putVarint(out, (uint32_t)lit << 2 | OtaImage::OP_LITERAL);
+    out.insert(out.end(), img_.begin() + (end - lit), img_.begin() + end);
+    ++litOps_;
+    lit = 0;
+  }
+
+  const Bytes&         img_;
+  const Bytes*         base_;
+  std::vector<int32_t> baseIdx_;
+  int64_t              shift_   = 0;
+  uint32_t             baseEnd_ = 0;
+  uint32_t             copyOps_ = 0, baseOps_ = 0, litOps_ = 0;
+};
+
+// ---------------------------------------------------------------- decoder glue
+struct VecSink {
+  Bytes out;
+  bool begin(uint32_t size) { out.assign(size, 0); return true; }
+  bool write(uint32_t off, const uint8_t* d, uint16_t n) {
+    if ((size_t)off + n > out.size()) return false;
+    memcpy(&out[off], d, n);
+    return true;
+  }
+  bool finish(uint32_t size, uint32_t crc) {
+    return size == out.size() && MeshOta::crc32Update(0, out.data(), out.size()) == crc;
+  }
+  void abort() { out.clear(); }
+};
+
+struct VecBase {
+  const Bytes* img = nullptr;
+  bool read(uint32_t off, uint8_t* dst, uint16_t n) {
+    if (!img || (size_t)off + n > img->size()) return false;
+    memcpy(dst, &(*img)[off], n);
+    return true;
+  }
+};
+
+// Feeds in uneven pieces, the way a download arrives.
+static bool decode(const Bytes& art, const Bytes* base, uint8_t baseMajor, uint8_t baseMinor,
+                   Bytes& out, uint8_t& err) {
+  VecSink sink;
+  VecBase vb{base};
+  auto*   dec = new OtaImage::Decoder<VecSink, VecBase>(sink, vb);
+  dec->begin(baseMajor, baseMinor, (uint32_t)art.size());
+  auto   r = OtaImage::Decoder<VecSink, VecBase>::MORE;
+  size_t at = 0, step = 1;
+  while (r == OtaImage::Decoder<VecSink, VecBase>::MORE && at < art.size()) {
+    const size_t n = std::min(step, art.size() - at);
+    r = dec->feed(&art[at], n);
+    at += n;
+    step = step * 3 % 1459 + 1;
+  }
+  if (r == OtaImage::Decoder<VecSink, VecBase>::MORE) dec->abort();
+  err = dec->error();
+  delete dec;
+  if (r != OtaImage::Decoder<VecSink, VecBase>::DONE) return false;
+  out.swap(sink.out);
+  return true;
+}
+
+static int usage() {
+  fprintf(stderr,
+          "usage: trex_otaimage pack  NEW.bin OUT.trxz --version M.m\n"
+          "       trex_otaimage delta BASE.bin NEW.bin OUT.trxz --base M.m --version M.m\n"
+          "       trex_otaimage apply IN.trxz OUT.bin [--base BASE.bin --base-version M.m]\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) return usage();
+  const std::string cmd = argv[1];
+  std::vector<const char*> pos;
+  const char *ver = nullptr, *basever = nullptr, *basefile = nullptr;
+  for (int i = 2; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--version" && i + 1 < argc) ver = argv[++i];
+    else if (a == "--base" && i + 1 < argc) (cmd == "apply" ? basefile : basever) = argv[++i];
+    else if (a == "--base-version" && i + 1 < argc) basever = argv[++i];
+    else if (a.rfind("--", 0) == 0) return usage();
+    else pos.push_back(argv[i]);
+  }
+
+  if (cmd == "apply") {
+    if (pos.size() != 2) return usage();
+    Bytes art, base, out;
+    if (!readFile(pos[0], art) || (basefile && !readFile(basefile, base))) return 1;
+    uint8_t bMaj = 0, bMin = 0, err = 0;
+    if (basever && !parseVersion(basever, bMaj, bMin)) return usage();
+    if (!basever && art.size() >= sizeof(OtaImage::Header)) {   // trust the header
+      const auto* h = (const OtaImage::Header*)art.data();
+      bMaj = h->baseMajor;
+      bMin = h->baseMinor;
+    }
+    if (!decode(art, basefile ? &base : nullptr, bMaj, bMin, out, err)) {
+      fprintf(stderr, "decode failed: error %u\n", err);
+      return 1;
+    }
+    printf("%s: %zu -> %zu bytes, crc %08x\n", pos[0], art.size(), out.size(),
+           MeshOta::crc32Update(0, out.data(), out.size()));
+    return writeFile(pos[1], out) ? 0 : 1;
+  }
+
+  const bool delta = cmd == "delta";
+  if ((cmd != "pack" && !delta) || pos.size() != (delta ? 3u : 2u) || !ver || (delta && !basever)) return usage();
+  Bytes base, img;
+  if ((delta && !readFile(pos[0], base)) || !readFile(pos[delta ? 1 : 0], img)) return 1;
+
+  OtaImage::Header h{};
+  memcpy(h.magic, OtaImage::kMagic, sizeof(h.magic));
+  h.version = OtaImage::kFormatVersion;
+  h.kind    = delta ? OtaImage::KIND_DELTA : OtaImage::KIND_LZ;
+  h.window  = OtaImage::kWindow;
+  h.outSize = (uint32_t)img.size();
+  h.outCrc  = MeshOta::crc32Update(0, img.data(), img.size());
+  if (!parseVersion(ver, h.fwMajor, h.fwMinor) ||
+      (delta && !parseVersion(basever, h.baseMajor, h.baseMinor))) return usage();
+  if (delta) h.baseSize = (uint32_t)base.size();
+
+  Encoder enc(img, delta ? &base : nullptr);
+  const Bytes art = enc.encode(h);
+
+  Bytes   check;
+  uint8_t err = 0;
+  if (!decode(art, delta ? &base : nullptr, h.baseMajor, h.baseMinor, check, err) || check != img) {
+    fprintf(stderr, "self-check failed (error %u)\n", err);
+    return 1;
+  }
+  printf("%s %u.%u%s: %zu -> %zu bytes (%.1f%%), %u literal / %u copy / %u base ops, crc %08x\n",
+         cmd.c_str(), h.fwMajor, h.fwMinor, delta ? (" from " + std::string(basever)).c_str() : "",
+         img.size(), art.size(), 100.0 * art.size() / (img.size() ? img.size() : 1),
+         enc.litOps(), enc.copyOps(), enc.baseOps(), h.outCrc);
+  return writeFile(pos[delta ? 2 : 1], art) ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+// trex_replay.cpp — plays a TrexCapture recording back onto the host transport.
+//
+// Reads a capture saved on a device ('cap save /cap.bin', then
+// GET /download?path=/cap.bin) or the text of 'cap dump' copied from the
+// console, splits every frame into its messages and sends them through the real
+// Transport API (host backend) with the original spacing, scaled by --speed.
+// A server built for the host (e.g. the game logic under a profiler) on the
+// same group and channel sees the field traffic as it arrived.
+//
+// Build (from this directory):
+//   g++ -std=c++17 -O2 -DTREX_USE_HOST=1 -I../../src trex_replay.cpp ../../src/TrexTransportHost.cpp ../../src/TrexTransportCommon.cpp -o trex_replay
+//
+// Examples:
+//   ./trex_replay cap.bin                        # received frames, real time
+//   ./trex_replay cap.bin --speed 10 --loop 20   # 10x faster, 20 times over
+//   ./trex_replay cap.bin --speed 0              # as fast as the socket takes it
+//   ./trex_replay console.log --dir all --decode --no-send
+//
+// The group and port come from TREX_HOST_GROUP / TREX_HOST_PORT as for the
+// other host tools. Exit status is non-zero if a frame didn't parse.
+
+#include "TrexBuildConfig.h"
+#include "TrexAggregate.h"
+#include "TrexCapture.h"
+#include "TrexCompact.h"
+#include "TrexMsgRegistry.h"
+#include "TrexProtocol.h"
+#include "TrexTransport.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// ---------------------------------------------------------------- options
+struct ReplayOptions {
+  const char* path    = nullptr;
+  double      speed   = 1.0;     // 0 = no pacing
+  int         loops   = 1;
+  uint8_t     dir     = 0;       // 0 = received frames, 1 = sent, 2 = both
+  uint8_t     channel = 6;
+  bool        framed  = true;
+  bool        compact = false;
+  bool        decode  = false;
+  bool        send    = true;
+};
+
+static void usage() {
+  fprintf(stderr,
+    "usage: trex_replay CAPTURE [--speed X] [--loop N] [--dir rx|tx|all] [--channel CH]\n"
+    "                   [--legacy] [--compact] [--decode] [--no-send]\n");
+}
+
+static bool parseArgs(int argc, char** argv, ReplayOptions& o) {
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    auto take = [&](const char* name) { if (strcmp(a, name) == 0 && v) { ++i; return true; } return false; };
+    if      (take("--speed"))   o.speed   = atof(v);
+    else if (take("--loop"))    o.loops   = atoi(v);
+    else if (take("--channel")) o.channel = (uint8_t)atoi(v);
+    else if (take("--dir"))     o.dir     = !strcmp(v, "rx") ? 0 : !strcmp(v, "tx") ? 1 : !strcmp(v, "all") ? 2 : 9;
+    else if (strcmp(a, "--legacy") == 0)  o.framed  = false;
+    else if (strcmp(a, "--compact") == 0) o.compact = true;
+    else if (strcmp(a, "--decode") == 0)  o.decode  = true;
+    else if (strcmp(a, "--no-send") == 0) o.send    = false;
+    else if (a[0] != '-' && !o.path)      o.path    = a;
+    else { usage(); return false; }
+  }
+  if (!o.path || o.speed < 0 || o.loops < 1 || o.dir > 2) { usage(); return false; }
+  return true;
+}
+
+// ---------------------------------------------------------------- loading
+using Records = std::vector<TrexCapture::Record>;
+
+static bool readFile(const char* path, std::vector<uint8_t>& out) {
+  FILE* f = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+  if (!f) { fprintf(stderr, "cannot open %s\n", path); return false; }
+  uint8_t buf[65536];
+  size_t  n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+  if (f != stdin) fclose(f);
+  return true;
+}
+
+static int hexNibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Reads n bytes of hex from s; false on a short or bad field.
+static bool hexBytes(const char*& s, uint8_t* out, size_t n) {
+  for (size_t i = 0; i < n; ++i, s += 2) {
+    const int hi = hexNibble(s[0]), lo = hi < 0 ? -1 : hexNibble(s[1]);
+    if (lo < 0) return false;
+    out[i] = (uint8_t)(hi << 4 | lo);
+  }
+  return true;
+}
+
+// One "cap <us> <flags> <link> <mac|-> <hex>" line (TrexCapture::formatLine).
+static bool parseLine(const char* s, TrexCapture::Record& r) {
+  unsigned us, flags, link;
+  int      used = 0;
+  if (sscanf(s, "cap %u %x %x %n", &us, &flags, &link, &used) != 3 || !used) return false;
+  s += used;
+  r.h.us    = us;
+  r.h.flags = (uint8_t)flags;
+  r.h.link  = (uint8_t)link;
+  if (r.h.flags & TrexCapture::FL_MAC) { if (!hexBytes(s, r.mac, 6)) return false; }
+  else if (*s++ != '-') return false;
+  while (*s == ' ') ++s;
+  size_t n = 0;
+  while (hexNibble(s[0]) >= 0 && n < TrexCapture::kMaxFrame) {
+    if (!hexBytes(s, r.data + n, 1)) return false;
+    ++n;
+  }
+  r.h.len = (uint16_t)n;
+  return n > 0;
+}
+
+static bool load(const char* path, Records& out, unsigned& bad) {
+  std::vector<uint8_t> f;
+  if (!readFile(path, f)) return false;
+  TrexCapture::Record r;
+  if (f.size() >= sizeof(TrexCapture::FileHdr) && !memcmp(f.data(), TrexCapture::kFileHdr.magic, 4)) {
+    TrexCapture::FileHdr fh;
+    memcpy(&fh, f.data(), sizeof(fh));
+    if (fh.version != TrexCapture::kFileHdr.version || fh.recHdrLen != sizeof(TrexCapture::RecHdr)) {
+      fprintf(stderr, "%s: capture format v%u not supported\n", path, fh.version);
+      return false;
+    }
+    size_t i = sizeof(fh);
+    while (i < f.size()) {
+      const size_t n = TrexCapture::parse(f.data() + i, f.size() - i, r);
+      if (!n) { ++bad; break; }   // cut short (download interrupted)
+      out.push_back(r);
+      i += n;
+    }
+    return true;
+  }
+  // Text: any line containing "cap " followed by a record (console noise and
+  // prompts around it are ignored).
+  std::string text(f.begin(), f.end());
+  for (size_t at = 0; at < text.size();) {
+    size_t eol = text.find('\n', at);
+    if (eol == std::string::npos) eol = text.size();
+    const std::string line = text.substr(at, eol - at);
+    const size_t c = line.find("cap ");
+    if (c != std::string::npos && line.find_first_of("0123456789", c) == c + 4) {
+      if (parseLine(line.c_str() + c, r)) out.push_back(r);
+      else ++bad;
+    }
+    at = eol + 1;
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------- decoding
+static const char* linkName(uint8_t link) {
+  switch (link) {
+    case TREX_LINK_ESPNOW: return "espnow";
+    case TREX_LINK_UDP:    return "udp";
+    case TREX_LINK_HOST:   return "host";
+    default:               return "?";
+  }
+}
+
+// Prints the fields worth seeing at a glance; everything else as hex.
+struct Printer {
+  void on(const MsgHeader&, const HelloPayload& p)         { printf(" type=%u id=%u fw=%u.%u ch=%u", p.stationType, p.stationId, p.fwMajor, p.fwMinor, p.wifiChannel); }
+  void on(const MsgHeader&, const StateTickPayload& p)     { printf(" state=%u msLeft=%u", p.state, (unsigned)p.msLeft); }
+  void on(const MsgHeader&, const ScoreUpdatePayload& p)   { printf(" score=%u", (unsigned)p.teamScore); }
+  void on(const MsgHeader&, const StationUpdatePayload& p) { printf(" id=%u inv=%u/%u", p.stationId, p.inventory, p.capacity); }
+  void on(const MsgHeader&, const GameOverPayload& p)      { printf(" reason=%u blame=%u", p.reason, p.blameSid); }
+  void on(const MsgHeader&, const LootHoldStartPayload& p) { printf(" hold=%08x id=%u uidLen=%u", (unsigned)p.holdId, p.stationId, p.uid.len); }
+  void on(const MsgHeader&, const LootHoldAckPayload& p)   { printf(" hold=%08x ok=%u carried=%u/%u inv=%u/%u deny=%u", (unsigned)p.holdId, p.accepted, p.carried, p.maxCarry, p.inventory, p.capacity, p.denyReason); }
+  void on(const MsgHeader&, const LootTickPayload& p)      { printf(" hold=%08x carried=%u inv=%u", (unsigned)p.holdId, p.carried, p.inventory); }
+  void on(const MsgHeader&, const LootHoldStopPayload& p)  { printf(" hold=%08x", (unsigned)p.holdId); }
+  void on(const MsgHeader&, const HoldEndPayload& p)       { printf(" hold=%08x reason=%u", (unsigned)p.holdId, p.reason); }
+  void on(const MsgHeader&, const DropRequestPayload& p)   { printf(" reader=%u uidLen=%u", p.readerIndex, p.uid.len); }
+  void on(const MsgHeader&, const DropResultPayload& p)    { printf(" dropped=%u score=%u reader=%u", p.dropped, (unsigned)p.teamScore, p.readerIndex); }
+  void on(const MsgHeader&, const GameStatusPayload& p)    { printf(" score=%u game=%u round=%u idx=%u phase=%u light=%u", (unsigned)p.teamScore, (unsigned)p.msLeftGame, (unsigned)p.msLeftRound, p.roundIndex, p.phase, p.lightState); }
+  void on(const MsgHeader&, const ControlCmdPayload& p)    { printf(" op=%u target=%u/%u", p.op, p.targetType, p.targetId); }
+  void on(const MsgHeader&, const StatusKeyframePayload& p){ printf(" key=%u score=%u game=%u", p.keySeq, (unsigned)p.status.teamScore, (unsigned)p.status.msLeftGame); }
+  void on(const MsgHeader&, const StatusKeyReqPayload& p)  { printf(" have=%u", p.haveKeySeq); }
+  void on(const MsgHeader&, const RelAckPayload& p)        { printf(" peer=%u cum=%u sack=%08x", p.peerId, p.cumSeq, (unsigned)p.sackMask); }
+  void on(const MsgHeader&, const TimePingPayload& p)      { printf(" t1=%u", (unsigned)p.t1); }
+  void on(const MsgHeader&, const TimePongPayload& p)      { printf(" dst=%u t1=%u t2=%u t3=%u", p.dstStationId, (unsigned)p.t1, (unsigned)p.t2, (unsigned)p.t3); }
+  void onUnhandled(const MsgHeader&, const uint8_t* p, uint16_t len) {
+    if (len) printf(" ");
+    for (uint16_t i = 0; i < len && i < 24; ++i) printf("%02x", p[i]);
+    if (len > 24) printf("...");
+  }
+};
+
+static void printMsg(const TrexCapture::Record& r, double t, const uint8_t* m, uint16_t n) {
+  static Printer             printer;
+  static MsgDispatcher<Printer> dispatch(printer);
+  MsgHeader h;
+  memcpy(&h, m, sizeof(h));
+  const char* name = msgTypeName(h.type);
+  printf("%12.6f %s %-6s ", t, (r.h.flags & TrexCapture::FL_TX) ? "tx" : "rx", linkName(r.h.link));
+  if (r.h.flags & TrexCapture::FL_MAC)
+    printf("%02x:%02x:%02x:%02x:%02x:%02x ", r.mac[0], r.mac[1], r.mac[2], r.mac[3], r.mac[4], r.mac[5]);
+  if (name) printf("%-15s", name);
+  else      printf("type%-11u", h.type);
+  printf(" src=%u seq=%u len=%u%s", h.srcStationId, h.seq, h.payloadLen,
+         (h.flags & TREX_MSGF_RELIABLE) ? " rel" : "");
+  switch (dispatch.dispatch(m, n)) {
+    case DispatchResult::SHORT:     printf(" <short>"); break;
+    case DispatchResult::MALFORMED: printf(" <malformed>"); break;
+    default: break;
+  }
+  printf("\n");
+}
+
+// Calls fn(msg, len) for every message in a captured frame, MORE cleared so
+// each can be sent on its own. False if the frame didn't split cleanly.
+template <class Fn>
+static bool forEachMsg(const TrexCapture::Record& r, Fn fn) {
+  uint8_t one[sizeof(MsgHeader) + 256];
+  auto single = [&](const uint8_t* m, uint16_t n) {
+    if (n > sizeof(one)) return;
+    memcpy(one, m, n);
+    one[offsetof(MsgHeader, flags)] &= (uint8_t)~TREX_MSGF_MORE;
+    fn(one, n);
+  };
+  if (r.h.flags & TrexCapture::FL_CUT) return false;
+  if (r.h.flags & TrexCapture::FL_FRAMED) {
+    if (r.h.len <= 3) return false;
+    return trexForEachWireRecord(r.data[2], r.data + 3, (uint16_t)(r.h.len - 3), single);
+  }
+  return r.h.len >= sizeof(MsgHeader) && trexForEachRecord(r.data, r.h.len, single);
+}
+
+// ---------------------------------------------------------------- main
+int main(int argc, char** argv) {
+  ReplayOptions opt;
+  if (!parseArgs(argc, argv, opt)) return 2;
+
+  Records  recs;
+  unsigned bad = 0;
+  if (!load(opt.path, recs, bad)) return 1;
+  Records pick;
+  for (const auto& r : recs) {
+    const bool tx = r.h.flags & TrexCapture::FL_TX;
+    if (opt.dir == 2 || tx == (opt.dir == 1)) pick.push_back(r);
+  }
+  fprintf(stderr, "%s: %zu frames, %zu selected, %u unreadable\n", opt.path, recs.size(), pick.size(), bad);
+  if (pick.empty()) return bad ? 1 : 0;
+
+  if (opt.send) {
+    TransportConfig cfg{};
+    cfg.wifiChannel    = opt.channel;
+    cfg.txFramed       = opt.framed;
+    cfg.wireVersion    = opt.compact ? TREX_WIRE_VERSION_COMPACT : TREX_WIRE_VERSION;
+    cfg.rxAcceptLegacy = true;
+    cfg.stationId      = 0xFE;   // not a real station
+    if (!Transport::init(cfg, [](const uint8_t*, uint16_t) {})) { fprintf(stderr, "Transport::init failed\n"); return 2; }
+  }
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  uint64_t frames = 0, msgs = 0, sendFail = 0;
+  unsigned badFrames = 0;
+  const Clock::time_point start = Clock::now();
+  Clock::time_point       lapStart = start;
+  for (int lap = 0; lap < opt.loops; ++lap) {
+    uint64_t capUs  = 0;                 // capture time since the first frame
+    uint32_t prevUs = pick.front().h.us;
+    for (const auto& r : pick) {
+      capUs += (uint32_t)(r.h.us - prevUs);   // micros() wraps every ~71 min
+      prevUs = r.h.us;
+      if (opt.speed > 0) {
+        std::this_thread::sleep_until(lapStart + std::chrono::microseconds((uint64_t)(capUs / opt.speed)));
+      }
+      ++frames;
+      const bool ok = forEachMsg(r, [&](const uint8_t* m, uint16_t n) {
+        ++msgs;
+        if (opt.decode && lap == 0) printMsg(r, capUs / 1e6, m, n);
+        if (opt.send && !Transport::broadcast(m, n)) ++sendFail;
+      });
+      if (!ok) {
+        if (lap == 0) ++badFrames;
+        if (opt.decode && lap == 0) printf("%12.6f unparsed frame, %u bytes\n", capUs / 1e6, r.h.len);
+      }
+      if (opt.send) Transport::loop();
+    }
+    lapStart = Clock::now();
+  }
+  if (opt.send) Transport::loop();
+
+  const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  fprintf(stderr, "replayed %llu frames / %llu msgs in %.3f s (%.0f msgs/s), %llu send failures, %u unparsed frames\n",
+          (unsigned long long)frames, (unsigned long long)msgs, secs, secs > 0 ? msgs / secs : 0.0,
+          (unsigned long long)sendFail, badFrames);
+  return (badFrames || bad) ? 1 : 0;
+}
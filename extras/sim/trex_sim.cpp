@@ -0,0 +1,565 @@
+// trex_sim.cpp — multi-station TREX simulator for a Linux dev box.
+//
+// Runs one T-Rex server (through the real Transport API on the host backend)
+// plus N virtual stations in one process. Stations share one socket pair on the
+// same loopback multicast group and each gets its own impaired link (loss,
+// delay, jitter, reorder) in both directions, so the full wire header +
+// MsgHeader + payload path is exercised the way it is over the air.
+//
+// Build (from this directory):
+//   g++ -std=c++17 -O2 -DTREX_USE_HOST=1 -I../../src trex_sim.cpp ../../src/TrexTransportHost.cpp ../../src/TrexTransportCommon.cpp -o trex_sim
+//
+// Add -DTREX_HOST_TX_BATCH=32 to batch the server's sends into sendmmsg().
+//
+// Example:
+//   ./trex_sim --stations 40 --seconds 10 --loss 5 --delay 8 --jitter 4 --reorder 10
+//
+// Exit status is non-zero if any frame failed to decode (size/type mismatch),
+// so it can gate a regression run.
+
+#include "TrexBuildConfig.h"
+#include "TrexAggregate.h"
+#include "TrexCompact.h"
+#include "TrexMsgRegistry.h"
+#include "TrexProtocol.h"
+#include "TrexReliable.h"
+#include "TrexStats.h"
+#include "TrexTransportCommon.h"
+#include "TrexStatusSync.h"
+#include "TrexTransport.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <queue>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static uint32_t nowUs() {
+  using namespace std::chrono;
+  static const auto t0 = steady_clock::now();
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now() - t0).count();
+}
+
+// ---------------------------------------------------------------- options
+struct SimOptions {
+  int      stations   = 24;
+  int      seconds    = 10;
+  double   lossPct    = 0.0;   // per direction, per receiver
+  uint32_t delayMs    = 0;
+  uint32_t jitterMs   = 0;
+  double   reorderPct = 0.0;   // this share skips the delay line (netem-style)
+  double   dupPct     = 0.0;   // this share is delivered twice
+  uint32_t tickHz     = 10;    // server GAME_STATUS + STATE_TICK rate
+  uint32_t holdHz     = 2;     // LOOT_HOLD_START rate per station
+  uint8_t  channel    = 6;
+  bool     framed     = true;
+  bool     compact    = false; // everyone sends TREX_WIRE_VERSION_COMPACT (TrexCompact.h)
+  bool     aggregate  = false; // server coalesces its broadcasts (TREX_MSGF_MORE)
+  uint16_t flushMs    = 5;
+  bool     delta      = false; // STATUS_KEYFRAME/DELTA instead of GAME_STATUS + STATE_TICK
+  bool     reliable   = false; // LOOT_HOLD_START / LOOT_HOLD_ACK over the reliable channel
+  bool     dedupe     = false; // server drops seq duplicates (TransportConfig.rxDedupe)
+  bool     stats      = false; // dump the server's TrexStats report at the end
+  uint32_t seed       = 1;
+};
+
+static void usage() {
+  fprintf(stderr,
+    "usage: trex_sim [--stations N] [--seconds S] [--loss PCT] [--delay MS]\n"
+    "                [--jitter MS] [--reorder PCT] [--dup PCT] [--tick-hz HZ] [--hold-hz HZ]\n"
+    "                [--channel CH] [--legacy] [--compact] [--aggregate] [--flush-ms MS]\n"
+    "                [--delta] [--reliable] [--dedupe] [--stats] [--seed N]\n");
+}
+
+static bool parseArgs(int argc, char** argv, SimOptions& o) {
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    auto take = [&](const char* name) { if (strcmp(a, name) == 0 && v) { ++i; return true; } return false; };
+    if      (take("--stations")) o.stations   = atoi(v);
+    else if (take("--seconds"))  o.seconds    = atoi(v);
+    else if (take("--loss"))     o.lossPct    = atof(v);
+    else if (take("--delay"))    o.delayMs    = (uint32_t)atoi(v);
+    else if (take("--jitter"))   o.jitterMs   = (uint32_t)atoi(v);
+    else if (take("--reorder"))  o.reorderPct = atof(v);
+    else if (take("--dup"))      o.dupPct     = atof(v);
+    else if (take("--tick-hz"))  o.tickHz     = (uint32_t)atoi(v);
+    else if (take("--hold-hz"))  o.holdHz     = (uint32_t)atoi(v);
+    else if (take("--channel"))  o.channel    = (uint8_t)atoi(v);
+    else if (take("--seed"))     o.seed       = (uint32_t)atoi(v);
+    else if (take("--flush-ms")) o.flushMs    = (uint16_t)atoi(v);
+    else if (strcmp(a, "--aggregate") == 0) o.aggregate = true;
+    else if (strcmp(a, "--delta") == 0)     o.delta     = true;
+    else if (strcmp(a, "--reliable") == 0)  o.reliable  = true;
+    else if (strcmp(a, "--dedupe") == 0)    o.dedupe    = true;
+    else if (strcmp(a, "--stats") == 0)     o.stats     = true;
+    else if (strcmp(a, "--compact") == 0)   o.compact   = true;
+    else if (strcmp(a, "--legacy") == 0) o.framed = false;
+    else { usage(); return false; }
+  }
+  if (o.stations < 1 || o.stations > 250 || o.seconds < 1 || o.tickHz == 0) { usage(); return false; }
+  return true;
+}
+
+// ---------------------------------------------------------------- encoding
+template <class P>
+static uint16_t buildMsg(uint8_t* out, MsgType type, uint8_t src, uint16_t seq, const P& p) {
+  MsgHeader h;
+  h.version      = TREX_PROTO_VERSION;
+  h.type         = (uint8_t)type;
+  h.srcStationId = src;
+  h.flags        = 0;
+  h.payloadLen   = sizeof(P);
+  h.seq          = seq;
+  memcpy(out, &h, sizeof(h));
+  memcpy(out + sizeof(h), &p, sizeof(P));
+  return (uint16_t)(sizeof(h) + sizeof(P));
+}
+
+// Parse one message; false if it is not a well-formed TREX message.
+static bool parseMsg(const uint8_t* data, uint16_t len, MsgHeader& h, const uint8_t*& payload) {
+  if (len < sizeof(MsgHeader)) return false;
+  memcpy(&h, data, sizeof(h));
+  if (h.version != TREX_PROTO_VERSION) return false;
+  if ((size_t)h.payloadLen + sizeof(MsgHeader) > len) return false;
+  payload = data + sizeof(MsgHeader);
+  return true;
+}
+
+template <class P>
+static bool readPayload(const MsgHeader& h, const uint8_t* payload, P& out) {
+  if (h.payloadLen < sizeof(P)) return false;
+  memcpy(&out, payload, sizeof(P));
+  return true;
+}
+
+// ---------------------------------------------------------------- impaired link
+struct Packet {
+  uint32_t dueUs;
+  uint32_t order;
+  std::vector<uint8_t> bytes;
+  bool operator>(const Packet& o) const {
+    return dueUs != o.dueUs ? (int32_t)(dueUs - o.dueUs) > 0 : order > o.order;
+  }
+};
+
+class Link {
+public:
+  Link(const SimOptions& o, std::mt19937& rng) : opt_(o), rng_(rng) {}
+
+  // Returns false if the packet is lost.
+  bool push(const uint8_t* data, uint16_t len) {
+    std::uniform_real_distribution<double> pct(0.0, 100.0);
+    if (opt_.lossPct > 0 && pct(rng_) < opt_.lossPct) return false;
+    uint32_t delayUs = opt_.delayMs * 1000;
+    if (opt_.jitterMs) delayUs += std::uniform_int_distribution<uint32_t>(0, opt_.jitterMs * 1000)(rng_);
+    if (opt_.reorderPct > 0 && pct(rng_) < opt_.reorderPct) delayUs = 0;
+    q_.push(Packet{nowUs() + delayUs, order_++, std::vector<uint8_t>(data, data + len)});
+    if (opt_.dupPct > 0 && pct(rng_) < opt_.dupPct)
+      q_.push(Packet{nowUs() + delayUs + 1000, order_++, std::vector<uint8_t>(data, data + len)});
+    return true;
+  }
+
+  template <class Fn>
+  void drain(Fn fn) {
+    const uint32_t now = nowUs();
+    while (!q_.empty() && (int32_t)(now - q_.top().dueUs) >= 0) {
+      Packet p = q_.top();
+      q_.pop();
+      fn(p.bytes.data(), (uint16_t)p.bytes.size());
+    }
+  }
+
+private:
+  const SimOptions& opt_;
+  std::mt19937&     rng_;
+  uint32_t          order_ = 0;
+  std::priority_queue<Packet, std::vector<Packet>, std::greater<Packet>> q_;
+};
+
+// ---------------------------------------------------------------- counters
+struct SimStats {
+  uint64_t srvRx = 0, srvTx = 0, srvBad = 0;
+  uint64_t staTx = 0, staRx = 0, staBad = 0, staLostTx = 0, staLostRx = 0;
+  uint64_t holdsSent = 0, holdsAcked = 0;
+  uint64_t tickRx = 0;
+  uint64_t srvFrames = 0;   // server frames on the air (one aggregate = one frame)
+  uint64_t srvBytes  = 0;
+  uint64_t keyReqs   = 0;
+  std::vector<uint32_t> ackLatencyUs;
+};
+static SimStats g_stats;
+
+// ---------------------------------------------------------------- server (real Transport API)
+static uint32_t g_teamScore = 0;
+static StatusSync::Encoder g_statusEnc;
+static bool g_reliable = false;
+
+static void serverSend(MsgType t, const void* p, uint16_t n) {
+  static TxFrame f;
+  uint8_t* out = f.begin(t, 0, n);
+  if (!out) return;
+  memcpy(out, p, n);
+  if (Transport::broadcast(f)) ++g_stats.srvTx;
+}
+
+struct SimServer {
+  void on(const MsgHeader& h, const HelloPayload& hp) {
+    if (hp.stationId != h.srcStationId) ++g_stats.srvBad;
+  }
+  void on(const MsgHeader&, const HeartbeatPayload&) {}
+  void on(const MsgHeader& h, const LootHoldStartPayload& s) {
+    LootHoldAckPayload a{};
+    a.holdId = s.holdId; a.accepted = 1; a.rateHz = 1; a.maxCarry = 8;
+    a.inventory = 40; a.capacity = 40;
+    if (!g_reliable) { serverSend(MsgType::LOOT_HOLD_ACK, &a, sizeof(a)); return; }
+    static TxFrame f;
+    *f.begin<LootHoldAckPayload>(MsgType::LOOT_HOLD_ACK, 0) = a;
+    if (Transport::sendReliable(h.srcStationId, f)) ++g_stats.srvTx;
+  }
+  void on(const MsgHeader&, const LootHoldStopPayload& s) {
+    HoldEndPayload e{s.holdId, 0};
+    serverSend(MsgType::HOLD_END, &e, sizeof(e));
+    g_teamScore += 1;
+  }
+  void on(const MsgHeader&, const StatusKeyReqPayload&) {
+    g_statusEnc.requestKeyframe();
+  }
+};
+static SimServer g_server;
+static MsgDispatcher<SimServer> g_serverRx(g_server);
+
+static void serverRx(const uint8_t* data, uint16_t len) {
+  if (g_serverRx.dispatch(data, len) == DispatchResult::HANDLED) ++g_stats.srvRx;
+  else ++g_stats.srvBad;
+}
+
+// ---------------------------------------------------------------- virtual stations
+struct VirtualStation {
+  uint8_t  id;
+  uint16_t seq = 0;
+  uint32_t nextHeartbeatUs = 0;
+  uint32_t nextHoldUs = 0;
+  uint32_t pendingHoldId = 0;
+  uint32_t pendingSinceUs = 0;
+  StatusSync::Decoder status;
+  TrexReliableChannel rel;
+  Link*    up;    // station -> server
+  Link*    down;  // server  -> station
+};
+
+class StationSide {
+public:
+  bool open(uint8_t channel) {
+    const char* grp  = getenv("TREX_HOST_GROUP");
+    const char* port = getenv("TREX_HOST_PORT");
+    memset(&group_, 0, sizeof(group_));
+    group_.sin_family = AF_INET;
+    group_.sin_port   = htons((uint16_t)((port ? atoi(port) : 33333) + channel));
+    inet_pton(AF_INET, grp ? grp : "239.84.88.1", &group_.sin_addr);
+
+    in_addr loop; loop.s_addr = htonl(INADDR_LOOPBACK);
+    int one = 1;
+    rx_ = socket(AF_INET, SOCK_DGRAM, 0);
+    tx_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rx_ < 0 || tx_ < 0) return false;
+    setsockopt(rx_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in b; memset(&b, 0, sizeof(b));
+    b.sin_family = AF_INET; b.sin_port = group_.sin_port; b.sin_addr.s_addr = htonl(INADDR_ANY);
+    ip_mreq m; m.imr_multiaddr = group_.sin_addr; m.imr_interface = loop;
+    if (bind(rx_, (sockaddr*)&b, sizeof(b)) != 0) return false;
+    if (setsockopt(rx_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &m, sizeof(m)) != 0) return false;
+    fcntl(rx_, F_SETFL, fcntl(rx_, F_GETFL, 0) | O_NONBLOCK);
+    setsockopt(tx_, IPPROTO_IP, IP_MULTICAST_IF, &loop, sizeof(loop));
+    setsockopt(tx_, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+    sockaddr_in any; memset(&any, 0, sizeof(any)); any.sin_family = AF_INET;
+    socklen_t al = sizeof(any);
+    if (bind(tx_, (sockaddr*)&any, sizeof(any)) != 0 || getsockname(tx_, (sockaddr*)&any, &al) != 0) return false;
+    txPort_ = ntohs(any.sin_port);
+    return true;
+  }
+
+  void send(const uint8_t* msg, uint16_t len, bool framed, bool compact) {
+    uint8_t buf[260];
+    uint16_t off = 0;
+    if (framed && compact) {
+      const uint16_t n = trexCompactFrame(msg, len, buf, sizeof(buf));
+      if (n) { sendto(tx_, buf, n, 0, (sockaddr*)&group_, sizeof(group_)); return; }
+    }
+    if (framed) {
+      buf[0] = (uint8_t)TREX_WIRE_MAGIC0; buf[1] = (uint8_t)TREX_WIRE_MAGIC1; buf[2] = (uint8_t)TREX_WIRE_VERSION;
+      off = 3;
+    }
+    memcpy(buf + off, msg, len);
+    sendto(tx_, buf, off + len, 0, (sockaddr*)&group_, sizeof(group_));
+  }
+
+  // Calls fn(msg, len, airLen) for each frame heard from another node, wire
+  // header stripped; compact frames are rebuilt as plain (aggregate) records.
+  template <class Fn>
+  void poll(Fn fn) {
+    uint8_t buf[512], plain[512];
+    for (;;) {
+      sockaddr_in from; socklen_t fl = sizeof(from);
+      ssize_t n = recvfrom(rx_, buf, sizeof(buf), 0, (sockaddr*)&from, &fl);
+      if (n < 0) break;
+      if (ntohs(from.sin_port) == txPort_) continue;
+      const bool framed = n >= 3 && buf[0] == (uint8_t)TREX_WIRE_MAGIC0 &&
+                          buf[1] == (uint8_t)TREX_WIRE_MAGIC1 && buf[2] == (uint8_t)TREX_WIRE_VERSION;
+      const bool compact = n >= 3 && buf[0] == (uint8_t)TREX_WIRE_MAGIC0 &&
+                           buf[1] == (uint8_t)TREX_WIRE_MAGIC1 && buf[2] == (uint8_t)TREX_WIRE_VERSION_COMPACT;
+      if (compact) {
+        uint16_t off = 0;
+        const bool ok = trexForEachWireRecord(buf[2], buf + 3, (uint16_t)(n - 3), [&](const uint8_t* m, uint16_t mn) {
+          if (off + mn <= sizeof(plain)) { memcpy(plain + off, m, mn); off = (uint16_t)(off + mn); }
+        });
+        fn(plain, ok ? off : (uint16_t)0, (uint16_t)n);
+      }
+      else if (framed) fn(buf + 3, (uint16_t)(n - 3), (uint16_t)n);
+      else             fn(buf, (uint16_t)n, (uint16_t)n);
+    }
+  }
+
+private:
+  int rx_ = -1, tx_ = -1;
+  uint16_t txPort_ = 0;
+  sockaddr_in group_;
+};
+
+// ---------------------------------------------------------------- main
+static uint32_t percentile(std::vector<uint32_t>& v, double p) {
+  if (v.empty()) return 0;
+  size_t k = (size_t)(p * (v.size() - 1) + 0.5);
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+int main(int argc, char** argv) {
+  SimOptions opt;
+  if (!parseArgs(argc, argv, opt)) return 2;
+  std::mt19937 rng(opt.seed);
+
+  TransportConfig cfg{};
+  cfg.maintenanceMode = false;
+  cfg.wifiChannel     = opt.channel;
+  cfg.txFramed        = opt.framed;
+  cfg.wireVersion     = opt.compact ? TREX_WIRE_VERSION_COMPACT : TREX_WIRE_VERSION;
+  cfg.rxAcceptLegacy  = true;
+  cfg.txAggregate     = opt.aggregate;
+  cfg.aggFlushMs      = opt.flushMs;
+  cfg.stationId       = 0;
+  cfg.rxDedupe        = opt.dedupe;
+  g_reliable          = opt.reliable;
+  if (!Transport::init(cfg, serverRx)) { fprintf(stderr, "Transport::init failed\n"); return 2; }
+
+  StationSide side;
+  if (!side.open(opt.channel)) { fprintf(stderr, "station socket setup failed\n"); return 2; }
+
+  std::vector<Link> links;
+  links.reserve(opt.stations * 2);
+  std::vector<VirtualStation> st(opt.stations);
+  for (int i = 0; i < opt.stations; ++i) {
+    links.emplace_back(opt, rng);
+    links.emplace_back(opt, rng);
+    st[i].id   = (uint8_t)(i + 1);
+    st[i].up   = &links[i * 2];
+    st[i].down = &links[i * 2 + 1];
+    // Spread the first events so the stations don't all fire on the same tick.
+    st[i].nextHeartbeatUs = (uint32_t)(i * 997) % 1000000;
+    st[i].nextHoldUs      = (uint32_t)(i * 7919) % (1000000 / std::max<uint32_t>(opt.holdHz, 1));
+    st[i].rel.begin(st[i].id, opt.seed * 977u + i, [](void* ctx, uint8_t, const uint8_t* m, uint16_t n) {
+      auto* s = static_cast<VirtualStation*>(ctx);
+      ++g_stats.staTx;
+      if (!s->up->push(m, n)) ++g_stats.staLostTx;
+      return true;
+    }, &st[i]);
+  }
+
+  auto stationSend = [&](VirtualStation& s, MsgType t, const auto& p) {
+    uint8_t m[250];
+    uint16_t n = buildMsg(m, t, s.id, s.seq++, p);
+    ++g_stats.staTx;
+    if (!s.up->push(m, n)) ++g_stats.staLostTx;
+  };
+  auto stationSendReliable = [&](VirtualStation& s, MsgType t, const auto& p) {
+    uint8_t m[250];
+    uint16_t n = buildMsg(m, t, s.id, s.seq++, p);
+    s.rel.send(0, m, n, nowUs() / 1000);
+  };
+
+  for (auto& s : st) {
+    HelloPayload h{};
+    h.stationType = (uint8_t)StationType::LOOT;
+    h.stationId   = s.id;
+    h.fwMajor = 0; h.fwMinor = 5;
+    h.wifiChannel = opt.channel;
+    h.mac[5] = s.id;
+    stationSend(s, MsgType::HELLO, h);
+  }
+
+  const uint32_t tickPeriodUs = 1000000 / opt.tickHz;
+  const uint32_t holdPeriodUs = opt.holdHz ? 1000000 / opt.holdHz : 0;
+  const uint32_t startUs = nowUs();
+  const uint32_t endUs   = startUs + (uint32_t)opt.seconds * 1000000u;
+  uint32_t nextTickUs = startUs;
+  uint32_t gameMsLeft = (uint32_t)opt.seconds * 1000;
+
+  while ((int32_t)(nowUs() - endUs) < 0) {
+    const uint32_t now = nowUs();
+
+    // Server: periodic broadcasts, then pump its transport.
+    // The periodic broadcasts are built in place (zero-copy TxFrame path).
+    if ((int32_t)(now - nextTickUs) >= 0) {
+      nextTickUs += tickPeriodUs;
+      static TxFrame statusFrame, tickFrame;
+      if (opt.delta) {
+        GameStatusPayload gs{};
+        gs.teamScore = g_teamScore; gs.msLeftGame = gameMsLeft; gs.msLeftRound = gameMsLeft;
+        gs.roundIndex = 1; gs.phase = 1; gs.lightState = (uint8_t)LightState::GREEN;
+        StateTickPayload tk{1, gameMsLeft};
+        if (g_statusEnc.build(statusFrame, gs, tk, now / 1000) && Transport::broadcast(statusFrame)) ++g_stats.srvTx;
+      } else {
+        auto* gs = statusFrame.begin<GameStatusPayload>(MsgType::GAME_STATUS, 0);
+        gs->teamScore = g_teamScore; gs->msLeftGame = gameMsLeft; gs->msLeftRound = gameMsLeft;
+        gs->roundIndex = 1; gs->phase = 1; gs->lightState = (uint8_t)LightState::GREEN;
+        if (Transport::broadcast(statusFrame)) ++g_stats.srvTx;
+        auto* tk = tickFrame.begin<StateTickPayload>(MsgType::STATE_TICK, 0);
+        tk->state = 1; tk->msLeft = gameMsLeft;
+        if (Transport::broadcast(tickFrame)) ++g_stats.srvTx;
+      }
+      gameMsLeft = gameMsLeft > 1000 / opt.tickHz ? gameMsLeft - 1000 / opt.tickHz : 0;
+    }
+    Transport::loop();
+
+    // Air: server frames fan out to every station's downlink.
+    // Loss is per frame, so a lost aggregate takes all of its messages with it.
+    side.poll([&](const uint8_t* f, uint16_t fn, uint16_t air) {
+      MsgHeader h; const uint8_t* p;
+      if (!parseMsg(f, fn, h, p)) { ++g_stats.staBad; return; }
+      if (h.srcStationId != 0) return;  // other stations' chatter
+      ++g_stats.srvFrames;
+      g_stats.srvBytes += air;
+      for (auto& s : st) if (!s.down->push(f, fn)) ++g_stats.staLostRx;
+    });
+
+    // Stations: deliver impaired downlink, generate traffic, flush uplink.
+    for (auto& s : st) {
+      s.down->drain([&](const uint8_t* f, uint16_t fn) { trexForEachRecord(f, fn, [&](const uint8_t* rm, uint16_t rn) {
+        uint8_t  relOut[256];
+        uint16_t n = rn;
+        const uint8_t* m = rm;
+        switch (s.rel.onRx(rm, rn, nowUs() / 1000, relOut, n)) {
+          case TrexReliableChannel::Rx::PASS:    n = rn; break;
+          case TrexReliableChannel::Rx::DELIVER: m = relOut; break;
+          case TrexReliableChannel::Rx::DROP:    return;
+        }
+        MsgHeader h; const uint8_t* p;
+        if (!parseMsg(m, n, h, p)) { ++g_stats.staBad; return; }
+        ++g_stats.staRx;
+        if ((MsgType)h.type == MsgType::LOOT_HOLD_ACK) {
+          LootHoldAckPayload a;
+          if (!readPayload(h, p, a)) { ++g_stats.staBad; return; }
+          if (s.pendingHoldId && a.holdId == s.pendingHoldId) {
+            g_stats.ackLatencyUs.push_back(nowUs() - s.pendingSinceUs);
+            ++g_stats.holdsAcked;
+            LootHoldStopPayload stop{a.holdId};
+            stationSend(s, MsgType::LOOT_HOLD_STOP, stop);
+            s.pendingHoldId = 0;
+          }
+        } else if ((MsgType)h.type == MsgType::STATE_TICK) {
+          StateTickPayload t;
+          if (!readPayload(h, p, t)) ++g_stats.staBad; else ++g_stats.tickRx;
+        } else if ((MsgType)h.type == MsgType::STATUS_KEYFRAME) {
+          StatusKeyframePayload k;
+          if (!readPayload(h, p, k)) { ++g_stats.staBad; return; }
+          if (s.status.onKeyframe(k)) ++g_stats.tickRx;
+        } else if ((MsgType)h.type == MsgType::STATUS_DELTA) {
+          StatusDeltaPayload d{};
+          memcpy(&d, p, std::min<size_t>(h.payloadLen, sizeof(d)));
+          if (s.status.onDelta(d, h.payloadLen)) {
+            ++g_stats.tickRx;
+            // The sim drives both timers from one clock, so they must agree.
+            if (s.status.status().msLeftGame != s.status.tick().msLeft) ++g_stats.staBad;
+          }
+        }
+      }); });
+      static TxFrame keyReq;
+      if (s.status.wantKeyframe(now / 1000) && s.status.buildKeyRequest(keyReq, s.id)) {
+        keyReq.header()->seq = s.seq++;
+        ++g_stats.keyReqs;
+        ++g_stats.staTx;
+        if (!s.up->push(reinterpret_cast<const uint8_t*>(keyReq.header()),
+                        (uint16_t)(sizeof(MsgHeader) + keyReq.header()->payloadLen))) ++g_stats.staLostTx;
+      }
+
+      if ((int32_t)(now - startUs - s.nextHeartbeatUs) >= 0) {
+        s.nextHeartbeatUs += 1000000;
+        HelloPayload hb{};
+        hb.stationType = (uint8_t)StationType::LOOT; hb.stationId = s.id;
+        stationSend(s, MsgType::HEARTBEAT, hb);
+      }
+      if (holdPeriodUs && (int32_t)(now - startUs - s.nextHoldUs) >= 0) {
+        s.nextHoldUs += holdPeriodUs;
+        LootHoldStartPayload hs{};
+        hs.holdId    = ((uint32_t)s.id << 24) | (s.seq & 0xFFFFFF);
+        hs.stationId = s.id;
+        hs.uid.len   = 4;
+        memcpy(hs.uid.bytes, &hs.holdId, 4);
+        s.pendingHoldId  = hs.holdId;   // a lost ack just gets superseded
+        s.pendingSinceUs = now;
+        ++g_stats.holdsSent;
+        if (opt.reliable) stationSendReliable(s, MsgType::LOOT_HOLD_START, hs);
+        else              stationSend(s, MsgType::LOOT_HOLD_START, hs);
+      }
+      s.rel.poll(now / 1000);
+      s.up->drain([&](const uint8_t* m, uint16_t n) { side.send(m, n, opt.framed, opt.compact); });
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+
+  const double secs = (nowUs() - startUs) / 1e6;
+  auto& lat = g_stats.ackLatencyUs;
+  printf("stations=%d seconds=%.1f loss=%.1f%% delay=%ums jitter=%ums reorder=%.1f%% framed=%d compact=%d aggregate=%d\n",
+         opt.stations, secs, opt.lossPct, opt.delayMs, opt.jitterMs, opt.reorderPct,
+         opt.framed ? 1 : 0, opt.compact ? 1 : 0, opt.aggregate ? 1 : 0);
+  printf("server : rx=%llu (%.0f/s) tx=%llu (%.0f/s) bad=%llu\n",
+         (unsigned long long)g_stats.srvRx, g_stats.srvRx / secs,
+         (unsigned long long)g_stats.srvTx, g_stats.srvTx / secs, (unsigned long long)g_stats.srvBad);
+  printf("air    : server frames=%llu bytes=%llu (%.2f msgs/frame) keyreqs=%llu\n",
+         (unsigned long long)g_stats.srvFrames, (unsigned long long)g_stats.srvBytes,
+         g_stats.srvFrames ? (double)g_stats.srvTx / g_stats.srvFrames : 0.0,
+         (unsigned long long)g_stats.keyReqs);
+  printf("station: tx=%llu rx=%llu ticks=%llu lostUp=%llu lostDown=%llu bad=%llu\n",
+         (unsigned long long)g_stats.staTx, (unsigned long long)g_stats.staRx,
+         (unsigned long long)g_stats.tickRx, (unsigned long long)g_stats.staLostTx,
+         (unsigned long long)g_stats.staLostRx, (unsigned long long)g_stats.staBad);
+  if (opt.reliable) {
+    const auto& r = TransportCommon::reliableStats();
+    printf("rel    : server sent=%u retx=%u fastRetx=%u giveUps=%u windowFull=%u dupRx=%u holesSkipped=%u\n",
+           r.sent, r.retransmits, r.fastRetransmits, r.giveUps, r.windowFull, r.duplicates, r.holesSkipped);
+  }
+  {
+    const TrexSeqWindow& w = TransportCommon::seqWindow();
+    unsigned lost = 0, dups = 0;
+    for (int i = 0; i < 256; ++i) if (w.known((uint8_t)i)) { lost += w.sender((uint8_t)i).lost; dups += w.sender((uint8_t)i).dups; }
+    if (opt.dedupe) printf("seq    : server saw lost=%u duplicates/stale dropped=%u\n", lost, dups);
+  }
+  printf("holds  : sent=%llu acked=%llu (%.1f%%)\n",
+         (unsigned long long)g_stats.holdsSent, (unsigned long long)g_stats.holdsAcked,
+         g_stats.holdsSent ? 100.0 * g_stats.holdsAcked / g_stats.holdsSent : 0.0);
+  printf("ack us : p50=%u p99=%u max=%u\n",
+         percentile(lat, 0.50), percentile(lat, 0.99), lat.empty() ? 0 : *std::max_element(lat.begin(), lat.end()));
+  if (opt.stats) TrexStats::writeReport([](const char* line) { fputs(line, stdout); });
+
+  return (g_stats.srvBad || g_stats.staBad) ? 1 : 0;
+}
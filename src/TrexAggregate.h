@@ -0,0 +1,92 @@
+#pragma once
+// TrexAggregate.h — pack several small TREX messages into one radio frame.
+//
+// An aggregate frame is just back-to-back [MsgHeader][payload] records; every
+// record except the last has TREX_MSGF_MORE set in MsgHeader.flags. Firmware
+// that predates aggregation therefore still parses the first record and
+// ignores the rest, so turn txAggregate on only once the fleet understands it.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "TrexProtocol.h"
+
+// True if data is exactly one well-formed MsgHeader record.
+static inline bool trexIsSingleRecord(const uint8_t* data, uint16_t len) {
+  if (!data || len < sizeof(MsgHeader)) return false;
+  MsgHeader h;
+  memcpy(&h, data, sizeof(h));
+  return (uint32_t)h.payloadLen + sizeof(MsgHeader) == len;
+}
+
+// Calls fn(record, recordLen) for each message in a received frame (wire header
+// already stripped). Frames whose first record doesn't carry TREX_MSGF_MORE are
+// passed through untouched, trailing bytes and all, exactly as before.
+// Returns false if an aggregate ended in a truncated record (which is dropped).
+template <class Fn>
+inline bool trexForEachRecord(const uint8_t* data, uint16_t len, Fn fn) {
+  if (len < sizeof(MsgHeader) || !(data[offsetof(MsgHeader, flags)] & TREX_MSGF_MORE)) {
+    fn(data, len);
+    return true;
+  }
+  uint16_t off = 0;
+  while ((uint32_t)off + sizeof(MsgHeader) <= len) {
+    MsgHeader h;
+    memcpy(&h, data + off, sizeof(h));
+    const uint32_t recLen = sizeof(MsgHeader) + (uint32_t)h.payloadLen;
+    if (off + recLen > len) return false;  // truncated tail: drop it
+    fn(data + off, (uint16_t)recLen);
+    off = (uint16_t)(off + recLen);
+    if (!(h.flags & TREX_MSGF_MORE)) return true;
+  }
+  return false;
+}
+
+// Coalescing buffer with wire-header headroom (see TxFrame). Holds messages
+// until the frame is full or the oldest has waited flushMs.
+template <uint16_t FrameBytes>
+class TrexAggregator {
+public:
+  static constexpr uint16_t kWireHdrLen = 3;
+
+  void setFlushMs(uint16_t ms) { flushMs_ = ms; }
+
+  bool empty() const { return len_ == 0; }
+  uint16_t count() const { return count_; }
+
+  // True if msg can be appended without flushing first.
+  bool fits(uint16_t msgLen) const { return (uint32_t)kWireHdrLen + len_ + msgLen <= FrameBytes; }
+
+  // Caller checks trexIsSingleRecord() and fits() first.
+  void add(const uint8_t* msg, uint16_t msgLen, uint32_t nowMs) {
+    if (len_ == 0) firstMs_ = nowMs;
+    else buf_[kWireHdrLen + lastOff_ + offsetof(MsgHeader, flags)] |= TREX_MSGF_MORE;
+    lastOff_ = len_;
+    memcpy(buf_ + kWireHdrLen + len_, msg, msgLen);
+    buf_[kWireHdrLen + len_ + offsetof(MsgHeader, flags)] &= (uint8_t)~TREX_MSGF_MORE;
+    len_ = (uint16_t)(len_ + msgLen);
+    ++count_;
+  }
+
+  bool due(uint32_t nowMs) const { return len_ && (uint32_t)(nowMs - firstMs_) >= flushMs_; }
+
+  // Bytes to put on the air (same framing contract as TxFrame::wire()).
+  const uint8_t* wire(bool framed, uint16_t& len) {
+    len = len_;
+    if (!framed) return buf_ + kWireHdrLen;
+    buf_[0] = (uint8_t)TREX_WIRE_MAGIC0;
+    buf_[1] = (uint8_t)TREX_WIRE_MAGIC1;
+    buf_[2] = (uint8_t)TREX_WIRE_VERSION;
+    len = (uint16_t)(len + kWireHdrLen);
+    return buf_;
+  }
+
+  void clear() { len_ = 0; count_ = 0; }
+
+private:
+  uint8_t  buf_[FrameBytes];
+  uint16_t len_     = 0;   // bytes after the headroom
+  uint16_t lastOff_ = 0;   // offset of the last record (to set its MORE bit)
+  uint16_t count_   = 0;
+  uint16_t flushMs_ = 5;
+  uint32_t firstMs_ = 0;
+};
@@ -1,3 +1,138 @@
 #pragma once
-#define TREX_USE_ESPNOW 1
+// Backend selection. Override with -D on the compiler command line; the host
+// tools under extras/ build with -DTREX_USE_HOST=1. ESP-NOW and UDP may both be
+// on: one firmware then carries both links and TransportConfig.links / route
+// pick between them at runtime.
+#ifndef TREX_USE_HOST
+#define TREX_USE_HOST   0   // Linux sockets (loopback multicast) for sim/bench on a dev box
+#endif
+#ifndef TREX_USE_ESPNOW
+#define TREX_USE_ESPNOW (!TREX_USE_HOST)
+#endif
+#ifndef TREX_USE_UDP
 #define TREX_USE_UDP    0
+#endif
+#if TREX_USE_HOST && (TREX_USE_ESPNOW || TREX_USE_UDP)
+#error "TREX_USE_HOST is for Linux builds and excludes the ESP32 backends"
+#endif
+
+// Armed RADIO_CFG: the announcing node repeats it this often until the switch.
+#ifndef TREX_RADIO_ANNOUNCE_MS
+#define TREX_RADIO_ANNOUNCE_MS 100
+#endif
+
+// Clock sync (TransportConfig.clockSync): station ping interval once synced.
+#ifndef TREX_CLOCK_PING_MS
+#define TREX_CLOCK_PING_MS     2000
+#endif
+
+// A message that arrives on two links within this window is delivered once.
+#ifndef TREX_MERGE_WINDOW_MS
+#define TREX_MERGE_WINDOW_MS   500
+#endif
+#ifndef TREX_MERGE_SLOTS
+#define TREX_MERGE_SLOTS       32
+#endif
+
+// ESP-NOW receive path: the radio callback only enqueues into a fixed ring and
+// Transport::loop() runs the RxHandler on the application task, at most
+// TREX_RX_BATCH frames per call, as the UDP link already does. Sketches must
+// call Transport::loop() from loop(); nothing is received otherwise. There is
+// no in-callback mode any more: the transport's own state (reliable channel,
+// dedupe, TX queue, peers) is only touched from the application task.
+#if defined(TREX_RX_DEFERRED) && !TREX_RX_DEFERRED
+#error "TREX_RX_DEFERRED 0 was removed: received frames are always delivered from Transport::loop()"
+#endif
+#ifndef TREX_RX_RING_DEPTH
+#define TREX_RX_RING_DEPTH 16   // power of two; ~256 B per slot
+#endif
+#ifndef TREX_RX_BATCH
+#define TREX_RX_BATCH      8
+#endif
+
+// ESP-NOW unicast peer cache (learned from received frames). The driver allows
+// 20 peers total; one is the broadcast peer. A peer that misses
+// TREX_PEER_MAX_FAILS MAC ACKs in a row is forgotten until heard from again.
+#ifndef TREX_PEER_CACHE
+#define TREX_PEER_CACHE     16
+#endif
+#ifndef TREX_PEER_MAX_FAILS
+#define TREX_PEER_MAX_FAILS 5
+#endif
+
+// Reliable channel (Transport::sendReliable): outstanding messages across all
+// destinations, and transmissions per message before it is given up.
+#ifndef TREX_REL_WINDOW
+#define TREX_REL_WINDOW    8
+#endif
+#ifndef TREX_REL_MAX_TRIES
+#define TREX_REL_MAX_TRIES 8
+#endif
+
+// ESP-NOW transmit scheduler: at most TREX_TX_INFLIGHT frames handed to the
+// driver and not yet completed by the send callback; the rest wait in
+// TREX_TX_QUEUE_DEPTH-deep FIFOs per priority class (see TrexTxQueue.h).
+// Set TREX_TX_QUEUE 0 to call esp_now_send() directly (old behaviour).
+#ifndef TREX_TX_QUEUE
+#define TREX_TX_QUEUE          1
+#endif
+#ifndef TREX_TX_QUEUE_DEPTH
+#define TREX_TX_QUEUE_DEPTH    8    // per class; ~256 B per slot
+#endif
+#ifndef TREX_TX_INFLIGHT
+#define TREX_TX_INFLIGHT       2
+#endif
+#ifndef TREX_TX_STALL_MS
+#define TREX_TX_STALL_MS       50   // completion overdue: assume it was lost
+#endif
+
+// UDP and host receive drain: each Transport::loop() handles up to
+// TREX_NET_RX_BATCH datagrams or TREX_NET_RX_BUDGET_US of work, whichever
+// comes first; the rest wait in the socket buffer for the next call.
+// Datagrams over TREX_NET_MAX_DATAGRAM are dropped and counted, not truncated.
+#ifndef TREX_NET_RX_BATCH
+#define TREX_NET_RX_BATCH      32
+#endif
+#ifndef TREX_NET_RX_BUDGET_US
+#define TREX_NET_RX_BUDGET_US  2000
+#endif
+#ifndef TREX_NET_MAX_DATAGRAM
+#define TREX_NET_MAX_DATAGRAM  1472   // Ethernet MTU minus IP/UDP headers
+#endif
+
+// UDP backend: a learned unicast endpoint not heard from for this long is
+// dropped and traffic to that station goes back to broadcast.
+#ifndef TREX_UDP_PEER_TTL_MS
+#define TREX_UDP_PEER_TTL_MS   10000
+#endif
+
+// Host backend only: queue up to this many outgoing datagrams and hand them to
+// the kernel with one sendmmsg() from Transport::loop() (or when the batch
+// fills). 0 = one sendto() per frame, sent immediately.
+#ifndef TREX_HOST_TX_BATCH
+#define TREX_HOST_TX_BATCH     0
+#endif
+
+// TrexLog.h: calls above TREX_LOG_LEVEL (0 off, 1 error, 2 warn, 3 info,
+// 4 debug) or in a module whose bit is clear in TREX_LOG_MODULES compile to
+// nothing. TREX_LOG_RING_BYTES (power of two) buffers records until the
+// logger task drains them; ~16-40 bytes per record.
+#ifndef TREX_LOG_LEVEL
+#define TREX_LOG_LEVEL         3
+#endif
+#ifndef TREX_LOG_MODULES
+#define TREX_LOG_MODULES       0xFFFFFFFFu
+#endif
+#ifndef TREX_LOG_RING_BYTES
+#define TREX_LOG_RING_BYTES    4096
+#endif
+
+// TrexCapture.h: 1 = record every frame sent and received into a
+// TREX_CAPTURE_BYTES ring (power of two, overwrite-oldest) for the 'cap'
+// console command and extras/replay. 0 = hooks compile to nothing.
+#ifndef TREX_CAPTURE
+#define TREX_CAPTURE           0
+#endif
+#ifndef TREX_CAPTURE_BYTES
+#define TREX_CAPTURE_BYTES     16384
+#endif
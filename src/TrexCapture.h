@@ -0,0 +1,259 @@
+#pragma once
+// TrexCapture.h — raw frame capture for reproducing field issues.
+//
+// With TREX_CAPTURE 1 every backend hands each datagram it receives (in
+// deliverRx, before anything is parsed) and each one it transmits (at the last
+// step before the driver, so aggregate and compact frames are recorded exactly
+// as sent) to rx() / tx(). Frames land in a byte ring with a micros()
+// timestamp, the link, the direction, the framed/legacy flag and, on ESP-NOW,
+// the peer MAC. A full ring overwrites its oldest frames, so it always holds
+// the most recent TREX_CAPTURE_BYTES of traffic.
+//
+//   cap stat | cap dump | cap save /cap.bin       (maintenance console)
+//   ./trex_replay cap.bin --speed 4 --decode       (extras/replay)
+//
+// A capture file is kFileHdr followed by the records as they sit in the ring:
+// RecHdr, the MAC if FL_MAC, then RecHdr.len frame bytes. With TREX_CAPTURE 0
+// rx() / tx() are empty and nothing is allocated.
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "TrexBuildConfig.h"
+#include "TrexProtocol.h"
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <mutex>
+#include <time.h>
+#endif
+
+namespace TrexCapture {
+
+enum : uint8_t {
+  FL_TX     = 0x01,   // sent by us (else received)
+  FL_FRAMED = 0x02,   // starts with the TREX wire header
+  FL_MAC    = 0x04,   // 6-byte peer MAC (ESP-NOW source / destination) follows RecHdr
+  FL_CUT    = 0x08    // longer than kMaxFrame; only the first kMaxFrame bytes kept
+};
+
+#pragma pack(push, 1)
+struct RecHdr {
+  uint16_t len;     // frame bytes stored after the header (and MAC)
+  uint8_t  flags;   // FL_*
+  uint8_t  link;    // TREX_LINK_* the frame used
+  uint32_t us;      // micros() when captured
+};
+struct FileHdr {
+  char     magic[4];   // "TRXC"
+  uint8_t  version;
+  uint8_t  recHdrLen;  // sizeof(RecHdr), so readers can skip fields added later
+  uint16_t reserved;
+};
+#pragma pack(pop)
+static_assert(sizeof(RecHdr) == 8, "RecHdr layout changed");
+
+static constexpr FileHdr  kFileHdr  = {{'T', 'R', 'X', 'C'}, 1, sizeof(RecHdr), 0};
+static constexpr uint16_t kMaxFrame = 256;   // ESP-NOW frames are <= 250, TREX datagrams <= 253
+
+struct Record {
+  RecHdr  h;
+  uint8_t mac[6];
+  uint8_t data[kMaxFrame];
+};
+
+inline uint32_t recordBytes(const RecHdr& h) { return sizeof(RecHdr) + ((h.flags & FL_MAC) ? 6u : 0u) + h.len; }
+
+// Next record from a capture file body; returns the bytes it took, 0 if what
+// is left isn't a whole, sane record.
+inline size_t parse(const uint8_t* d, size_t n, Record& r) {
+  if (n < sizeof(RecHdr)) return 0;
+  memcpy(&r.h, d, sizeof(RecHdr));
+  const uint32_t total = recordBytes(r.h);
+  if (r.h.len > kMaxFrame || total > n) return 0;
+  d += sizeof(RecHdr);
+  if (r.h.flags & FL_MAC) { memcpy(r.mac, d, 6); d += 6; }
+  memcpy(r.data, d, r.h.len);
+  return total;
+}
+
+// One text line per record: "cap <us> <flags> <link> <mac|-> <hex>". The
+// replay tool reads these back, so a console log works as a capture.
+inline int formatLine(const Record& r, char* out, size_t cap) {
+  int n = snprintf(out, cap, "cap %u %02x %02x ", (unsigned)r.h.us, r.h.flags, r.h.link);
+  if (r.h.flags & FL_MAC)
+    n += snprintf(out + n, cap - n, "%02x%02x%02x%02x%02x%02x ",
+                  r.mac[0], r.mac[1], r.mac[2], r.mac[3], r.mac[4], r.mac[5]);
+  else
+    n += snprintf(out + n, cap - n, "- ");
+  for (uint16_t i = 0; i < r.h.len && (size_t)n + 3 < cap; ++i) n += snprintf(out + n, cap - n, "%02x", r.data[i]);
+  n += snprintf(out + n, cap - n, "\r\n");
+  return n;
+}
+
+#if TREX_CAPTURE
+static_assert((TREX_CAPTURE_BYTES & (TREX_CAPTURE_BYTES - 1)) == 0 && TREX_CAPTURE_BYTES >= 1024,
+              "TREX_CAPTURE_BYTES must be a power of two >= 1024");
+
+// Ring of records at free-running byte positions [tail, head). Capture, the
+// console's Reader and sends from other tasks (or host threads) may overlap,
+// so both ends are guarded by a short critical section (one record copy).
+struct Ring {
+  uint8_t  buf[TREX_CAPTURE_BYTES];
+  uint32_t head = 0, tail = 0;
+  uint32_t frames = 0;        // captured since clear()
+  uint32_t overwritten = 0;   // of those, pushed out by newer ones
+  bool     on = true;
+#if defined(ARDUINO_ARCH_ESP32)
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+  void lock()   { portENTER_CRITICAL(&mux); }
+  void unlock() { portEXIT_CRITICAL(&mux); }
+#else
+  std::mutex m;
+  void lock()   { m.lock(); }
+  void unlock() { m.unlock(); }
+#endif
+
+  void put(uint32_t pos, const void* src, size_t n) {
+    const uint32_t i = pos & (TREX_CAPTURE_BYTES - 1), first = TREX_CAPTURE_BYTES - i;
+    if (n <= first) { memcpy(buf + i, src, n); return; }
+    memcpy(buf + i, src, first);
+    memcpy(buf, (const uint8_t*)src + first, n - first);
+  }
+  void get(uint32_t pos, void* dst, size_t n) const {
+    const uint32_t i = pos & (TREX_CAPTURE_BYTES - 1), first = TREX_CAPTURE_BYTES - i;
+    if (n <= first) { memcpy(dst, buf + i, n); return; }
+    memcpy(dst, buf + i, first);
+    memcpy((uint8_t*)dst + first, buf, n - first);
+  }
+};
+
+inline Ring& ring() {
+  static Ring r;
+  return r;
+}
+
+inline uint32_t nowUs() {
+#ifdef ARDUINO
+  return micros();
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u);
+#endif
+}
+
+// One frame given as head + body (the host backend sends the wire header
+// separately); mac may be nullptr.
+inline void record(uint8_t dirFlags, uint8_t link, const uint8_t* head, size_t headLen,
+                   const uint8_t* body, size_t bodyLen, const uint8_t* mac) {
+  Ring& r = ring();
+  if (!r.on || !head) return;
+  RecHdr h;
+  size_t total = headLen + bodyLen;
+  h.flags = dirFlags;
+  if (total > kMaxFrame) { total = kMaxFrame; h.flags |= FL_CUT; }
+  if (headLen >= 3 && head[0] == (uint8_t)TREX_WIRE_MAGIC0 && head[1] == (uint8_t)TREX_WIRE_MAGIC1) h.flags |= FL_FRAMED;
+  if (mac) h.flags |= FL_MAC;
+  h.len  = (uint16_t)total;
+  h.link = link;
+  h.us   = nowUs();
+  const size_t headPart = headLen < total ? headLen : total;
+  const uint32_t need   = recordBytes(h);
+
+  r.lock();
+  while (r.head - r.tail + need > TREX_CAPTURE_BYTES) {
+    RecHdr old;
+    r.get(r.tail, &old, sizeof(old));
+    r.tail += recordBytes(old);
+    ++r.overwritten;
+  }
+  uint32_t p = r.head;
+  r.put(p, &h, sizeof(h));                p += sizeof(h);
+  if (mac) { r.put(p, mac, 6);            p += 6; }
+  r.put(p, head, headPart);               p += (uint32_t)headPart;
+  if (total > headPart) r.put(p, body, total - headPart);
+  r.head += need;
+  ++r.frames;
+  r.unlock();
+}
+
+inline void rx(uint8_t link, const uint8_t* data, size_t len, const uint8_t* mac = nullptr) {
+  record(0, link, data, len, nullptr, 0, mac);
+}
+inline void tx(uint8_t link, const uint8_t* head, size_t headLen, const uint8_t* body = nullptr,
+               size_t bodyLen = 0, const uint8_t* mac = nullptr) {
+  record(FL_TX, link, head, headLen, body, bodyLen, mac);
+}
+
+inline void enable(bool on) { ring().on = on; }
+inline bool enabled()       { return ring().on; }
+
+inline void clear() {
+  Ring& r = ring();
+  r.lock();
+  r.tail = r.head;
+  r.frames = r.overwritten = 0;
+  r.unlock();
+}
+
+struct Info { uint32_t frames, overwritten, usedBytes; bool on; };
+
+inline Info info() {
+  Ring& r = ring();
+  r.lock();
+  const Info i = {r.frames, r.overwritten, r.head - r.tail, r.on};
+  r.unlock();
+  return i;
+}
+
+// Walks what the ring held when the walk started, oldest first, one record per
+// lock. Capture keeps running meanwhile; records overwritten before the reader
+// got to them are skipped.
+class Reader {
+public:
+  bool next(Record& out) {
+    Ring& r = ring();
+    r.lock();
+    if (!started_) { pos_ = r.tail; end_ = r.head; started_ = true; }
+    if ((int32_t)(pos_ - r.tail) < 0) pos_ = r.tail;
+    const bool more = (int32_t)(end_ - pos_) > 0;
+    if (more) {
+      uint32_t p = pos_;
+      r.get(p, &out.h, sizeof(RecHdr));  p += sizeof(RecHdr);
+      if (out.h.flags & FL_MAC) { r.get(p, out.mac, 6); p += 6; }
+      r.get(p, out.data, out.h.len);
+      pos_ += recordBytes(out.h);
+    }
+    r.unlock();
+    return more;
+  }
+
+private:
+  uint32_t pos_ = 0, end_ = 0;
+  bool     started_ = false;
+};
+
+// Writes a capture file (kFileHdr + records) through w.write(const uint8_t*,
+// size_t), e.g. a LittleFS File. Returns the number of records written.
+template <class W>
+inline uint32_t save(W& w) {
+  w.write((const uint8_t*)&kFileHdr, sizeof(kFileHdr));
+  Reader   rd;
+  Record   rec;
+  uint32_t n = 0;
+  while (rd.next(rec)) {
+    w.write((const uint8_t*)&rec.h, sizeof(RecHdr));
+    if (rec.h.flags & FL_MAC) w.write(rec.mac, 6);
+    w.write(rec.data, rec.h.len);
+    ++n;
+  }
+  return n;
+}
+
+#else
+inline void rx(uint8_t, const uint8_t*, size_t, const uint8_t* = nullptr) {}
+inline void tx(uint8_t, const uint8_t*, size_t, const uint8_t* = nullptr, size_t = 0, const uint8_t* = nullptr) {}
+#endif
+
+} // namespace TrexCapture
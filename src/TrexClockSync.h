@@ -0,0 +1,99 @@
+#pragma once
+// TrexClockSync.h — NTP-style estimate of the server clock on a station.
+//
+// The station sends TIME_PING {t1 = local send time}; the server answers
+// TIME_PONG {t1, t2 = server receive time, t3 = server send time}; the station
+// notes t4 on arrival. Per sample:
+//   rtt    = (t4 - t1) - (t3 - t2)
+//   offset = ((t2 - t1) + (t3 - t4)) / 2        // server - local
+// Of the last kSamples, the one with the smallest rtt wins (queueing only ever
+// adds delay, so it is the least skewed). Drift is the slope of that best
+// offset over a baseline of at least kDriftBaselineMs, smoothed, and is used to
+// extrapolate between samples.
+//
+// With an offset, the server can send absolute deadlines (its nowMs() + msLeft)
+// and every station converts them once with toLocal() instead of trusting a
+// msLeft that aged by however long the frame sat in queues.
+//
+// Transport-agnostic (clock passed in); Transport-level glue lives in
+// TrexTransportCommon.cpp.
+#include <stdint.h>
+#include <string.h>
+#include "TrexProtocol.h"
+
+class TrexClockSync {
+public:
+  static constexpr uint8_t  kSamples         = 8;
+  static constexpr uint8_t  kMinSamples      = 3;       // before synced()
+  static constexpr uint32_t kFastPingMs      = 250;     // until synced
+  static constexpr uint32_t kDriftBaselineMs = 30000;
+
+  void reset() { memset(this, 0, sizeof(*this)); }
+
+  // ---- station side ----
+  bool pingDue(uint32_t nowMs, uint32_t intervalMs) const {
+    const uint32_t every = count_ < kMinSamples ? kFastPingMs : intervalMs;
+    return !lastPingMs_ || (uint32_t)(nowMs - lastPingMs_) >= every;
+  }
+
+  void buildPing(TimePingPayload& p, uint32_t nowMs) {
+    p.t1 = nowMs;
+    lastPingMs_ = nowMs;
+  }
+
+  void onPong(const TimePongPayload& p, uint32_t t4) {
+    const int32_t rtt = (int32_t)(t4 - p.t1) - (int32_t)(p.t3 - p.t2);
+    if (rtt < 0 || (int32_t)(t4 - p.t1) < 0) return;          // bogus / not ours
+    Sample& s = ring_[next_];
+    s.rtt    = (uint32_t)rtt;
+    s.offset = (int32_t)(((int64_t)(int32_t)(p.t2 - p.t1) + (int32_t)(p.t3 - t4)) / 2);
+    s.local  = t4;
+    next_ = (uint8_t)((next_ + 1) % kSamples);
+    if (count_ < kSamples) ++count_;
+
+    const Sample* best = &ring_[0];
+    for (uint8_t i = 1; i < count_; ++i)
+      if (ring_[i].rtt < best->rtt) best = &ring_[i];
+    best_ = *best;
+
+    if (!haveAnchor_) { anchor_ = best_; haveAnchor_ = true; return; }
+    const uint32_t span = best_.local - anchor_.local;
+    if (span >= kDriftBaselineMs) {
+      const int32_t ppm = (int32_t)((int64_t)(best_.offset - anchor_.offset) * 1000000 / (int64_t)span);
+      driftPpm_ = haveDrift_ ? (driftPpm_ * 3 + ppm) / 4 : ppm;
+      haveDrift_ = true;
+      anchor_ = best_;
+    }
+  }
+
+  bool     synced()   const { return count_ >= kMinSamples; }
+  uint32_t rttMs()    const { return best_.rtt; }
+  int32_t  driftPpm() const { return driftPpm_; }
+
+  // server - local at local time localMs (drift-extrapolated from the best sample).
+  int32_t offsetAt(uint32_t localMs) const {
+    const int32_t dt = (int32_t)(localMs - best_.local);
+    return best_.offset + (int32_t)((int64_t)driftPpm_ * dt / 1000000);
+  }
+  uint32_t toServer(uint32_t localMs)  const { return localMs + (uint32_t)offsetAt(localMs); }
+  uint32_t toLocal(uint32_t serverMs)  const { return serverMs - (uint32_t)offsetAt(serverMs - (uint32_t)best_.offset); }
+
+  // ---- server side ----
+  static void answer(TimePongPayload& out, const TimePingPayload& in, uint8_t dstStationId,
+                     uint32_t rxMs, uint32_t txMs) {
+    out.dstStationId = dstStationId;
+    out.t1 = in.t1;
+    out.t2 = rxMs;
+    out.t3 = txMs;
+  }
+
+private:
+  struct Sample { uint32_t rtt; int32_t offset; uint32_t local; };
+  Sample   ring_[kSamples];
+  Sample   best_;
+  Sample   anchor_;
+  uint32_t lastPingMs_;
+  int32_t  driftPpm_;
+  uint8_t  next_, count_;
+  bool     haveAnchor_, haveDrift_;
+};
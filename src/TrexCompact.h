@@ -0,0 +1,366 @@
+#pragma once
+// TrexCompact.h — compact wire encoding (wire version TREX_WIRE_VERSION_COMPACT).
+//
+// Same messages, fewer bytes on the air. The MsgHeader/payload structs stay the
+// in-memory form: senders encode just before the driver, receivers decode back
+// into [MsgHeader][payload] records before anything else sees them.
+//
+//   frame  : [magic0][magic1][2] record record ...   (records run to the end)
+//   record : [type | 0x80 if ctl follows][ctl][src][seq lo][seq hi] body
+//   ctl    : MsgHeader.flags (MORE is implied) | TREX_CMP_OPAQUE | TREX_CMP_TAIL
+//   body   : the payload's fields per its schema below, varints for counters,
+//            length-prefixed strings; OPAQUE = varint length + raw payload (no
+//            schema, or shorter than the struct, e.g. legacy GAME_OVER);
+//            TAIL = schema fields, then varint length + the extra bytes (e.g.
+//            the reliable channel's trailer).
+//
+// payloadLen is implicit (it's the struct size unless OPAQUE/TAIL say
+// otherwise). Bytes after a string's NUL or a TrexUid's len aren't carried and
+// come back as zeros. Anything that can't be expressed (unknown proto version,
+// type >= 0x80) keeps the frame at wire version 1, as does a frame that
+// wouldn't shrink. Receivers accept both versions.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <utility>
+#include "TrexProtocol.h"
+#include "TrexMsgRegistry.h"
+#include "TrexAggregate.h"
+
+#define TREX_CMP_CTL     0x80   // in the type byte: a ctl byte follows
+#define TREX_CMP_OPAQUE  0x80   // in ctl: body is varint length + raw payload
+#define TREX_CMP_TAIL    0x40   // in ctl: schema fields, then varint length + extra bytes
+
+// Largest payload a compact record may decode to (one ESP-NOW frame).
+static constexpr uint16_t kTrexCompactMaxPayload = 250;
+
+// ---- Payload schemas ----
+// One letter per field, in struct order; a decimal prefix repeats it (or, for
+// z, gives the char[] size).
+//   b  u8 / raw byte          h  u16 varint      H  u16 raw
+//   w  u32 varint             W  u32 raw (ids, hashes, timestamps)
+//   z  NUL-terminated char[N] as varint length + chars
+//   u  TrexUid as len + len bytes
+namespace trex_detail {
+
+constexpr uint16_t cmpFieldSize(char c) {
+  return c == 'b' ? 1 : c == 'h' || c == 'H' ? 2 : c == 'w' || c == 'W' ? 4 :
+         c == 'z' ? 1 : c == 'u' ? (uint16_t)sizeof(TrexUid) : 0;
+}
+
+// In-memory size of a schema; 0xFFFF if it has an unknown letter.
+constexpr uint16_t cmpSchemaSize(const char* s) {
+  uint16_t n = 0;
+  while (*s) {
+    uint16_t count = 0;
+    while (*s >= '0' && *s <= '9') count = (uint16_t)(count * 10 + (*s++ - '0'));
+    const uint16_t sz = cmpFieldSize(*s++);
+    if (!sz) return 0xFFFF;
+    n = (uint16_t)(n + (count ? count : 1) * sz);
+  }
+  return n;
+}
+
+} // namespace trex_detail
+
+template <MsgType T> struct CompactSchema { static constexpr const char* kFields = nullptr; };
+
+#define TREX_COMPACT(TYPE, FIELDS)                                                        \
+  static_assert(trex_detail::cmpSchemaSize(FIELDS) == MsgTraits<MsgType::TYPE>::kSize,    \
+                #TYPE " compact schema doesn't match its payload");                       \
+  template <> struct CompactSchema<MsgType::TYPE> { static constexpr const char* kFields = FIELDS; };
+
+//           type             fields
+TREX_COMPACT(HELLO,           "5b6b")
+TREX_COMPACT(HEARTBEAT,       "")
+TREX_COMPACT(STATE_TICK,      "bw")
+TREX_COMPACT(GAME_OVER,       "bb")
+TREX_COMPACT(SCORE_UPDATE,    "w")
+TREX_COMPACT(STATION_UPDATE,  "bhh")
+TREX_COMPACT(GAME_START,      "")
+TREX_COMPACT(ROUND_STATUS,    "bbh3w")
+TREX_COMPACT(MG_START,        "Wh4b")
+TREX_COMPACT(MG_STOP,         "")
+TREX_COMPACT(MG_RESULT,       "ubb")
+TREX_COMPACT(LOOT_HOLD_START, "Wub")
+TREX_COMPACT(LOOT_HOLD_ACK,   "W4bhhb")
+TREX_COMPACT(LOOT_TICK,       "Wbh")
+TREX_COMPACT(LOOT_HOLD_STOP,  "W")
+TREX_COMPACT(HOLD_END,        "Wb")
+TREX_COMPACT(DROP_REQUEST,    "ub")
+TREX_COMPACT(DROP_RESULT,     "hwb")
+TREX_COMPACT(CONFIG_UPDATE,   "bb128zWbb")
+TREX_COMPACT(OTA_STATUS,      "bbW4bww")
+TREX_COMPACT(OTA_OFFER,       "WwWhh7b")
+TREX_COMPACT(BONUS_UPDATE,    "w")
+TREX_COMPACT(CONTROL_CMD,     "4b")
+TREX_COMPACT(GAME_STATUS,     "3w4b")
+TREX_COMPACT(LIVES_UPDATE,    "4b")
+TREX_COMPACT(SERVER_CMD,      "bbh")
+TREX_COMPACT(RADIO_CFG,       "4bh")
+TREX_COMPACT(STATUS_KEYFRAME, "h3w4bbw")
+TREX_COMPACT(STATUS_KEYREQ,   "H")
+TREX_COMPACT(REL_ACK,         "bhW")
+TREX_COMPACT(STATS_SNAPSHOT,  "bb9w8h8h12hbhhbhhbhhbhhbhhbhhbhhbhh")
+TREX_COMPACT(TIME_PING,       "W")
+TREX_COMPACT(TIME_PONG,       "bWWW")
+// STATUS_DELTA, OTA_CHUNK and OTA_NACK are variable length already: sent OPAQUE.
+
+namespace trex_detail {
+
+struct CmpSchema { const char* fields; uint16_t size; };
+
+template <size_t I>
+constexpr CmpSchema cmpEntry() {
+  if constexpr (IsRegistered<(MsgType)I>::value)
+    return {CompactSchema<(MsgType)I>::kFields, MsgTraits<(MsgType)I>::kSize};
+  else
+    return {nullptr, 0};
+}
+template <size_t... I>
+constexpr auto cmpTable(std::index_sequence<I...>) {
+  struct T { CmpSchema e[sizeof...(I)]; };
+  return T{{cmpEntry<I>()...}};
+}
+inline constexpr auto kCmpSchemas = cmpTable(std::make_index_sequence<128>{});
+
+// ---- byte cursors ----
+struct CmpWriter {
+  uint8_t* p;
+  uint8_t* end;
+  bool     ok = true;
+  void byte(uint8_t v) { if (p < end) *p++ = v; else ok = false; }
+  void raw(const uint8_t* s, uint16_t n) {
+    if ((size_t)(end - p) < n) { ok = false; return; }
+    memcpy(p, s, n);
+    p += n;
+  }
+  void varint(uint32_t v) {
+    while (v >= 0x80) { byte((uint8_t)(v | 0x80)); v >>= 7; }
+    byte((uint8_t)v);
+  }
+};
+
+struct CmpReader {
+  const uint8_t* p;
+  const uint8_t* end;
+  bool           ok = true;
+  uint16_t left() const { return (uint16_t)(end - p); }
+  uint8_t  byte() { if (p < end) return *p++; ok = false; return 0; }
+  void raw(uint8_t* d, uint16_t n) {
+    if (left() < n) { ok = false; return; }
+    memcpy(d, p, n);
+    p += n;
+  }
+  uint32_t varint() {
+    uint32_t v = 0;
+    for (uint8_t shift = 0; shift < 35; shift = (uint8_t)(shift + 7)) {
+      const uint8_t b = byte();
+      v |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) return v;
+    }
+    ok = false;
+    return 0;
+  }
+};
+
+// Walks a schema, calling fn(letter, count) per field.
+template <class Fn>
+inline void cmpEachField(const char* s, Fn fn) {
+  while (*s) {
+    uint16_t count = 0;
+    while (*s >= '0' && *s <= '9') count = (uint16_t)(count * 10 + (*s++ - '0'));
+    fn(*s++, count ? count : (uint16_t)1);
+  }
+}
+
+// False if a field can't be expressed (TrexUid.len past its bytes).
+inline bool cmpEncodeFields(const char* s, const uint8_t* in, CmpWriter& w) {
+  bool ok = true;
+  cmpEachField(s, [&](char c, uint16_t n) {
+    if (c == 'z') {
+      const uint16_t len = (uint16_t)strnlen((const char*)in, n);
+      w.varint(len);
+      w.raw(in, len);
+      in += n;
+      return;
+    }
+    if (c == 'b') { w.raw(in, n); in += n; return; }
+    for (uint16_t i = 0; i < n; ++i) {
+      switch (c) {
+        case 'h': { uint16_t v; memcpy(&v, in, 2); w.varint(v); in += 2; break; }
+        case 'H': w.raw(in, 2); in += 2; break;
+        case 'w': { uint32_t v; memcpy(&v, in, 4); w.varint(v); in += 4; break; }
+        case 'W': w.raw(in, 4); in += 4; break;
+        case 'u': {
+          const uint8_t len = in[0];
+          if (len > sizeof(TrexUid::bytes)) ok = false;
+          else { w.byte(len); w.raw(in + 1, len); }
+          in += sizeof(TrexUid);
+          break;
+        }
+      }
+    }
+  });
+  return ok && w.ok;
+}
+
+// out is zeroed by the caller.
+inline bool cmpDecodeFields(const char* s, CmpReader& r, uint8_t* out) {
+  cmpEachField(s, [&](char c, uint16_t n) {
+    if (c == 'z') {
+      const uint32_t len = r.varint();
+      if (len > n) r.ok = false;
+      else r.raw(out, (uint16_t)len);
+      out += n;
+      return;
+    }
+    if (c == 'b') { r.raw(out, n); out += n; return; }
+    for (uint16_t i = 0; i < n; ++i) {
+      switch (c) {
+        case 'h': { const uint32_t v = r.varint(); if (v > 0xFFFF) r.ok = false;
+                    const uint16_t v16 = (uint16_t)v; memcpy(out, &v16, 2); out += 2; break; }
+        case 'H': r.raw(out, 2); out += 2; break;
+        case 'w': { const uint32_t v = r.varint(); memcpy(out, &v, 4); out += 4; break; }
+        case 'W': r.raw(out, 4); out += 4; break;
+        case 'u': {
+          const uint8_t len = r.byte();
+          if (len > sizeof(TrexUid::bytes)) r.ok = false;
+          else { out[0] = len; r.raw(out + 1, len); }
+          out += sizeof(TrexUid);
+          break;
+        }
+      }
+    }
+  });
+  return r.ok;
+}
+
+// One [MsgHeader][payload] record; false if it can't be expressed.
+inline bool cmpEncodeRecord(const uint8_t* rec, CmpWriter& w) {
+  MsgHeader h;
+  memcpy(&h, rec, sizeof(h));
+  if (h.version != TREX_PROTO_VERSION || (h.type & 0x80) || (h.flags & (TREX_CMP_OPAQUE | TREX_CMP_TAIL)))
+    return false;
+  const uint8_t*   payload = rec + sizeof(MsgHeader);
+  const CmpSchema& sc      = kCmpSchemas.e[h.type];
+  uint8_t* const   start   = w.p;
+
+  for (int pass = 0; pass < 2; ++pass) {
+    const bool useSchema = pass == 0 && sc.fields && h.payloadLen >= sc.size;
+    uint8_t ctl = (uint8_t)(h.flags & ~TREX_MSGF_MORE);
+    if (!useSchema)              ctl |= TREX_CMP_OPAQUE;
+    else if (h.payloadLen > sc.size) ctl |= TREX_CMP_TAIL;
+
+    w.p  = start;
+    w.ok = true;
+    w.byte((uint8_t)(h.type | (ctl ? TREX_CMP_CTL : 0)));
+    if (ctl) w.byte(ctl);
+    w.byte(h.srcStationId);
+    w.byte((uint8_t)(h.seq & 0xFF));
+    w.byte((uint8_t)(h.seq >> 8));
+    if (!useSchema) {
+      w.varint(h.payloadLen);
+      w.raw(payload, h.payloadLen);
+      return w.ok;
+    }
+    if (!cmpEncodeFields(sc.fields, payload, w)) continue;   // retry as OPAQUE
+    if (ctl & TREX_CMP_TAIL) {
+      const uint16_t extra = (uint16_t)(h.payloadLen - sc.size);
+      w.varint(extra);
+      w.raw(payload + sc.size, extra);
+    }
+    return w.ok;
+  }
+  return false;
+}
+
+// Decodes one record into out (sizeof(MsgHeader) + kTrexCompactMaxPayload).
+inline bool cmpDecodeRecord(CmpReader& r, uint8_t* out, uint16_t& outLen) {
+  const uint8_t t   = r.byte();
+  const uint8_t ctl = (t & TREX_CMP_CTL) ? r.byte() : 0;
+  MsgHeader h;
+  h.version      = TREX_PROTO_VERSION;
+  h.type         = (uint8_t)(t & ~TREX_CMP_CTL);
+  h.flags        = (uint8_t)(ctl & ~(TREX_CMP_OPAQUE | TREX_CMP_TAIL));
+  h.srcStationId = r.byte();
+  h.seq          = r.byte();
+  h.seq          = (uint16_t)(h.seq | (uint16_t)r.byte() << 8);
+  if (!r.ok) return false;
+
+  uint8_t* payload = out + sizeof(MsgHeader);
+  const CmpSchema& sc = kCmpSchemas.e[h.type];
+  uint32_t len = 0;
+  if (ctl & TREX_CMP_OPAQUE) {
+    len = r.varint();
+    if (len > kTrexCompactMaxPayload) return false;
+    r.raw(payload, (uint16_t)len);
+  } else {
+    if (!sc.fields) return false;
+    memset(payload, 0, sc.size);
+    if (!cmpDecodeFields(sc.fields, r, payload)) return false;
+    len = sc.size;
+    if (ctl & TREX_CMP_TAIL) {
+      const uint32_t extra = r.varint();
+      if (len + extra > kTrexCompactMaxPayload) return false;
+      r.raw(payload + len, (uint16_t)extra);
+      len += extra;
+    }
+  }
+  if (!r.ok) return false;
+  h.payloadLen = (uint16_t)len;
+  memcpy(out, &h, sizeof(h));
+  outLen = (uint16_t)(sizeof(MsgHeader) + len);
+  return true;
+}
+
+} // namespace trex_detail
+
+// Encodes records (one, or an aggregate as in TrexAggregate.h; no wire header)
+// into out as a whole compact frame, wire header included. Returns its length,
+// or 0 if it doesn't fit cap, isn't smaller, or something can't be expressed.
+inline uint16_t trexCompactFrame(const uint8_t* data, uint16_t len, uint8_t* out, uint16_t cap) {
+  if (!data || cap < 3 || len < sizeof(MsgHeader)) return 0;
+  if (!(data[offsetof(MsgHeader, flags)] & TREX_MSGF_MORE) && !trexIsSingleRecord(data, len)) return 0;
+  trex_detail::CmpWriter w{out + 3, out + (cap < len + 3 ? cap : len + 3)};
+  bool whole = true;
+  const bool split = trexForEachRecord(data, len, [&](const uint8_t* rec, uint16_t) {
+    if (whole && !trex_detail::cmpEncodeRecord(rec, w)) whole = false;
+  });
+  if (!split || !whole || !w.ok) return 0;
+  const uint16_t n = (uint16_t)(w.p - out);
+  if (n >= len + 3) return 0;
+  out[0] = (uint8_t)TREX_WIRE_MAGIC0;
+  out[1] = (uint8_t)TREX_WIRE_MAGIC1;
+  out[2] = (uint8_t)TREX_WIRE_VERSION_COMPACT;
+  return n;
+}
+
+// For a framed wire-version-1 buffer (TxFrame::wire, TrexAggregator::wire):
+// the compact form in scratch, or the input unchanged if it can't be smaller.
+inline const uint8_t* trexCompactWire(const uint8_t* wire, uint16_t& len, uint8_t* scratch, uint16_t cap) {
+  if (len < 3 || wire[0] != (uint8_t)TREX_WIRE_MAGIC0 || wire[1] != (uint8_t)TREX_WIRE_MAGIC1 ||
+      wire[2] != (uint8_t)TREX_WIRE_VERSION)
+    return wire;
+  const uint16_t n = trexCompactFrame(wire + 3, (uint16_t)(len - 3), scratch, cap);
+  if (!n) return wire;
+  len = n;
+  return scratch;
+}
+
+// Receive side for the bytes after a wire header of either version: calls
+// fn(record, recordLen) with a rebuilt [MsgHeader][payload] record (MORE set on
+// all but the last). Returns false if the frame ended in a bad record.
+template <class Fn>
+inline bool trexForEachWireRecord(uint8_t wireVersion, const uint8_t* data, uint16_t len, Fn fn) {
+  if (wireVersion != TREX_WIRE_VERSION_COMPACT) return trexForEachRecord(data, len, fn);
+  uint8_t rec[sizeof(MsgHeader) + kTrexCompactMaxPayload];
+  trex_detail::CmpReader r{data, data + len};
+  while (r.left()) {
+    uint16_t n = 0;
+    if (!trex_detail::cmpDecodeRecord(r, rec, n)) return false;
+    if (r.left()) rec[offsetof(MsgHeader, flags)] |= TREX_MSGF_MORE;
+    fn(rec, n);
+  }
+  return true;
+}
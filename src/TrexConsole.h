@@ -0,0 +1,191 @@
+#pragma once
+// TrexConsole.h — line console shared by the maintenance telnet port.
+//
+// LineReader assembles input into a fixed buffer from whatever bytes are
+// available right now, so a half-typed line never stalls the caller. Any
+// module can add commands to the registry; lookup is one hash probe, and
+// 'help' / 'help <cmd>' are generated from the entries.
+//
+//   static void cmdScore(const char* args, Print& out) { out.printf("score=%d\r\n", score); }
+//   Console::add({"score", "[+/-N]", "Show or adjust the score", cmdScore});
+//
+// Command names are matched case-insensitively; arguments are passed through
+// as typed (file paths keep their case).
+#include <Arduino.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace Console {
+
+using Handler = void (*)(const char* args, Print& out);
+// Gets the whole line when no command matches; false = not handled either.
+using Fallback = bool (*)(const char* line, Print& out);
+
+struct Command {
+  const char* name;    // lowercase, no spaces; must outlive the registry
+  const char* usage;   // argument synopsis ("" if none)
+  const char* help;    // one line
+  Handler     fn;
+};
+
+static constexpr uint8_t kMaxCommands = 48;
+static constexpr uint8_t kSlots       = 64;     // hash table, power of two > kMaxCommands
+static constexpr size_t  kLineMax     = 128;
+
+struct Registry {
+  Command cmds[kMaxCommands];
+  uint8_t count = 0;
+  uint8_t slot[kSlots];   // index + 1 into cmds, 0 = empty
+  Fallback    fallback     = nullptr;
+  const char* fallbackHelp = nullptr;   // shown at the end of 'help'
+};
+
+inline Registry& registry() {   // single instance across the program
+  static Registry r{};
+  return r;
+}
+
+// FNV-1a over the lowercased name; stops at the first space.
+inline uint32_t hashName(const char* s, size_t& len) {
+  uint32_t h = 2166136261u;
+  for (len = 0; s[len] && s[len] != ' '; ++len) h = (h ^ (uint8_t)tolower((unsigned char)s[len])) * 16777619u;
+  return h;
+}
+
+inline bool sameName(const char* name, const char* typed, size_t len) {
+  for (size_t i = 0; i < len; ++i)
+    if (!name[i] || name[i] != tolower((unsigned char)typed[i])) return false;
+  return name[len] == '\0';
+}
+
+// Slot holding the command (or the empty slot where it would go).
+inline uint8_t probe(const char* typed, size_t len, uint32_t h) {
+  const Registry& r = registry();
+  uint8_t i = (uint8_t)(h & (kSlots - 1));
+  while (r.slot[i] && !sameName(r.cmds[r.slot[i] - 1].name, typed, len)) i = (uint8_t)((i + 1) & (kSlots - 1));
+  return i;
+}
+
+inline const Command* find(const char* typed) {
+  size_t         len;
+  const uint32_t h = hashName(typed, len);
+  const uint8_t  s = registry().slot[probe(typed, len, h)];
+  return s ? &registry().cmds[s - 1] : nullptr;
+}
+
+// Registering a name again replaces its handler (a station can override a
+// built-in). Returns false when the table is full.
+inline bool add(const Command& c) {
+  Registry&      r = registry();
+  size_t         len;
+  const uint32_t h = hashName(c.name, len);
+  const uint8_t  i = probe(c.name, len, h);
+  if (r.slot[i]) { r.cmds[r.slot[i] - 1] = c; return true; }
+  if (r.count >= kMaxCommands) return false;
+  r.cmds[r.count] = c;
+  r.slot[i]       = ++r.count;
+  return true;
+}
+
+// One catch-all for unmatched lines, e.g. a sketch's own command parser
+// (nullptr removes it). help is printed under the command list.
+inline void setFallback(Fallback fn, const char* help = nullptr) {
+  registry().fallback     = fn;
+  registry().fallbackHelp = help;
+}
+
+inline void printHelp(const char* args, Print& out) {
+  const Registry& r = registry();
+  if (args[0]) {
+    const Command* c = find(args);
+    if (!c) { out.printf("no command '%s'\r\n", args); return; }
+    out.printf("%s %s\r\n  %s\r\n", c->name, c->usage, c->help);
+    return;
+  }
+  out.print("Commands:\r\n");
+  out.printf("  %-22s %s\r\n", "help [cmd]", "This list, or one command in detail");
+  char left[40];
+  for (uint8_t i = 0; i < r.count; ++i) {
+    snprintf(left, sizeof(left), "%s %s", r.cmds[i].name, r.cmds[i].usage);
+    out.printf("  %-22s %s\r\n", left, r.cmds[i].help);
+  }
+  if (r.fallback && r.fallbackHelp) out.printf("  %s\r\n", r.fallbackHelp);
+}
+
+// Runs one line: "<name> <args>". Unknown commands go to the fallback, if
+// any, else print "?".
+inline void dispatch(const char* line, Print& out) {
+  while (*line == ' ') ++line;
+  if (!*line) return;
+  const char* end = line;
+  while (*end && *end != ' ') ++end;
+  const char* args = end;
+  while (*args == ' ') ++args;
+  if (sameName("help", line, (size_t)(end - line))) { printHelp(args, out); return; }
+  const Command* c = find(line);
+  if (c) c->fn(args, out);
+  else if (!registry().fallback || !registry().fallback(line, out)) out.print("?\r\n");
+}
+
+// Incremental line assembly. Handles CR, LF, CRLF, backspace and telnet
+// option negotiation (IAC sequences are dropped, not echoed into the line).
+class LineReader {
+public:
+  // Consumes at most maxBytes already-buffered bytes; returns true once a
+  // complete line is in line(). Never waits for more input.
+  template <class S>
+  bool poll(S& in, uint16_t maxBytes = 256) {
+    if (ready_) { len_ = 0; ready_ = false; }
+    while (maxBytes-- && in.available() > 0) {
+      const int c = in.read();
+      if (c < 0) break;
+      if (feed((uint8_t)c)) return true;
+    }
+    return false;
+  }
+
+  bool feed(uint8_t c) {
+    if (iac_) {                          // IAC <cmd> [<opt>]
+      if (iac_ == 1 && c >= 251 && c <= 254) { iac_ = 2; return false; }
+      if (iac_ == 1 && c == 250) { iac_ = 3; return false; }       // SB ... IAC SE
+      if (iac_ == 3) { if (c == 255) iac_ = 4; return false; }
+      if (iac_ == 4 && c != 240) { iac_ = 3; return false; }
+      iac_ = 0;
+      return false;
+    }
+    if (c == 255) { iac_ = 1; return false; }
+    if (c == '\r' || c == '\n') {
+      if (c == '\n' && lastCr_) { lastCr_ = false; return false; }
+      lastCr_ = c == '\r';
+      if (overflow_) { overflow_ = false; len_ = 0; overflowed_ = true; }
+      while (len_ && buf_[len_ - 1] == ' ') --len_;
+      buf_[len_] = '\0';
+      ready_     = true;
+      return true;
+    }
+    lastCr_ = false;
+    if (c == 8 || c == 127) { if (len_) --len_; return false; }
+    if (c == '\t') c = ' ';
+    if (c < 32) return false;
+    if (len_ + 1 >= kLineMax) { overflow_ = true; return false; }
+    buf_[len_++] = (char)c;
+    return false;
+  }
+
+  const char* line() const { return buf_; }
+  // True (once) if the line that just ended was cut for being too long.
+  bool takeOverflow() { const bool o = overflowed_; overflowed_ = false; return o; }
+  void reset() { len_ = 0; ready_ = overflow_ = overflowed_ = lastCr_ = false; iac_ = 0; }
+
+private:
+  char    buf_[kLineMax];
+  size_t  len_        = 0;
+  uint8_t iac_        = 0;
+  bool    ready_      = false;
+  bool    overflow_   = false;
+  bool    overflowed_ = false;
+  bool    lastCr_     = false;
+};
+
+} // namespace Console
@@ -0,0 +1,19 @@
+#pragma once
+// TrexCrc32.h — CRC-32 (IEEE, as zlib), shared by mesh OTA, OTA artifacts and
+// verified file uploads. Nibble table: 64 bytes of flash, no init.
+#include <stddef.h>
+#include <stdint.h>
+
+// Chain calls by passing the previous result; start with 0.
+inline uint32_t trexCrc32Update(uint32_t crc, const uint8_t* d, size_t n) {
+  static const uint32_t t[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  crc = ~crc;
+  while (n--) {
+    crc ^= *d++;
+    crc = (crc >> 4) ^ t[crc & 15];
+    crc = (crc >> 4) ^ t[crc & 15];
+  }
+  return ~crc;
+}
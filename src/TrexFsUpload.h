@@ -0,0 +1,147 @@
+#pragma once
+// TrexFsUpload.h — buffered, verified file uploads into LittleFS.
+//
+// Writer stages one file at "<path>.part". Incoming chunks (small and
+// unaligned over HTTP) are coalesced into kBlock-sized writes while the
+// CRC-32 is kept on the fly. finish() checks the size and CRC the client sent
+// (if any), reads the staged file back to make sure flash holds the same
+// bytes, then renames it over <path> (LittleFS replaces the target in one
+// step). A failed or aborted upload only deletes the .part file, so the old
+// asset stays usable.
+//
+//   FsUpload::Writer w;
+//   w.begin(LittleFS, "/clips/LootDrop.wav");
+//   while (...) w.write(buf, n);
+//   if (w.finish(expect)) Serial.printf("%u KB/s\n", w.result().kBps());
+#include <Arduino.h>
+#include <FS.h>
+#include "TrexCrc32.h"
+
+namespace FsUpload {
+
+static constexpr size_t kBlock   = 4096;   // LittleFS block size on ESP32 flash
+static constexpr size_t kMaxPath = 64;
+
+// Values the client vouched for; unset fields aren't checked.
+struct Expect {
+  bool     hasSize = false;
+  bool     hasCrc  = false;
+  uint32_t size    = 0;
+  uint32_t crc     = 0;
+};
+
+struct Result {
+  char        path[kMaxPath];
+  uint32_t    size;
+  uint32_t    crc;
+  uint32_t    ms;       // first byte -> last byte written
+  const char* error;    // nullptr = OK
+  uint32_t kBps() const { return ms ? (uint32_t)((uint64_t)size * 1000 / 1024 / ms) : 0; }
+};
+
+// Absolute, no "..", no empty components, room for the ".part" suffix.
+inline bool validPath(const char* p) {
+  const size_t n = p ? strlen(p) : 0;
+  if (n < 2 || p[0] != '/' || n + 6 > kMaxPath || p[n - 1] == '/') return false;
+  if (strstr(p, "//") || strstr(p, "/../") || strstr(p, "/./")) return false;
+  return strcmp(p + n - 3, "/..") != 0 && strcmp(p + n - 2, "/.") != 0;
+}
+
+inline void makeParents(fs::FS& fs, const char* path) {
+  char dir[kMaxPath];
+  for (size_t i = 1; path[i]; ++i) {
+    if (path[i] != '/') continue;
+    memcpy(dir, path, i);
+    dir[i] = '\0';
+    if (!fs.exists(dir)) fs.mkdir(dir);
+  }
+}
+
+class Writer {
+public:
+  bool begin(fs::FS& fs, const char* path) {
+    abort();
+    fs_     = &fs;
+    res_    = Result{};
+    tmp_[0] = '\0';
+    snprintf(res_.path, sizeof(res_.path), "%s", path ? path : "");
+    if (!validPath(path)) return fail("bad path");
+    snprintf(tmp_, sizeof(tmp_), "%s.part", path);
+    makeParents(fs, path);
+    f_ = fs.open(tmp_, "w");
+    if (!f_) return fail("open");
+    used_ = 0;
+    t0_   = millis();
+    open_ = true;
+    return true;
+  }
+
+  bool write(const uint8_t* d, size_t n) {
+    if (!open_) return false;
+    res_.crc   = trexCrc32Update(res_.crc, d, n);
+    res_.size += (uint32_t)n;
+    while (n) {
+      const size_t k = n < kBlock - used_ ? n : kBlock - used_;
+      memcpy(buf_ + used_, d, k);
+      used_ += k; d += k; n -= k;
+      if (used_ == kBlock && !flush()) return false;
+    }
+    return true;
+  }
+
+  bool finish(const Expect& e = Expect{}) {
+    if (!open_ || !flush()) return false;
+    f_.close();
+    open_    = false;
+    res_.ms  = millis() - t0_;
+    if (e.hasSize && e.size != res_.size) return fail("size mismatch");
+    if (e.hasCrc && e.crc != res_.crc)    return fail("crc mismatch");
+
+    File     r = fs_->open(tmp_, "r");
+    uint32_t c = 0;
+    if (!r || r.size() != res_.size) { if (r) r.close(); return fail("readback"); }
+    for (int n; (n = r.read(buf_, kBlock)) > 0;) c = trexCrc32Update(c, buf_, (size_t)n);
+    r.close();
+    if (c != res_.crc) return fail("verify");
+    if (!fs_->rename(tmp_, res_.path)) return fail("rename");
+    return true;
+  }
+
+  // Connection dropped or request rejected: keep the old file.
+  void abort() {
+    if (open_) {
+      f_.close();
+      fs_->remove(tmp_);
+    }
+    open_ = false;
+  }
+
+  bool          busy()   const { return open_; }
+  const Result& result() const { return res_; }
+
+private:
+  bool flush() {
+    if (used_ && f_.write(buf_, used_) != used_) return fail("write (disk full?)");
+    used_ = 0;
+    return true;
+  }
+
+  bool fail(const char* why) {
+    if (open_) f_.close();
+    if (fs_ && tmp_[0]) fs_->remove(tmp_);
+    open_      = false;
+    res_.error = why;
+    return false;
+  }
+
+  fs::FS*  fs_   = nullptr;
+  File     f_;
+  bool     open_ = false;
+  char     tmp_[kMaxPath] = {};
+  size_t   used_ = 0;
+  uint32_t t0_   = 0;
+  Result   res_{};
+  uint8_t  buf_[kBlock];
+};
+
+} // namespace FsUpload
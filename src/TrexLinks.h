@@ -0,0 +1,53 @@
+#pragma once
+// TrexLinks.h — the backends behind the Transport API.
+//
+// Every compiled-in backend is a struct of static functions with the same
+// shape (its state stays file-static in its own .cpp). The front end in
+// TrexTransportCommon.cpp reaches them through forEachLink() by static
+// dispatch, so one firmware can run ESP-NOW and UDP side by side with no
+// virtual calls on the send path.
+#include <stdint.h>
+#include "TrexBuildConfig.h"
+#include "TrexTransport.h"
+
+#define TREX_DECLARE_LINK(NAME, MASK)                                        \
+  struct NAME {                                                              \
+    static constexpr uint8_t kMask = MASK;                                   \
+    static bool     init(const TransportConfig& cfg, RxHandler onRx);        \
+    static void     reconfigure(const TransportConfig& cfg);                 \
+    static bool     survey(ChannelSurvey* out, uint8_t count, uint16_t dwellMs); \
+    static bool     up();                                                    \
+    static bool     sendToServer(const uint8_t* data, uint16_t len);         \
+    static bool     broadcast(const uint8_t* data, uint16_t len);            \
+    static bool     sendToStation(uint8_t stationId, const uint8_t* data, uint16_t len); \
+    static bool     sendToServer(TxFrame& frame);                            \
+    static bool     broadcast(TxFrame& frame);                               \
+    static bool     sendToStation(uint8_t stationId, TxFrame& frame);        \
+    static void     loop();                                                  \
+    static uint32_t rxOverflowCount();                                       \
+  };
+
+// up(): can carry traffic right now (UDP: Wi-Fi associated or SoftAP running).
+#if TREX_USE_ESPNOW
+TREX_DECLARE_LINK(EspNowLink, TREX_LINK_ESPNOW)
+#endif
+#if TREX_USE_UDP
+TREX_DECLARE_LINK(UdpLink, TREX_LINK_UDP)
+#endif
+#if TREX_USE_HOST
+TREX_DECLARE_LINK(HostLink, TREX_LINK_HOST)
+#endif
+
+// Calls fn(Link{}) for every compiled-in backend, in preference order.
+template <class Fn>
+inline void trexForEachLink(Fn&& fn) {
+#if TREX_USE_ESPNOW
+  fn(EspNowLink{});
+#endif
+#if TREX_USE_UDP
+  fn(UdpLink{});
+#endif
+#if TREX_USE_HOST
+  fn(HostLink{});
+#endif
+}
@@ -0,0 +1,470 @@
+#pragma once
+// TrexLog.h — deferred binary logging.
+//
+// A log call only reserves a record in a lock-free ring and copies its
+// arguments raw next to the format string's address; nothing is formatted or
+// written at the call site. drain() turns records into text for the text
+// sinks (Serial, telnet) and hands the raw bytes to binary sinks (UDP), which
+// extras/logdec decodes on a PC against the firmware ELF. On ESP32, begin()
+// runs drain() on a low-priority task.
+//
+//   TLOGI(MOD_GAME, "loot %u -> %u (%s)", before, after, name);
+//   TLOGD(MOD_RADIO, "rx type=%u rssi=%d", type, rssi);   // gone unless TREX_LOG_LEVEL >= 4
+//
+// Levels and modules are filtered at compile time (TREX_LOG_LEVEL,
+// TREX_LOG_MODULES in TrexBuildConfig.h). A filtered call compiles to nothing
+// and its arguments aren't evaluated. Format strings must be literals. Strings
+// passed for %s are copied (up to kMaxStr chars), so temporaries are safe.
+// Arguments are integers, enums, floating point, C strings and pointers; pass
+// String through .c_str().
+//
+// Any thread or the Wi-Fi callback may log. A full ring drops the record and
+// counts it in dropped().
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+#include "TrexBuildConfig.h"
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <time.h>
+#endif
+
+namespace TrexLog {
+
+enum Level : uint8_t { LVL_ERROR = 1, LVL_WARN = 2, LVL_INFO = 3, LVL_DEBUG = 4 };
+
+enum Module : uint8_t {   // bit n of TREX_LOG_MODULES; at most 32
+  MOD_CORE = 0, MOD_RADIO, MOD_GAME, MOD_LIGHT, MOD_AUDIO, MOD_OTA, MOD_MAINT, MOD_APP,
+  kModules
+};
+
+constexpr bool enabled(Level l, Module m) {
+  return l <= TREX_LOG_LEVEL && ((uint32_t)(TREX_LOG_MODULES) >> m & 1u);
+}
+
+inline char levelChar(uint8_t l) { return l <= LVL_DEBUG ? "?EWID"[l] : '?'; }
+inline const char* moduleName(uint8_t m) {
+  static const char* const names[kModules] = {"core", "radio", "game", "light", "audio", "ota", "maint", "app"};
+  return m < kModules ? names[m] : "?";
+}
+
+// Format string addresses are stored relative to this; the decoder finds it in
+// the ELF by content.
+inline constexpr char kAnchor[] = "TREXLOG-FMT-ANCHOR";
+
+static constexpr size_t   kRingBytes = TREX_LOG_RING_BYTES;
+static constexpr uint8_t  kMaxStr    = 63;
+
+// RecHdr.fmt <-> format string. The strings and kAnchor are separate objects,
+// so the distance is taken on integer addresses, not by pointer subtraction.
+inline int32_t fmtOffset(const char* fmt) {
+  return (int32_t)(intptr_t)((uintptr_t)fmt - (uintptr_t)kAnchor);
+}
+inline const char* fmtAt(int32_t off) {
+  return (const char*)((uintptr_t)kAnchor + (uintptr_t)(intptr_t)off);
+}
+static constexpr uint16_t kMaxRecord = 256;
+static_assert(kRingBytes >= 2 * kMaxRecord && (kRingBytes & (kRingBytes - 1)) == 0,
+              "TREX_LOG_RING_BYTES must be a power of two >= 512");
+
+enum RecState : uint8_t { REC_WRITING = 0, REC_READY = 1, REC_PAD = 2 };
+
+#pragma pack(push,1)
+// One record, 4-byte aligned in the ring and on the wire. Arguments follow as
+// a tag byte plus payload: 'i' int32, 'l' int64, 'd' double, 'p' pointer
+// (8 bytes), 's' length byte + chars.
+struct RecHdr {
+  uint16_t len;       // whole record, multiple of 4
+  uint8_t  state;     // RecState
+  uint8_t  tag;       // level << 5 | module
+  int32_t  fmt;       // format string address - &kAnchor
+  uint32_t us;        // micros() at the call
+};
+
+// Starts every binary stream / UDP packet so a decoder can join mid-way.
+struct StreamHdr {
+  uint8_t  magic[4];  // 'T','R','X','L'
+  uint8_t  version;   // 1
+  uint8_t  _pad[3];
+};
+#pragma pack(pop)
+static_assert(sizeof(RecHdr) == 12, "TrexLog::RecHdr size changed");
+static constexpr StreamHdr kStreamHdr = {{'T', 'R', 'X', 'L'}, 1, {0, 0, 0}};
+
+// ---------------------------------------------------------------- formatting
+// Shared by drain() and the host decoder. Each conversion in fmt takes the
+// next argument; the argument's own tag decides how it's printed, so a
+// mismatched %d/%ld can't misread the buffer. Returns the length written.
+inline size_t format(const char* fmt, const uint8_t* a, size_t alen, char* out, size_t cap) {
+  if (!cap) return 0;
+  size_t      n   = 0;
+  const uint8_t* end = a + alen;
+  auto put = [&](const char* s, size_t k) {
+    if (n + k >= cap) k = cap - 1 - n;
+    memcpy(out + n, s, k);
+    n += k;
+  };
+  // Next integer argument (for '*' width/precision).
+  auto nextInt = [&](long long& v) -> bool {
+    if (a >= end) return false;
+    const char t = (char)*a++;
+    if (t == 'i' && a + 4 <= end) { int32_t x; memcpy(&x, a, 4); a += 4; v = x; return true; }
+    if (t == 'l' && a + 8 <= end) { int64_t x; memcpy(&x, a, 8); a += 8; v = x; return true; }
+    a = end;
+    return false;
+  };
+  while (*fmt && n + 1 < cap) {
+    if (*fmt != '%') { const char* s = fmt; while (*fmt && *fmt != '%') ++fmt; put(s, (size_t)(fmt - s)); continue; }
+    if (fmt[1] == '%') { put("%", 1); fmt += 2; continue; }
+    // The spec is rebuilt with our own length modifier; one that doesn't fit
+    // (records can come off the network) prints "<?>" but still consumes its
+    // arguments, so the rest of the line stays aligned.
+    char   spec[40];
+    size_t k      = 0;
+    bool   specOk = true;
+    auto   add    = [&](const char* s, size_t len) {
+      if (k + len + 4 > sizeof(spec)) { specOk = false; return; }   // room for "ll" + conv + NUL
+      memcpy(spec + k, s, len);
+      k += len;
+    };
+    add(fmt++, 1);
+    while (*fmt && strchr("-+ #0", *fmt)) add(fmt++, 1);
+    for (int part = 0; part < 2; ++part) {               // width, then .precision
+      if (part == 1) { if (*fmt != '.') break; add(fmt++, 1); }
+      if (*fmt == '*') {
+        long long v = 0;
+        nextInt(v);
+        ++fmt;
+        if (part == 1 && v < 0) { --k; continue; }       // negative precision = none
+        if (v < -255) v = -255;                          // negative width = '-' flag
+        if (v > 255)  v = 255;
+        char num[8];
+        const int len = snprintf(num, sizeof(num), "%d", (int)v);
+        add(num, len > 0 ? (size_t)len : 0);
+      } else {
+        while (*fmt >= '0' && *fmt <= '9') add(fmt++, 1);
+      }
+    }
+    if (!specOk) k = 1;                                  // just "%": harmless below
+    while (*fmt && strchr("hljztL", *fmt)) ++fmt;        // sizes come from the tags
+    const char conv = *fmt ? *fmt++ : 'd';
+    char buf[96];
+    int  w = -1;
+    if (a >= end) { put("<?>", 3); continue; }
+    const char t = (char)*a++;
+    const bool isInt = strchr("diuxXoc", conv) != nullptr;
+    const bool isFlt = strchr("fFeEgGaA", conv) != nullptr;
+    if ((t == 'i' || t == 'l') && a + (t == 'i' ? 4 : 8) <= end) {
+      long long v;
+      if (t == 'i') { int32_t x; memcpy(&x, a, 4); a += 4; v = (conv == 'd' || conv == 'i' || conv == 'c') ? x : (long long)(uint32_t)x; }
+      else          { int64_t x; memcpy(&x, a, 8); a += 8; v = x; }
+      if (conv == 'c') { spec[k++] = 'c'; spec[k] = 0; w = snprintf(buf, sizeof(buf), spec, (int)v); }
+      else { spec[k++] = 'l'; spec[k++] = 'l'; spec[k++] = isInt ? conv : 'd'; spec[k] = 0; w = snprintf(buf, sizeof(buf), spec, v); }
+    } else if (t == 'd' && a + 8 <= end) {
+      double v; memcpy(&v, a, 8); a += 8;
+      spec[k++] = isFlt ? conv : 'g'; spec[k] = 0;
+      w = snprintf(buf, sizeof(buf), spec, v);
+    } else if (t == 'p' && a + 8 <= end) {
+      uint64_t v; memcpy(&v, a, 8); a += 8;
+      w = snprintf(buf, sizeof(buf), "0x%llx", (unsigned long long)v);
+    } else if (t == 's' && a < end && a + 1 + *a <= end) {
+      // The producer never sends more than kMaxStr, but a record off the
+      // network may claim up to 255: keep what fits, skip the rest.
+      char s[kMaxStr + 1];
+      const uint8_t len = *a++;
+      const uint8_t cp  = len < kMaxStr ? len : kMaxStr;
+      memcpy(s, a, cp); s[cp] = 0; a += len;
+      spec[k++] = 's'; spec[k] = 0;
+      w = snprintf(buf, sizeof(buf), spec, s);
+    } else {
+      a = end;
+      put("<?>", 3);
+      continue;
+    }
+    if (!specOk) w = snprintf(buf, sizeof(buf), "<?>");
+    if (w > 0) put(buf, (size_t)w < sizeof(buf) ? (size_t)w : sizeof(buf) - 1);
+  }
+  out[n] = 0;
+  return n;
+}
+
+// "[   12.345] I game  loot 3 -> 4\r\n"
+inline size_t formatLine(const RecHdr& r, const char* fmt, char* out, size_t cap) {
+  int n = snprintf(out, cap, "[%5u.%03u] %c %-5s ", (unsigned)(r.us / 1000000u),
+                   (unsigned)(r.us / 1000u % 1000u), levelChar(r.tag >> 5), moduleName(r.tag & 31));
+  if (n < 0 || (size_t)n >= cap) return 0;
+  n += (int)format(fmt, (const uint8_t*)(&r + 1), r.len - sizeof(RecHdr), out + n, cap - (size_t)n - 2);
+  while (n && (out[n - 1] == '\n' || out[n - 1] == '\r')) --n;   // printf-style "...\n" formats
+  out[n++] = '\r';
+  out[n++] = '\n';
+  out[n]   = 0;
+  return (size_t)n;
+}
+
+// ---------------------------------------------------------------- ring
+struct Ring {
+  alignas(4) uint8_t    buf[kRingBytes];
+  std::atomic<uint32_t> head{0};      // reserved up to
+  std::atomic<uint32_t> tail{0};      // consumed up to
+  std::atomic<uint32_t> dropped{0};
+  std::atomic<bool>     draining{false};
+};
+
+inline Ring& ring() {   // single instance across the program
+  static Ring r;
+  return r;
+}
+
+inline uint32_t dropped() { return ring().dropped.load(std::memory_order_relaxed); }
+
+inline uint32_t nowUs() {
+#ifdef ARDUINO
+  return micros();
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u);
+#endif
+}
+
+// Multi-producer reserve: claim len bytes with one CAS; a record never wraps,
+// the tail end of the buffer becomes a REC_PAD record instead.
+inline uint8_t* reserve(uint16_t len) {
+  Ring&    r = ring();
+  uint32_t h = r.head.load(std::memory_order_relaxed);
+  for (;;) {
+    const uint32_t at  = h & (kRingBytes - 1);
+    const uint32_t pad = kRingBytes - at < len ? (uint32_t)(kRingBytes - at) : 0;
+    if (h + pad + len - r.tail.load(std::memory_order_acquire) > kRingBytes) {
+      r.dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    if (r.head.compare_exchange_weak(h, h + pad + len, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+      if (pad) {
+        RecHdr* p = (RecHdr*)&r.buf[at];
+        p->len = (uint16_t)pad;
+        __atomic_store_n(&p->state, (uint8_t)REC_PAD, __ATOMIC_RELEASE);
+      }
+      return &r.buf[(h + pad) & (kRingBytes - 1)];
+    }
+  }
+}
+
+template <class T> struct Unsupported : std::false_type {};
+
+inline uint8_t strLen(const char* s) {
+  if (!s) return 0;
+  uint8_t n = 0;
+  while (n < kMaxStr && s[n]) ++n;
+  return n;
+}
+
+template <class T>
+inline size_t argBytes(const T& v) {
+  using D = std::decay_t<T>;
+  if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>) return 2u + strLen(v);
+  else if constexpr (std::is_floating_point_v<D> || std::is_pointer_v<D>)    return 9;
+  else if constexpr (std::is_integral_v<D> || std::is_enum_v<D>)             return sizeof(D) > 4 ? 9 : 5;
+  else static_assert(Unsupported<D>::value, "TrexLog: unsupported argument type (String? pass .c_str())");
+  return 0;
+}
+
+template <class T>
+inline void putArg(uint8_t*& p, const T& v) {
+  using D = std::decay_t<T>;
+  if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>) {
+    const uint8_t n = strLen(v);
+    *p++ = 's'; *p++ = n;
+    memcpy(p, v, n); p += n;
+  } else if constexpr (std::is_floating_point_v<D>) {
+    const double d = (double)v;
+    *p++ = 'd'; memcpy(p, &d, 8); p += 8;
+  } else if constexpr (std::is_pointer_v<D>) {
+    const uint64_t x = (uint64_t)(uintptr_t)v;
+    *p++ = 'p'; memcpy(p, &x, 8); p += 8;
+  } else if constexpr (sizeof(D) > 4) {
+    const int64_t x = (int64_t)v;
+    *p++ = 'l'; memcpy(p, &x, 8); p += 8;
+  } else {
+    const int32_t x = std::is_signed_v<D> ? (int32_t)v : (int32_t)(uint32_t)v;
+    *p++ = 'i'; memcpy(p, &x, 4); p += 4;
+  }
+}
+
+template <class... A>
+inline void write(Level l, Module m, const char* fmt, const A&... args) {
+  size_t need = sizeof(RecHdr);
+  ((need += argBytes(args)), ...);
+  need = (need + 3) & ~(size_t)3;
+  if (need > kMaxRecord) { ring().dropped.fetch_add(1, std::memory_order_relaxed); return; }
+  uint8_t* at = reserve((uint16_t)need);
+  if (!at) return;
+  RecHdr* h = (RecHdr*)at;
+  h->len = (uint16_t)need;
+  h->tag = (uint8_t)(l << 5 | m);
+  h->fmt = fmtOffset(fmt);
+  h->us  = nowUs();
+  uint8_t* p = at + sizeof(RecHdr);
+  (putArg(p, args), ...);
+  memset(p, 0, at + need - p);
+  __atomic_store_n(&h->state, (uint8_t)REC_READY, __ATOMIC_RELEASE);
+}
+
+// ---------------------------------------------------------------- sinks
+using TextSink = void (*)(const char* line, size_t n);
+struct BinarySink {
+  void (*write)(const uint8_t* rec, size_t n);   // one record (state REC_READY)
+  void (*flush)();                               // end of a drain pass; may be nullptr
+};
+
+static constexpr uint8_t kMaxSinks = 4;
+struct Sinks {
+  TextSink   text[kMaxSinks]   = {};
+  BinarySink binary[kMaxSinks] = {};
+  uint8_t    nText = 0, nBinary = 0;
+};
+inline Sinks& sinks() {
+  static Sinks s;
+  return s;
+}
+
+// Adding a sink that is already registered is a no-op (returns true).
+inline bool addTextSink(TextSink fn) {
+  Sinks& s = sinks();
+  for (uint8_t i = 0; i < s.nText; ++i) if (s.text[i] == fn) return true;
+  if (s.nText >= kMaxSinks) return false;
+  s.text[s.nText++] = fn;
+  return true;
+}
+inline bool addBinarySink(const BinarySink& b) {
+  Sinks& s = sinks();
+  for (uint8_t i = 0; i < s.nBinary; ++i) if (s.binary[i].write == b.write) return true;
+  if (s.nBinary >= kMaxSinks) return false;
+  s.binary[s.nBinary++] = b;
+  return true;
+}
+
+// Single consumer: formats and emits up to maxRecords ready records, returns
+// how many. A concurrent second caller returns 0 at once.
+inline uint16_t drain(uint16_t maxRecords = 64) {
+  Ring& r = ring();
+  if (r.draining.exchange(true, std::memory_order_acquire)) return 0;
+  const Sinks& s    = sinks();
+  uint16_t     done = 0;
+  uint32_t     t    = r.tail.load(std::memory_order_relaxed);
+  char         line[kMaxRecord + 64];
+  while (done < maxRecords && t != r.head.load(std::memory_order_acquire)) {
+    RecHdr*       h  = (RecHdr*)&r.buf[t & (kRingBytes - 1)];
+    const uint8_t st = __atomic_load_n(&h->state, __ATOMIC_ACQUIRE);
+    if (st == REC_WRITING) break;                 // producer still copying
+    const uint16_t len = h->len;
+    if (st == REC_READY) {
+      if (s.nText) {
+        const size_t n = formatLine(*h, fmtAt(h->fmt), line, sizeof(line));
+        for (uint8_t i = 0; i < s.nText; ++i) s.text[i](line, n);
+      }
+      for (uint8_t i = 0; i < s.nBinary; ++i) s.binary[i].write((const uint8_t*)h, len);
+      ++done;
+    }
+    memset(h, 0, len);                            // stale bytes must not look like a header
+    t += len;
+    r.tail.store(t, std::memory_order_release);
+  }
+  for (uint8_t i = 0; i < s.nBinary; ++i)
+    if (s.binary[i].flush) s.binary[i].flush();
+  r.draining.store(false, std::memory_order_release);
+  return done;
+}
+
+} // namespace TrexLog
+
+#define TLOG(lvl, mod, fmt, ...)                                                          \
+  do {                                                                                   \
+    if constexpr (TrexLog::enabled(TrexLog::lvl, TrexLog::mod))                          \
+      TrexLog::write(TrexLog::lvl, TrexLog::mod, "" fmt, ##__VA_ARGS__);                  \
+  } while (0)
+#define TLOGE(mod, fmt, ...) TLOG(LVL_ERROR, mod, fmt, ##__VA_ARGS__)
+#define TLOGW(mod, fmt, ...) TLOG(LVL_WARN,  mod, fmt, ##__VA_ARGS__)
+#define TLOGI(mod, fmt, ...) TLOG(LVL_INFO,  mod, fmt, ##__VA_ARGS__)
+#define TLOGD(mod, fmt, ...) TLOG(LVL_DEBUG, mod, fmt, ##__VA_ARGS__)
+
+// ---------------------------------------------------------------- ESP32 glue
+#if defined(ARDUINO_ARCH_ESP32)
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+namespace TrexLog {
+
+struct Config {
+  bool     serial     = true;    // text to Serial
+  uint16_t udpPort    = 0;       // binary records to broadcast:udpPort (0 = off)
+  uint16_t drainMs    = 20;      // logger task period
+  uint8_t  priority   = 1;       // just above idle: never preempts game work
+  int8_t   core       = 0;       // keep it off the app core
+};
+
+namespace detail {
+inline WiFiUDP& udp() { static WiFiUDP u; return u; }
+inline uint16_t& udpPort() { static uint16_t p = 0; return p; }
+struct Packet { uint8_t buf[1400]; size_t len = 0; };
+inline Packet& packet() { static Packet p; return p; }
+
+inline void udpFlush() {
+  Packet& p = packet();
+  if (p.len > sizeof(StreamHdr) && WiFi.getMode() != WIFI_MODE_NULL) {
+    udp().beginPacket(IPAddress(255, 255, 255, 255), udpPort());
+    udp().write(p.buf, p.len);
+    udp().endPacket();
+  }
+  p.len = 0;
+}
+inline void udpWrite(const uint8_t* rec, size_t n) {
+  Packet& p = packet();
+  if (p.len + n > sizeof(p.buf)) udpFlush();
+  if (!p.len) { memcpy(p.buf, &kStreamHdr, sizeof(kStreamHdr)); p.len = sizeof(kStreamHdr); }
+  memcpy(p.buf + p.len, rec, n);
+  p.len += n;
+}
+inline void serialWrite(const char* line, size_t n) { Serial.write((const uint8_t*)line, n); }
+
+inline void task(void* arg) {
+  const TickType_t period = pdMS_TO_TICKS(((const Config*)arg)->drainMs);
+  for (;;) {
+    while (drain() != 0) {}
+    vTaskDelay(period ? period : 1);
+  }
+}
+} // namespace detail
+
+inline std::atomic<bool>& started() { static std::atomic<bool> s{false}; return s; }
+
+// Starts the logger task (once; later calls return true and keep the first
+// Config). Sinks may be added before or after.
+inline bool begin(const Config& cfg = Config{}) {
+  static Config       c;
+  static TaskHandle_t handle = nullptr;
+  if (started().exchange(true)) return true;
+  c = cfg;
+  if (c.serial) addTextSink(detail::serialWrite);
+  if (c.udpPort) {
+    detail::udpPort() = c.udpPort;
+    addBinarySink({detail::udpWrite, detail::udpFlush});
+  }
+  return xTaskCreatePinnedToCore(detail::task, "trexlog", 4096, &c, c.priority, &handle, c.core) == pdPASS;
+}
+
+// For call sites that predate the logger (LOGF): starts it with the default
+// Config (text to Serial) unless the sketch already did. One relaxed load
+// once running.
+inline void ensureStarted() {
+  if (!started().load(std::memory_order_relaxed)) begin();
+}
+
+} // namespace TrexLog
+#endif
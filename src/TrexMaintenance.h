@@ -2,6 +2,8 @@
 // - Long-press BOOT (GPIO0) at runtime to enter maintenance
 // - Brings up Wi-Fi (STA with AP fallback), OTA, Telnet, mDNS, UDP beacons
 // - Pause your game logic while Maint::active == true
+// - begin() returns at once; Maint::loop() brings Wi-Fi and the services up
+//   step by step (Maint::state() / Maint::ready() report progress)
 #pragma once
 #include <Arduino.h>
 #include <WiFi.h>
@@ -10,6 +12,11 @@
 #include <ESPmDNS.h>
 #include <ArduinoOTA.h>
 #include <TrexProtocol.h>   // for StationType
+#include "TrexCapture.h"
+#include "TrexConsole.h"
+#include "TrexLog.h"
+#include "TrexRxRing.h"
+#include "TrexStats.h"
 
 #ifndef MAINT_ENABLE_HTTP_FS
 #define MAINT_ENABLE_HTTP_FS 1
@@ -18,8 +25,47 @@
 #if MAINT_ENABLE_HTTP_FS
   #include <WebServer.h>
   #include <LittleFS.h>
+  #include "TrexFsUpload.h"
   static WebServer *maintHttp = nullptr;
-  static const char* kUploadPath = "/LootDrop.wav"; // change if you want a different filename
+  static const char* kUploadPath = "/LootDrop.wav"; // default for the telnet 'stat' command
+
+  // POST /upload takes up to kUploadMaxFiles multipart files (more are listed
+  // as SKIP and answered 413, the first ones still stored). Each lands at
+  // ?path= (single file) or ?dir= + its own name (default "/"). Optional ?size= and
+  // ?crc= (hex) are comma lists in file order, e.g.
+  //   curl -F f=@LootDrop.wav "http://trex-loot-1.local/upload?dir=/clips&crc=$(crc32 LootDrop.wav)"
+  static constexpr uint8_t  kUploadMaxFiles = 8;
+  static FsUpload::Writer   uploadWriter;
+  static FsUpload::Result   uploadResults[kUploadMaxFiles];
+  static uint8_t            uploadCount = 0;
+  static String             uploadSkipped;   // one SKIP line per file past the limit
+
+  // idx-th entry of a comma list query arg.
+  inline bool uploadListArg(const char* key, uint8_t idx, int base, uint32_t& out) {
+    if (!maintHttp->hasArg(key)) return false;
+    String      v = maintHttp->arg(key);
+    const char* p = v.c_str();
+    for (; idx && *p; ++p) if (*p == ',') --idx;
+    if (idx || !*p || *p == ',') return false;
+    char* end;
+    out = (uint32_t)strtoul(p, &end, base);
+    return end != p;
+  }
+
+  inline String uploadTarget(const HTTPUpload& up) {
+    if (maintHttp->hasArg("path")) return maintHttp->arg("path");
+    String dir = maintHttp->hasArg("dir") ? maintHttp->arg("dir") : String("/");
+    if (!dir.endsWith("/")) dir += '/';
+    const char* name = up.filename.c_str();
+    for (const char* q = name; *q; ++q) if (*q == '/' || *q == '\\') name = q + 1;   // browser paths
+    return dir + name;
+  }
+
+  inline void uploadLine(const FsUpload::Result& r, char* buf, size_t cap) {
+    if (r.error) snprintf(buf, cap, "FAIL %s: %s\r\n", r.path, r.error);
+    else snprintf(buf, cap, "OK %s %u B crc=%08x %u ms %u KB/s\r\n",
+                  r.path, (unsigned)r.size, (unsigned)r.crc, (unsigned)r.ms, (unsigned)r.kBps());
+  }
 
   inline void startHttpFs() {
     MDNS.addService("http","tcp",80);
@@ -29,26 +75,66 @@
     maintHttp->on("/", HTTP_GET, [](){
       maintHttp->send(200,"text/html",
         "<h3>TREX FS Uploader</h3>"
-        "<form method='POST' action='/upload' enctype='multipart/form-data'>"
-        "<input type='file' name='f'><input type='submit' value='Upload'></form>"
-        "<p>Target: " + String(kUploadPath) + "</p>");
+        "<form method='POST' action='/upload' enctype='multipart/form-data'"
+        " onsubmit=\"this.action='/upload?dir='+encodeURIComponent(this.d.value)\">"
+        "Folder <input name='d' value='/'> <input type='file' name='f' multiple>"
+        "<input type='submit' value='Upload'></form>");
+    });
+
+    // Files back out, e.g. a 'cap save' capture: GET /download?path=/cap.bin
+    maintHttp->on("/download", HTTP_GET, [](){
+      const String p = maintHttp->arg("path");
+      File f = FsUpload::validPath(p.c_str()) ? LittleFS.open(p.c_str(), "r") : File();
+      if (!f || f.isDirectory()) { maintHttp->send(404, "text/plain", "not found\r\n"); return; }
+      maintHttp->streamFile(f, "application/octet-stream");
+      f.close();
     });
 
     maintHttp->on("/upload", HTTP_POST,
-      [](){ maintHttp->send(200,"text/plain","OK. Reboot or re-open file to use new clip."); },
+      [](){
+        String body = uploadCount ? "" : "no files\r\n";
+        bool   ok   = uploadCount > 0;
+        char   line[128];
+        for (uint8_t i = 0; i < uploadCount; ++i) {
+          uploadLine(uploadResults[i], line, sizeof(line));
+          body += line;
+          ok = ok && !uploadResults[i].error;
+        }
+        if (uploadSkipped.length()) body += uploadSkipped;
+        maintHttp->send(uploadSkipped.length() ? 413 : ok ? 200 : 400, "text/plain", body);
+        uploadCount = 0;
+        uploadSkipped = "";
+      },
       [](){
         HTTPUpload &up = maintHttp->upload();
-        static File f;
         switch (up.status) {
           case UPLOAD_FILE_START:
-            if (LittleFS.exists(kUploadPath)) LittleFS.remove(kUploadPath);
-            f = LittleFS.open(kUploadPath, "w");
+            if (uploadCount >= kUploadMaxFiles) {   // its data is read and dropped
+              uploadSkipped += "SKIP " + uploadTarget(up) + ": more than " + String(kUploadMaxFiles) + " files\r\n";
+              break;
+            }
+            uploadWriter.begin(LittleFS, uploadTarget(up).c_str());
             break;
           case UPLOAD_FILE_WRITE:
-            if (f) f.write(up.buf, up.currentSize);
+            uploadWriter.write(up.buf, up.currentSize);
+            break;
+          case UPLOAD_FILE_END: {
+            if (uploadCount >= kUploadMaxFiles) break;
+            FsUpload::Expect e;
+            e.hasSize = uploadListArg("size", uploadCount, 10, e.size);
+            e.hasCrc  = uploadListArg("crc",  uploadCount, 16, e.crc);
+            uploadWriter.finish(e);
+            char line[128];
+            uploadResults[uploadCount] = uploadWriter.result();
+            uploadLine(uploadResults[uploadCount++], line, sizeof(line));
+            Serial.print(line);
             break;
-          case UPLOAD_FILE_END:
-            if (f) f.close();
+          }
+          case UPLOAD_FILE_ABORTED:
+            uploadWriter.abort();
+            uploadCount = 0;
+            uploadSkipped = "";
+            Serial.println("[Maint] upload aborted, old files kept");
             break;
           default:
             break;
@@ -64,13 +150,6 @@
 
 namespace Maint {
 
-// ── NEW: custom command hook so stations can add Telnet commands
-using CmdHandler = bool(*)(const String& cmd, WiFiClient& out);
-inline CmdHandler& CustomHandler() {  // single instance across the program
-  static CmdHandler h = nullptr;
-  return h;
-}
-
 struct Config {
   // Wi-Fi
   const char* ssid;                // STA SSID (nullptr/"" -> skip STA)
@@ -89,6 +168,18 @@ struct Config {
   bool        enableBeacon   = true;
   uint16_t    beaconPort     = 32458; // listen with: nc -ul 32458
   uint32_t    beaconIntervalMs = 5000;
+  // Bring-up
+  uint32_t    staTimeoutMs   = 8000;  // give up on STA and fall back to SoftAP
+};
+
+// Bring-up progress, advanced from loop().
+enum class State : uint8_t {
+  OFF,             // not in maintenance
+  STA_CONNECTING,  // WiFi.begin() issued, waiting for an IP
+  AP_START,        // STA skipped or timed out, SoftAP next
+  SERVICES,        // network up, starting mDNS / OTA / telnet / beacon / HTTP
+  READY,           // everything serving
+  NO_NETWORK       // STA failed and apFallback is off
 };
 
 // State
@@ -98,6 +189,29 @@ static WiFiClient  client;
 static Config      cfg_;
 static WiFiUDP     beacon;
 static uint32_t    lastBeacon = 0;
+static State       state_     = State::OFF;
+static uint32_t    stateAt    = 0;   // millis() when state_ was entered
+static uint8_t     serviceStep = 0;
+
+inline State    state()   { return state_; }
+inline bool     ready()   { return state_ == State::READY; }
+inline uint32_t stateMs() { return millis() - stateAt; }
+inline const char* stateStr(State s) {
+  switch (s) {
+    case State::OFF:            return "off";
+    case State::STA_CONNECTING: return "sta-connecting";
+    case State::AP_START:       return "ap-start";
+    case State::SERVICES:       return "services";
+    case State::READY:          return "ready";
+    case State::NO_NETWORK:     return "no-network";
+    default:                    return "?";
+  }
+}
+
+inline void enter(State s) {
+  state_  = s;
+  stateAt = millis();
+}
 
 inline const char* typeStr(StationType t) {
   switch (t) {
@@ -108,6 +222,13 @@ inline const char* typeStr(StationType t) {
   }
 }
 
+// TrexLog text sink. It runs on the logger task, so lines are queued here and
+// written by loop(), which owns the client; dropped while nobody listens.
+static TrexRxRing<8, TrexLog::kMaxRecord + 64> telnetLog;
+inline void logToTelnet(const char* line, size_t n) {
+  telnetLog.push((const uint8_t*)line, (uint16_t)n, nullptr);
+}
+
 // Telnet printf helper (safe no-op if no client)
 inline void print(const char* fmt, ...) {
   if (!client || !client.connected()) return;
@@ -147,60 +268,233 @@ inline void sendBeaconOnce() {
   beacon.endPacket();
 }
 
+// ── Built-in telnet commands (stations add theirs with Console::add)
+inline IPAddress ip() {
+  return (WiFi.getMode()==WIFI_MODE_AP) ? WiFi.softAPIP() : WiFi.localIP();
+}
+
+inline void cmdIp(const char*, Print& out)     { out.printf("IP: %s\r\n", ip().toString().c_str()); }
+inline void cmdRssi(const char*, Print& out)   { out.printf("RSSI: %d dBm\r\n", WiFi.RSSI()); }
+inline void cmdFree(const char*, Print& out)   { out.printf("Heap: %u\r\n", (unsigned)ESP.getFreeHeap()); }
+inline void cmdWhoami(const char*, Print& out) {
+  out.printf("%s id=%u type=%s\r\n", cfg_.host, cfg_.stationId, typeStr(cfg_.stationType));
+}
+inline void cmdWifi(const char*, Print& out) {
+  out.printf("%s %s ch=%u rssi=%d\r\n", WiFi.getMode()==WIFI_MODE_AP ? "ap" : "sta",
+             ip().toString().c_str(), (unsigned)WiFi.channel(), WiFi.RSSI());
+}
+inline void cmdReboot(const char*, Print& out) { out.print("Rebooting...\r\n"); delay(200); ESP.restart(); }
+inline void cmdStats(const char* args, Print& out) {
+  if (!strcmp(args, "reset")) { TrexStats::reset(); out.print("ok\r\n"); }
+  else TrexStats::writeReport([&](const char* line) { out.print(line); });
+}
+
+#if MAINT_ENABLE_HTTP_FS
+inline void cmdDf(const char*, Print& out) {
+  size_t total = LittleFS.totalBytes(), used = LittleFS.usedBytes();
+  out.printf("LittleFS: used=%u / total=%u (free=%u)\r\n",
+             (unsigned)used, (unsigned)total, (unsigned)(total-used));
+}
+inline void cmdLs(const char* args, Print& out) {
+  File root = LittleFS.open(args[0] ? args : "/");
+  if (!root) { out.print("LittleFS not mounted\r\n"); return; }
+  File f = root.openNextFile();
+  while (f) {
+    out.printf("%s\t%u\r\n", f.name(), (unsigned)f.size());
+    f = root.openNextFile();
+  }
+}
+inline void cmdStat(const char* args, Print& out) {
+  const char* p = args[0] ? args : kUploadPath;
+  File f = LittleFS.open(p, "r");
+  if (!f) out.print("missing\r\n");
+  else { out.printf("%s size=%u\r\n", p, (unsigned)f.size()); f.close(); }
+}
+inline void cmdRm(const char* args, Print& out) {
+  if (args[0] != '/') out.print("usage: rm /filename\r\n");
+  else if (LittleFS.remove(args)) out.print("ok\r\n");
+  else out.print("fail\r\n");
+}
+inline void cmdFormat(const char*, Print& out) {
+  out.print("Formatting...\r\n");
+  LittleFS.format();
+  out.print("Done. Rebooting.\r\n");
+  delay(300);
+  ESP.restart();
+}
+inline void cmdUpload(const char*, Print& out) {
+  out.printf("HTTP upload: http://%s.local/ (or http://%s/)\r\n", cfg_.host, ip().toString().c_str());
+  out.print("POST /upload?dir=/clips (multipart, several files; optional &crc=hex,...)\r\n");
+}
+#endif
+
+#if TREX_CAPTURE
+// cap [on|off|clear|dump|save /path]: no argument prints the ring state.
+inline void cmdCap(const char* args, Print& out) {
+  if (!strcmp(args, "on") || !strcmp(args, "off")) TrexCapture::enable(args[1] == 'n');
+  else if (!strcmp(args, "clear")) TrexCapture::clear();
+  else if (!strcmp(args, "dump")) {
+    TrexCapture::Reader rd;
+    TrexCapture::Record rec;
+    char line[40 + 2 * TrexCapture::kMaxFrame];
+    while (rd.next(rec)) {
+      TrexCapture::formatLine(rec, line, sizeof(line));
+      out.print(line);
+    }
+    return;
+  }
+#if MAINT_ENABLE_HTTP_FS
+  else if (!strncmp(args, "save ", 5)) {
+    File f = LittleFS.open(args + 5, "w");
+    if (!f) { out.print("open failed\r\n"); return; }
+    const uint32_t n = TrexCapture::save(f);
+    out.printf("%u frames, %u B -> %s (GET /download?path=%s)\r\n",
+               (unsigned)n, (unsigned)f.size(), args + 5, args + 5);
+    f.close();
+    return;
+  }
+#endif
+  else if (args[0]) { out.print("usage: cap [on|off|clear|dump|save /path]\r\n"); return; }
+  const TrexCapture::Info i = TrexCapture::info();
+  out.printf("capture %s: %u frames, %u overwritten, %u/%u B\r\n", i.on ? "on" : "off",
+             (unsigned)i.frames, (unsigned)i.overwritten, (unsigned)i.usedBytes, (unsigned)TREX_CAPTURE_BYTES);
+}
+#endif
+
+// Deprecated: the single hook from before the Console registry, kept so
+// existing server sketches build and behave as before. Lines that match no
+// registered command are passed to it lowercased; it returns false for "?".
+// New code registers each command with Console::add().
+using CmdHandler = bool(*)(const String& cmd, WiFiClient& out);
+inline CmdHandler& CustomHandler() {  // single instance across the program
+  static CmdHandler h = nullptr;
+  return h;
+}
+
+inline bool customFallback(const char* line, Print&) {
+  CmdHandler h = CustomHandler();
+  if (!h) return false;
+  String cmd(line);
+  cmd.toLowerCase();
+  return h(cmd, client);
+}
+
+inline void addBuiltinCommands() {
+  Console::add({"ip",     "",        "Show IP address",           cmdIp});
+  Console::add({"rssi",   "",        "Show Wi-Fi RSSI (dBm)",     cmdRssi});
+  Console::add({"free",   "",        "Show free heap (bytes)",    cmdFree});
+  Console::add({"whoami", "",        "Show host / id / type",     cmdWhoami});
+  Console::add({"wifi",   "",        "Show Wi-Fi mode / IP / channel", cmdWifi});
+  Console::add({"reboot", "",        "Reboot device",             cmdReboot});
+  Console::add({"stats",  "[reset]", "Transport counters / clear them", cmdStats});
+#if MAINT_ENABLE_HTTP_FS
+  Console::add({"df",     "",        "LittleFS usage",            cmdDf});
+  Console::add({"ls",     "[/dir]",  "List files",                cmdLs});
+  Console::add({"stat",   "[/path]", "Show file size (default: clip)", cmdStat});
+  Console::add({"rm",     "/path",   "Delete file at /path",      cmdRm});
+  Console::add({"format", "",        "FORMAT LittleFS (ERASES ALL)", cmdFormat});
+  Console::add({"upload", "",        "How to upload files over HTTP", cmdUpload});
+#endif
+#if TREX_CAPTURE
+  Console::add({"cap",    "[on|off|clear|dump|save]", "Frame capture (save /path -> LittleFS)", cmdCap});
+#endif
+}
+
 inline void begin(const Config& cfg) {
-  cfg_   = cfg;
-  active = true;
+  cfg_        = cfg;
+  active      = true;
+  serviceStep = 0;
+  addBuiltinCommands();
+  TrexLog::begin();                      // no-op if the sketch started it already
+  TrexLog::addTextSink(logToTelnet);     // registers once, however often begin() runs
 
   WiFi.persistent(false);
-  bool staOK = false;
-
   if (cfg_.ssid && cfg_.ssid[0]) {
     WiFi.mode(WIFI_STA);
     WiFi.setHostname(cfg_.host);
     WiFi.setSleep(false);
     esp_wifi_set_ps(WIFI_PS_NONE);
-    WiFi.begin(cfg_.ssid, cfg_.pass);
-    uint32_t t0 = millis();
-    while (WiFi.status() != WL_CONNECTED && (millis() - t0) < 8000) delay(50);
-    staOK = (WiFi.status() == WL_CONNECTED);
-  }
-
-  if (!staOK && cfg_.apFallback) {
-    String ssid = String(cfg_.host) + "-" + String((uint32_t)(ESP.getEfuseMac() & 0xFFFF), HEX);
-    WiFi.mode(WIFI_AP);
-    WiFi.setSleep(false);
-    esp_wifi_set_ps(WIFI_PS_NONE);
-    WiFi.softAP(ssid.c_str(), cfg_.apPass, cfg_.apChannel, 0, 1);
-    Serial.printf("[Maint] SoftAP: %s  pass:%s  ip:%s\n",
-                  WiFi.softAPSSID().c_str(), cfg_.apPass, WiFi.softAPIP().toString().c_str());
-  } else if (staOK) {
-    Serial.printf("[Maint] STA ip: %s\n", WiFi.localIP().toString().c_str());
+    WiFi.begin(cfg_.ssid, cfg_.pass);   // returns at once; loop() waits for the IP
+    enter(State::STA_CONNECTING);
+  } else {
+    enter(cfg_.apFallback ? State::AP_START : State::NO_NETWORK);
   }
+}
 
-  startMdns();
-
-  ArduinoOTA.setHostname(cfg_.host);
-  ArduinoOTA.onStart([](){ Serial.println("[OTA] start"); });
-  ArduinoOTA.onEnd  ([](){ Serial.println("[OTA] end"); });
-  ArduinoOTA.onProgress([](unsigned int p, unsigned int t){
-    if (t) Serial.printf("[OTA] %u%%\n", (p*100)/t);
-  });
-  ArduinoOTA.onError([](ota_error_t e){ Serial.printf("[OTA] err %u\n", e); });
-  ArduinoOTA.begin();
-
-  telnet.begin();
-  telnet.setNoDelay(true);
+inline void startAp() {
+  String ssid = String(cfg_.host) + "-" + String((uint32_t)(ESP.getEfuseMac() & 0xFFFF), HEX);
+  WiFi.mode(WIFI_AP);
+  WiFi.setSleep(false);
+  esp_wifi_set_ps(WIFI_PS_NONE);
+  WiFi.softAP(ssid.c_str(), cfg_.apPass, cfg_.apChannel, 0, 1);
+  Serial.printf("[Maint] SoftAP: %s  pass:%s  ip:%s\n",
+                WiFi.softAPSSID().c_str(), cfg_.apPass, WiFi.softAPIP().toString().c_str());
+}
 
-  if (cfg_.enableBeacon) {
-    beacon.begin(cfg_.beaconPort);
-    sendBeaconOnce(); // fire one immediately
+// One service per call so no single loop() pass carries all the setup cost.
+// Returns true when the last one is up.
+inline bool startNextService() {
+  switch (serviceStep++) {
+    case 0:
+      startMdns();
+      return false;
+    case 1:
+      ArduinoOTA.setHostname(cfg_.host);
+      ArduinoOTA.onStart([](){ Serial.println("[OTA] start"); });
+      ArduinoOTA.onEnd  ([](){ Serial.println("[OTA] end"); });
+      ArduinoOTA.onProgress([](unsigned int p, unsigned int t){
+        if (t) Serial.printf("[OTA] %u%%\n", (p*100)/t);
+      });
+      ArduinoOTA.onError([](ota_error_t e){ Serial.printf("[OTA] err %u\n", e); });
+      ArduinoOTA.begin();
+      return false;
+    case 2:
+      telnet.begin();
+      telnet.setNoDelay(true);
+      Serial.printf("[Maint] Telnet: %s.local:23\n", cfg_.host);
+      return false;
+    case 3:
+      if (cfg_.enableBeacon) {
+        beacon.begin(cfg_.beaconPort);
+        sendBeaconOnce(); // fire one immediately
+        lastBeacon = millis();
+      }
+      return false;
+    default:
+      #if MAINT_ENABLE_HTTP_FS
+        startHttpFs();
+      #endif
+      return true;
   }
-  
-  #if MAINT_ENABLE_HTTP_FS
-    startHttpFs();
-  #endif
+}
 
-  Serial.printf("[Maint] Telnet: %s.local:23\n", cfg_.host);
+// Advances the bring-up; never waits.
+inline void stepBringUp() {
+  switch (state_) {
+    case State::STA_CONNECTING: {
+      const wl_status_t st = WiFi.status();
+      if (st == WL_CONNECTED) {
+        Serial.printf("[Maint] STA ip: %s (%u ms)\n", WiFi.localIP().toString().c_str(), (unsigned)stateMs());
+        enter(State::SERVICES);
+      } else if (st == WL_CONNECT_FAILED || stateMs() >= cfg_.staTimeoutMs) {
+        Serial.printf("[Maint] STA failed (status %d)\n", (int)st);
+        enter(cfg_.apFallback ? State::AP_START : State::NO_NETWORK);
+      }
+      break;
+    }
+    case State::AP_START:
+      startAp();
+      enter(State::SERVICES);
+      break;
+    case State::SERVICES:
+      if (startNextService()) {
+        Serial.printf("[Maint] ready (%s)\n", ip().toString().c_str());
+        enter(State::READY);
+      }
+      break;
+    default:
+      break;
+  }
 }
 
 // Runtime long-press entry (use this on FeatherS3; call from loop())
@@ -222,98 +516,40 @@ inline bool checkRuntimeEntry(const Config& cfg) {
   return false;
 }
 
+static Console::LineReader lineIn;
+
 inline void loop() {
   if (!active) return;
+  if (state_ != State::READY) { stepBringUp(); return; }
   ArduinoOTA.handle();
 
   // Accept telnet client
   if (telnet.hasClient()) {
     if (client && client.connected()) { telnet.available().stop(); }
-    client = telnet.available();
-    client.setNoDelay(true);
-    client.print(
-      "\r\n[TREX] maintenance console\r\n"
-      "Type 'help' for commands. HTTP FS upload served on port 80.\r\n"
-    );
-  }
-  // Telnet commands
-  if (client && client.connected() && client.available()) {
-    String cmd = client.readStringUntil('\n'); cmd.trim(); cmd.toLowerCase();
-    if (cmd == "help") {
-      IPAddress ip = (WiFi.getMode()==WIFI_MODE_AP) ? WiFi.softAPIP() : WiFi.localIP();
+    else {
+      client = telnet.available();
+      client.setNoDelay(true);
+      lineIn.reset();
       client.print(
-        "Commands:\r\n"
-        "  help            Show this help\r\n"
-        "  ip              Show IP address\r\n"
-        "  rssi            Show Wi-Fi RSSI (dBm)\r\n"
-        "  free            Show free heap (bytes)\r\n"
-        "  whoami          Show host / id / type\r\n"
-        "  reboot          Reboot device\r\n"
-      #if MAINT_ENABLE_HTTP_FS
-        "  df              LittleFS usage\r\n"
-        "  ls              List files in /\r\n"
-        "  stat            Show uploaded clip size\r\n"
-        "  rm /path        Delete file at /path\r\n"
-        "  format          FORMAT LittleFS (ERASES ALL)\r\n"
-      #endif
-        "  --- server cmds available while in maintenance ---\r\n"
-        "  status, set <key> <val>, pir on|off, cap/inv/fill/drain,\r\n"
-        "  score +/-N, sprite <clip>, new, end, green, red\r\n"
+        "\r\n[TREX] maintenance console\r\n"
+        "Type 'help' for commands. HTTP FS upload served on port 80.\r\n"
       );
-      #if MAINT_ENABLE_HTTP_FS
-        client.printf("HTTP upload: http://%s.local/ (or http://%s/)\r\n",
-                      cfg_.host, ((WiFi.getMode()==WIFI_MODE_AP)?WiFi.softAPIP().toString().c_str()
-                                                            :WiFi.localIP().toString().c_str()));
-        client.printf("Target file: %s\r\n", kUploadPath);
-      #endif
-    }
-    else if (cmd=="ip")     client.printf("IP: %s\r\n",
-                              (WiFi.getMode()==WIFI_MODE_AP)?WiFi.softAPIP().toString().c_str()
-                                                            :WiFi.localIP().toString().c_str());
-    else if (cmd=="rssi")   client.printf("RSSI: %d dBm\r\n", WiFi.RSSI());
-    else if (cmd=="free")   client.printf("Heap: %u\r\n", (unsigned)ESP.getFreeHeap());
-    else if (cmd=="whoami") client.printf("%s id=%u type=%s\r\n", cfg_.host, cfg_.stationId, typeStr(cfg_.stationType));
-    else if (cmd=="reboot"){ client.print("Rebooting...\r\n"); delay(200); ESP.restart(); }
-    #if MAINT_ENABLE_HTTP_FS
-    else if (cmd=="stat") {
-      File f = LittleFS.open(kUploadPath, "r");
-      if (!f) client.print("missing\r\n");
-      else { client.printf("%s size=%u\r\n", kUploadPath, (unsigned)f.size()); f.close(); }
-    }
-    else if (cmd=="df") {
-      size_t total = LittleFS.totalBytes(), used = LittleFS.usedBytes();
-      client.printf("LittleFS: used=%u / total=%u (free=%u)\r\n",
-                    (unsigned)used, (unsigned)total, (unsigned)(total-used));
-    }
-    else if (cmd == "ls") {
-      File root = LittleFS.open("/");
-      if (!root) { client.print("LittleFS not mounted\r\n"); }
-      else {
-        File f = root.openNextFile();
-        while (f) {
-          client.printf("%s\t%u\r\n", f.name(), (unsigned)f.size());
-          f = root.openNextFile();
-        }
-      }
-    }
-    else if (cmd.startsWith("rm ")) {
-      String p = cmd.substring(3); p.trim();
-      if (p.length()==0 || p[0] != '/') client.print("usage: rm /filename\r\n");
-      else if (LittleFS.remove(p)) client.print("ok\r\n");
-      else client.print("fail\r\n");
     }
-    else if (cmd == "format") {
-      client.print("Formatting...\r\n");
-      LittleFS.format();
-      client.print("Done. Rebooting.\r\n");
-      delay(300);
-      ESP.restart();
-    }
-    #endif
-	else if (CustomHandler() && CustomHandler()(cmd, client)) {
-      // handled by server-specific commands
+  }
+  // Telnet commands: only bytes already received, never waits for a full line
+  if (client && client.connected() && lineIn.poll(client)) {
+    if (lineIn.takeOverflow()) client.printf("line too long (max %u)\r\n", (unsigned)(Console::kLineMax - 1));
+    else {
+      // Sketches may set CustomHandler() before or after begin(); a fallback
+      // of their own (Console::setFallback) takes precedence.
+      if (CustomHandler() && !Console::registry().fallback)
+        Console::setFallback(customFallback, "--- server cmds (sketch's CustomHandler) also accepted ---");
+      Console::dispatch(lineIn.line(), client);
     }
-    else                    client.print("?\r\n");
+  }
+  for (const auto* l = telnetLog.peek(); l; l = telnetLog.peek()) {
+    if (client && client.connected()) client.write(l->data, l->len);
+    telnetLog.pop();
   }
 
   // Periodic UDP beacon
@@ -329,7 +565,9 @@ inline void loop() {
 
 } // namespace Maint
 
-// Convenience: mirror Serial.printf to telnet when active
+// Convenience: app log line, formatted later by the TrexLog task and sent to
+// Serial and (in maintenance) telnet. The first LOGF starts the logger if the
+// sketch hasn't called TrexLog::begin(), so older sketches keep their output.
 #ifndef LOGF
-  #define LOGF(...) do { Serial.printf(__VA_ARGS__); Maint::print(__VA_ARGS__); } while(0)
+  #define LOGF(...) do { TrexLog::ensureStarted(); TLOGI(MOD_APP, __VA_ARGS__); } while (0)
 #endif
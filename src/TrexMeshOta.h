@@ -0,0 +1,533 @@
+#pragma once
+// TrexMeshOta.h — firmware distribution over ESP-NOW broadcast with NACK repair.
+//
+// One sender (the T-Rex server, or any station already running the image)
+// streams it once and every targeted station writes it at the same time:
+//
+//   OTA_OFFER ANNOUNCE   size / CRC / version / targeting; receivers prepare
+//                        (erase) their OTA partition during the lead time
+//   OTA_CHUNK ...        numbered chunks, written wherever they land
+//   OTA_OFFER PASS_END   receivers answer OTA_NACK with up to 16 missing
+//                        ranges; the sender re-broadcasts the union of all
+//                        NACKs and ends the pass again
+//   OTA_OFFER FINISHED   nothing left to repair (or maxPasses reached)
+//
+// Progress and the outcome go out as OTA_STATUS with the offer's campaignId,
+// as for the HTTP path of CONFIG_UPDATE. Everything is broadcast: NACKs reach
+// whichever station is sending, and one repaired chunk serves every station
+// that missed it, so a fleet costs one image plus repairs.
+//
+// Sender (server), with Source::read(offset, dst, n):
+//   static MeshOta::Sender<ImageFile> tx(file);
+//   tx.start(campaignId, file.size(), StationType::LOOT, 0, 1, 4, /*senderId*/ 0, millis());
+//   static TxFrame f;
+//   while (tx.poll(millis(), f)) if (!Transport::broadcast(f)) { tx.unsent(); break; }
+//   on OTA_NACK -> tx.onNack(p, hdr.payloadLen);   on OTA_STATUS -> tx.onStatus(p)
+//
+// Receiver (station), with Sink::begin / write / finish / abort:
+//   static MeshOta::Receiver<MeshOta::FlashSink> rx;
+//   rx.begin(StationType::LOOT, myId, FW_MAJOR, FW_MINOR);
+//   on OTA_OFFER -> rx.onOffer(p, millis());   on OTA_CHUNK -> rx.onChunk(p, hdr.payloadLen, millis())
+//   while (rx.poll(millis(), f)) Transport::broadcast(f);
+//   if (rx.succeeded()) ESP.restart();
+//
+// MeshOta::RunningImage serves the running firmware, so an updated station
+// can act as the sender for the next group. extras/meshota runs a sender and a
+// lossy fleet of receivers on the host.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "TrexCrc32.h"
+#include "TrexProtocol.h"
+#include "TrexTransport.h"
+
+namespace MeshOta {
+
+static constexpr uint16_t kMaxChunks = 16384;   // 3.6 MB at TREX_OTA_CHUNK_BYTES
+static constexpr uint8_t  kMaxRanges = sizeof(OtaNackPayload::ranges) / sizeof(OtaRange);
+static_assert(offsetof(OtaChunkPayload, data) + TREX_OTA_CHUNK_BYTES <= TxFrame::kMaxPayload,
+              "OTA chunk does not fit one frame");
+
+enum OtaError : uint8_t {   // OtaStatusPayload.error values used here
+  OTA_ERR_OK = 0, OTA_ERR_NOLEN = 3, OTA_ERR_WRITE = 4, OTA_ERR_VERIFY = 5, OTA_ERR_TIMEOUT = 6,
+  OTA_ERR_BASE = 7, OTA_ERR_FORMAT = 8   // TrexOtaImage: wrong delta base / corrupt artifact
+};
+
+// CRC-32 of the image (TrexCrc32.h); chain calls by passing the previous result.
+inline uint32_t crc32Update(uint32_t crc, const uint8_t* d, size_t n) { return trexCrc32Update(crc, d, n); }
+
+// One bit per chunk.
+class ChunkMap {
+public:
+  void reset(uint16_t n, bool value) {
+    n_ = n;
+    memset(bits_, value ? 0xFF : 0, sizeof(bits_));
+    set_ = value ? n : 0;
+  }
+  bool test(uint16_t i) const { return i < n_ && (bits_[i >> 3] >> (i & 7)) & 1; }
+  void set(uint16_t i)   { if (i < n_ && !test(i)) { bits_[i >> 3] |= (uint8_t)(1u << (i & 7)); ++set_; } }
+  void clear(uint16_t i) { if (test(i)) { bits_[i >> 3] &= (uint8_t)~(1u << (i & 7)); --set_; } }
+  uint16_t count() const { return set_; }
+  uint16_t size()  const { return n_; }
+  // First index >= from whose bit equals value, or size() if none.
+  uint16_t next(uint16_t from, bool value) const {
+    for (uint32_t i = from; i < n_; ++i) {
+      const uint8_t b = value ? bits_[i >> 3] : (uint8_t)~bits_[i >> 3];
+      if (!(i & 7) && !b) { i += 7; continue; }
+      if ((b >> (i & 7)) & 1) return (uint16_t)i;
+    }
+    return n_;
+  }
+
+private:
+  uint8_t  bits_[kMaxChunks / 8];
+  uint16_t n_   = 0;
+  uint16_t set_ = 0;
+};
+
+inline bool targets(const OtaOfferPayload& o, uint8_t stationType, uint8_t stationId) {
+  return (o.stationType == 0 || o.stationType == stationType) && (o.targetId == 0 || o.targetId == stationId);
+}
+
+// ---------------------------------------------------------------- sender
+template <class Source>
+class Sender {
+public:
+  struct Config {
+    uint16_t chunksPerSec  = 150;    // stream rate (ESP-NOW broadcast, 1 Mbps)
+    uint16_t leadMs        = 3000;   // ANNOUNCE time: receivers erase meanwhile
+    uint16_t quietMs       = 1500;   // after PASS_END: collect NACKs this long
+    uint16_t finishQuietMs = 5000;   // no NACK for this long and nothing to repair: done
+    uint8_t  maxPasses     = 50;
+  };
+  struct Stats { uint32_t chunksSent, repairsSent, nacksRx; uint8_t passes; };
+
+  explicit Sender(Source& src, const Config& cfg = Config()) : src_(src), cfg_(cfg) {}
+
+  // Reads the whole image once for its CRC. False if it is empty, too big or
+  // unreadable.
+  bool start(uint32_t campaignId, uint32_t imageSize, StationType type, uint8_t targetId,
+             uint8_t fwMajor, uint8_t fwMinor, uint8_t senderId, uint32_t nowMs) {
+    const uint32_t chunks = (imageSize + TREX_OTA_CHUNK_BYTES - 1) / TREX_OTA_CHUNK_BYTES;
+    if (!imageSize || chunks > kMaxChunks) return false;
+    uint8_t  buf[TREX_OTA_CHUNK_BYTES];
+    uint32_t crc = 0;
+    for (uint32_t off = 0; off < imageSize; off += sizeof(buf)) {
+      const uint16_t n = (uint16_t)(imageSize - off < sizeof(buf) ? imageSize - off : sizeof(buf));
+      if (!src_.read(off, buf, n)) return false;
+      crc = crc32Update(crc, buf, n);
+    }
+    memset(&offer_, 0, sizeof(offer_));
+    offer_.campaignId  = campaignId;
+    offer_.imageSize   = imageSize;
+    offer_.imageCrc    = crc;
+    offer_.chunkSize   = TREX_OTA_CHUNK_BYTES;
+    offer_.chunkCount  = (uint16_t)chunks;
+    offer_.stationType = (uint8_t)type;
+    offer_.targetId    = targetId;
+    offer_.fwMajor     = fwMajor;
+    offer_.fwMinor     = fwMinor;
+    offer_.senderId    = senderId;
+    need_.reset((uint16_t)chunks, true);
+    memset(started_, 0, sizeof(started_));
+    memset(done_, 0, sizeof(done_));
+    memset(&stats_, 0, sizeof(stats_));
+    phase_       = ANNOUNCE;
+    active_      = true;
+    finishSends_ = 0;
+    cursor_      = 0;
+    stateMs_     = nowMs;
+    nextOfferMs_ = nowMs;
+    lastNackMs_  = nowMs;
+    lastMs_      = nowMs;
+    credit_      = 0;
+    return true;
+  }
+
+  void stop(uint32_t nowMs) { if (active_) enter(FINISH, nowMs); }
+
+  bool active() const { return active_; }
+  const OtaOfferPayload& offer() const { return offer_; }
+  const Stats& stats() const { return stats_; }
+  uint16_t stationsStarted() const { return popcount(started_); }
+  uint16_t stationsDone()    const { return popcount(done_); }
+
+  void onNack(const OtaNackPayload& n, uint16_t payloadLen) {
+    if (!active_ || n.campaignId != offer_.campaignId || n.senderId != offer_.senderId) return;
+    const uint16_t fit = payloadLen > offsetof(OtaNackPayload, ranges)
+                           ? (uint16_t)((payloadLen - offsetof(OtaNackPayload, ranges)) / sizeof(OtaRange)) : 0;
+    uint16_t count = n.count < fit ? n.count : fit;     // min(count, what arrived, array size)
+    if (count > kMaxRanges) count = kMaxRanges;
+    for (uint16_t i = 0; i < count; ++i)
+      for (uint32_t c = n.ranges[i].first; c < (uint32_t)n.ranges[i].first + n.ranges[i].count && c < offer_.chunkCount; ++c)
+        need_.set((uint16_t)c);
+    ++stats_.nacksRx;
+    mark(started_, n.stationId);
+    lastNackMs_ = lastMs_;
+  }
+
+  void onStatus(const OtaStatusPayload& s) {
+    if (!active_ || s.campaignId != offer_.campaignId) return;
+    mark(started_, s.stationId);
+    if (s.phase == (uint8_t)OtaPhase::SUCCESS || s.phase == (uint8_t)OtaPhase::FAIL) mark(done_, s.stationId);
+  }
+
+  // Next frame to broadcast, if any is due. Call until it returns false.
+  bool poll(uint32_t nowMs, TxFrame& f) {
+    if (!active_) return false;
+    lastChunk_ = -1;
+    // Token bucket in chunk-milliseconds: 1000 per chunk, bursts of up to 4.
+    credit_ += (uint32_t)(nowMs - lastMs_) * cfg_.chunksPerSec;
+    if (credit_ > 4000) credit_ = 4000;
+    lastMs_ = nowMs;
+
+    switch (phase_) {
+      case ANNOUNCE:
+        if ((uint32_t)(nowMs - stateMs_) >= cfg_.leadMs) { enter(STREAM, nowMs); return poll(nowMs, f); }
+        return offerDue(nowMs, 500, f);
+
+      case PASS_END:
+        if ((uint32_t)(nowMs - stateMs_) >= cfg_.quietMs) {
+          if (need_.count()) {
+            enter(stats_.passes < cfg_.maxPasses ? STREAM : FINISH, nowMs);
+            return poll(nowMs, f);
+          }
+          if (allDone() || (uint32_t)(nowMs - lastNackMs_) >= cfg_.finishQuietMs) {
+            enter(FINISH, nowMs);
+            return poll(nowMs, f);
+          }
+        }
+        return offerDue(nowMs, 250, f);
+
+      case FINISH:
+        if (finishSends_ >= 3) { active_ = false; return false; }
+        if (offerDue(nowMs, 100, f)) { ++finishSends_; return true; }
+        return false;
+
+      case STREAM:
+        break;
+    }
+
+    if (credit_ < 1000) return false;
+    const uint16_t idx = need_.next(cursor_, true);
+    if (idx >= need_.size()) {
+      ++stats_.passes;
+      ++offer_.pass;
+      enter(PASS_END, nowMs);
+      return poll(nowMs, f);
+    }
+    const uint32_t off = (uint32_t)idx * TREX_OTA_CHUNK_BYTES;
+    const uint16_t n   = (uint16_t)(offer_.imageSize - off < TREX_OTA_CHUNK_BYTES ? offer_.imageSize - off
+                                                                                   : TREX_OTA_CHUNK_BYTES);
+    uint8_t* p = f.begin(MsgType::OTA_CHUNK, offer_.senderId, (uint16_t)(offsetof(OtaChunkPayload, data) + n));
+    if (!p || !src_.read(off, p + offsetof(OtaChunkPayload, data), n)) return false;
+    memcpy(p, &offer_.campaignId, sizeof(offer_.campaignId));
+    memcpy(p + offsetof(OtaChunkPayload, index), &idx, sizeof(idx));
+    need_.clear(idx);
+    cursor_    = (uint16_t)(idx + 1);
+    lastChunk_ = idx;
+    credit_   -= 1000;
+    ++stats_.chunksSent;
+    if (stats_.passes) ++stats_.repairsSent;
+    return true;
+  }
+
+  // The frame from the last poll() couldn't be sent (e.g. TX queue full):
+  // its chunk goes out next.
+  void unsent() {
+    if (lastChunk_ < 0) { nextOfferMs_ = lastMs_; return; }
+    need_.set((uint16_t)lastChunk_);
+    cursor_ = (uint16_t)lastChunk_;
+    credit_ += 1000;
+    --stats_.chunksSent;
+    if (stats_.passes) --stats_.repairsSent;
+  }
+
+private:
+  enum Phase : uint8_t { ANNOUNCE, STREAM, PASS_END, FINISH };
+
+  void enter(Phase p, uint32_t nowMs) {
+    phase_       = p;
+    stateMs_     = nowMs;
+    nextOfferMs_ = nowMs;
+    cursor_      = 0;
+  }
+
+  bool offerDue(uint32_t nowMs, uint16_t everyMs, TxFrame& f) {
+    if ((int32_t)(nowMs - nextOfferMs_) < 0) return false;
+    auto* p = f.begin<OtaOfferPayload>(MsgType::OTA_OFFER, offer_.senderId);
+    if (!p) return false;
+    *p = offer_;
+    p->state = (uint8_t)(phase_ == ANNOUNCE ? OtaOfferState::ANNOUNCE
+                       : phase_ == PASS_END ? OtaOfferState::PASS_END : OtaOfferState::FINISHED);
+    nextOfferMs_ = nowMs + everyMs;
+    return true;
+  }
+
+  static void mark(uint8_t* set, uint8_t id) { set[id >> 3] |= (uint8_t)(1u << (id & 7)); }
+  static uint16_t popcount(const uint8_t* set) {
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < 32; ++i) for (uint8_t b = set[i]; b; b &= (uint8_t)(b - 1)) ++n;
+    return n;
+  }
+  bool allDone() const { return stationsStarted() && stationsStarted() == stationsDone(); }
+
+  Source&         src_;
+  Config          cfg_;
+  OtaOfferPayload offer_{};
+  ChunkMap        need_;
+  uint8_t         started_[32] = {};   // stationIds that NACKed or reported
+  uint8_t         done_[32]    = {};   // ... and reported SUCCESS / FAIL
+  Stats           stats_{};
+  Phase           phase_       = FINISH;
+  bool            active_      = false;
+  uint8_t         finishSends_ = 0;
+  uint16_t        cursor_      = 0;
+  int32_t         lastChunk_   = -1;
+  uint32_t        stateMs_ = 0, nextOfferMs_ = 0, lastNackMs_ = 0, lastMs_ = 0, credit_ = 0;
+};
+
+// ---------------------------------------------------------------- receiver
+template <class Sink>
+class Receiver {
+public:
+  static constexpr uint32_t kStatusEveryMs = 2000;
+  static constexpr uint32_t kRenackMs      = 1000;    // PASS_END again, NACK again
+  static constexpr uint32_t kIdleNackMs    = 2000;    // sender silent while incomplete
+  static constexpr uint32_t kAbandonMs     = 60000;   // ... for this long: FAIL(timeout)
+
+  enum State : uint8_t { IDLE, RECEIVING, SUCCEEDED, FAILED };
+
+  void begin(StationType type, uint8_t stationId, uint8_t fwMajor, uint8_t fwMinor) {
+    type_    = (uint8_t)type;
+    id_      = stationId;
+    fwMajor_ = fwMajor;
+    fwMinor_ = fwMinor;
+    state_   = IDLE;
+  }
+
+  Sink&    sink()      { return sink_; }
+  State    state()     const { return state_; }
+  bool     succeeded() const { return state_ == SUCCEEDED && !skipped_; }   // reboot into it
+  uint16_t received()  const { return have_.count(); }
+  const OtaOfferPayload& offer() const { return offer_; }
+
+  void onOffer(const OtaOfferPayload& o, uint32_t nowMs) {
+    if (!targets(o, type_, id_)) return;
+    if (o.campaignId != offer_.campaignId || state_ == IDLE) {
+      if (o.state == (uint8_t)OtaOfferState::FINISHED) return;
+      if (state_ == RECEIVING) sink_.abort();
+      start(o, nowMs);
+    }
+    if (state_ != RECEIVING) return;
+    lastHeardMs_ = nowMs;
+    if (o.state == (uint8_t)OtaOfferState::FINISHED) { fail(OTA_ERR_TIMEOUT); return; }
+    if (o.state == (uint8_t)OtaOfferState::PASS_END &&
+        (o.pass != nackedPass_ || (uint32_t)(nowMs - lastNackMs_) >= kRenackMs) && !nackArmed_) {
+      // Spread the fleet's NACKs over ~200 ms.
+      nackedPass_ = o.pass;
+      nackArmed_  = true;
+      nackAtMs_   = nowMs + (uint32_t)(id_ * 37u % 200u);
+    }
+  }
+
+  void onChunk(const OtaChunkPayload& c, uint16_t payloadLen, uint32_t nowMs) {
+    if (state_ != RECEIVING || c.campaignId != offer_.campaignId || c.index >= offer_.chunkCount) return;
+    lastHeardMs_ = nowMs;
+    if (have_.test(c.index)) return;
+    const uint32_t off  = (uint32_t)c.index * offer_.chunkSize;
+    const uint32_t want = offer_.imageSize - off < offer_.chunkSize ? offer_.imageSize - off : offer_.chunkSize;
+    if (payloadLen != offsetof(OtaChunkPayload, data) + want) return;
+    if (!sink_.write(off, c.data, (uint16_t)want)) { fail(OTA_ERR_WRITE); return; }
+    have_.set(c.index);
+    if (have_.count() < offer_.chunkCount) return;
+    if (!sink_.finish(offer_.imageSize, offer_.imageCrc)) { state_ = FAILED; error_ = OTA_ERR_VERIFY; }
+    else state_ = SUCCEEDED;
+    statusDue_ = true;
+  }
+
+  // Next NACK / OTA_STATUS to broadcast, if any is due.
+  bool poll(uint32_t nowMs, TxFrame& f) {
+    if (state_ == RECEIVING) {
+      if ((uint32_t)(nowMs - lastHeardMs_) >= kAbandonMs) fail(OTA_ERR_TIMEOUT);
+      else if (!nackArmed_ && (uint32_t)(nowMs - lastHeardMs_) >= kIdleNackMs &&
+               (uint32_t)(nowMs - lastNackMs_) >= kIdleNackMs) {
+        nackArmed_ = true;
+        nackAtMs_  = nowMs;
+      }
+    }
+    if (state_ == RECEIVING && nackArmed_ && (int32_t)(nowMs - nackAtMs_) >= 0) {
+      nackArmed_  = false;
+      lastNackMs_ = nowMs;
+      return buildNack(f);
+    }
+    if (state_ == IDLE) return false;
+    if (!statusDue_ && !(state_ == RECEIVING && (uint32_t)(nowMs - lastStatusMs_) >= kStatusEveryMs)) return false;
+    statusDue_    = false;
+    lastStatusMs_ = nowMs;
+    auto* s = f.begin<OtaStatusPayload>(MsgType::OTA_STATUS, id_);
+    if (!s) return false;
+    s->stationId   = id_;
+    s->stationType = type_;
+    s->campaignId  = offer_.campaignId;
+    s->phase       = (uint8_t)(state_ == RECEIVING ? OtaPhase::STARTING
+                             : state_ == SUCCEEDED ? OtaPhase::SUCCESS : OtaPhase::FAIL);
+    s->error       = error_;
+    s->fwMajor     = fwMajor_;
+    s->fwMinor     = fwMinor_;
+    const uint32_t bytes = (uint32_t)have_.count() * offer_.chunkSize;
+    s->total       = offer_.imageSize;
+    s->bytes       = skipped_ || bytes > offer_.imageSize ? offer_.imageSize : bytes;
+    return true;
+  }
+
+private:
+  void start(const OtaOfferPayload& o, uint32_t nowMs) {
+    offer_       = o;
+    error_       = OTA_ERR_OK;
+    skipped_     = false;
+    statusDue_   = true;
+    nackArmed_   = false;
+    nackedPass_  = 0xFF;
+    nackCursor_  = 0;
+    lastHeardMs_ = lastNackMs_ = lastStatusMs_ = nowMs;
+    have_.reset(0, false);
+    if (o.fwMajor == fwMajor_ && o.fwMinor == fwMinor_) {   // already running it
+      skipped_ = true;
+      state_   = SUCCEEDED;
+      return;
+    }
+    if (!o.imageSize || o.chunkSize == 0 || o.chunkSize > TREX_OTA_CHUNK_BYTES || o.chunkCount > kMaxChunks ||
+        (uint32_t)o.chunkCount * o.chunkSize < o.imageSize) {
+      state_ = FAILED;
+      error_ = OTA_ERR_NOLEN;
+      return;
+    }
+    have_.reset(o.chunkCount, false);
+    // Blocks while the partition is erased; the offer's lead time covers it.
+    if (!sink_.begin(o.imageSize)) { state_ = FAILED; error_ = OTA_ERR_WRITE; return; }
+    state_ = RECEIVING;
+  }
+
+  void fail(uint8_t err) {
+    sink_.abort();
+    state_     = FAILED;
+    error_     = err;
+    statusDue_ = true;
+  }
+
+  // Up to kMaxRanges missing runs, continuing where the last NACK stopped so a
+  // long list is asked for over successive passes.
+  bool buildNack(TxFrame& f) {
+    OtaNackPayload n{};
+    n.campaignId = offer_.campaignId;
+    n.senderId   = offer_.senderId;
+    n.stationId  = id_;
+    const uint16_t total = offer_.chunkCount;
+    const uint16_t start = nackCursor_ < total ? nackCursor_ : 0;
+    uint16_t i = start;
+    bool wrapped = false;
+    while (n.count < kMaxRanges) {
+      const uint16_t first = have_.next(i, false);
+      if (first >= total) {
+        if (wrapped || start == 0) break;
+        wrapped = true;
+        i = 0;
+        continue;
+      }
+      if (wrapped && first >= start) break;
+      uint16_t end = have_.next(first, true);
+      if (wrapped && end > start) end = start;
+      n.ranges[n.count].first = first;
+      n.ranges[n.count].count = (uint16_t)(end - first);
+      ++n.count;
+      i = end;
+    }
+    nackCursor_ = i;
+    if (!n.count) return false;
+    const uint16_t len = (uint16_t)(offsetof(OtaNackPayload, ranges) + n.count * sizeof(OtaRange));
+    uint8_t* p = f.begin(MsgType::OTA_NACK, id_, len);
+    if (!p) return false;
+    memcpy(p, &n, len);
+    return true;
+  }
+
+  Sink            sink_;
+  OtaOfferPayload offer_{};
+  ChunkMap        have_;
+  State           state_      = IDLE;
+  uint8_t         type_ = 0, id_ = 0, fwMajor_ = 0, fwMinor_ = 0;
+  uint8_t         error_      = OTA_ERR_OK;
+  bool            skipped_    = false;
+  bool            statusDue_  = false;
+  bool            nackArmed_  = false;
+  uint8_t         nackedPass_ = 0xFF;
+  uint16_t        nackCursor_ = 0;
+  uint32_t        nackAtMs_ = 0, lastHeardMs_ = 0, lastNackMs_ = 0, lastStatusMs_ = 0;
+};
+
+} // namespace MeshOta
+
+// ---------------------------------------------------------------- ESP32 glue
+#if defined(ARDUINO_ARCH_ESP32)
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+
+namespace MeshOta {
+
+// Writes into the next OTA partition at any offset. finish() reads it back for
+// the CRC, lets esp_ota_end() validate the image and makes it the boot partition.
+class FlashSink {
+public:
+  bool begin(uint32_t size) {
+    abort();
+    part_ = esp_ota_get_next_update_partition(nullptr);
+    if (!part_ || size > part_->size || esp_ota_begin(part_, size, &h_) != ESP_OK) return false;
+    open_ = true;
+    return true;
+  }
+
+  bool write(uint32_t offset, const uint8_t* data, uint16_t n) {
+    return open_ && esp_ota_write_with_offset(h_, data, n, offset) == ESP_OK;
+  }
+
+  bool finish(uint32_t size, uint32_t crc) {
+    if (!open_) return false;
+    uint8_t  buf[256];
+    uint32_t c = 0;
+    for (uint32_t off = 0; off < size; off += sizeof(buf)) {
+      const size_t n = size - off < sizeof(buf) ? size - off : sizeof(buf);
+      if (esp_partition_read(part_, off, buf, n) != ESP_OK) { abort(); return false; }
+      c = crc32Update(c, buf, n);
+    }
+    if (c != crc) { abort(); return false; }
+    open_ = false;
+    return esp_ota_end(h_) == ESP_OK && esp_ota_set_boot_partition(part_) == ESP_OK;
+  }
+
+  void abort() {
+    if (open_) esp_ota_abort(h_);
+    open_ = false;
+  }
+
+private:
+  const esp_partition_t* part_ = nullptr;
+  esp_ota_handle_t       h_    = 0;
+  bool                   open_ = false;
+};
+
+// The firmware we're running, as a Sender source.
+class RunningImage {
+public:
+  uint32_t size() const { return ESP.getSketchSize(); }
+  bool read(uint32_t offset, uint8_t* dst, uint16_t n) {
+    return part_ && esp_partition_read(part_, offset, dst, n) == ESP_OK;
+  }
+
+private:
+  const esp_partition_t* part_ = esp_ota_get_running_partition();
+};
+
+} // namespace MeshOta
+#endif
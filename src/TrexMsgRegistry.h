@@ -0,0 +1,214 @@
+#pragma once
+// TrexMsgRegistry.h — compile-time MsgType -> payload registry + typed dispatch.
+//
+// Each registered MsgType has a MsgTraits<> specialisation giving its payload
+// struct, exact wire size (static_assert'ed, so a layout change fails the build)
+// and the minimum payloadLen still accepted from older firmware. msgTypeName()
+// maps a raw type byte back to its name for logs and tools.
+//
+// MsgDispatcher<H> routes a received message to H::on(const MsgHeader&, const P&)
+// for the matching payload type P through a 256-entry constexpr jump table: no
+// heap, no std::function, no virtuals. Types H doesn't handle (and unregistered
+// types) go to H::onUnhandled(hdr, payload, len) if present.
+//
+//   struct Station {
+//     void on(const MsgHeader&, const GameOverPayload& p) { ... }
+//     void on(const MsgHeader&, const LootHoldAckPayload& p) { ... }
+//   } station;
+//   MsgDispatcher<Station> rx(station);
+//   Transport::init(cfg, [](const uint8_t* d, uint16_t n){ rx.dispatch(d, n); });
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+#include "TrexProtocol.h"
+
+// Messages that carry no payload: each gets its own empty tag, so
+// on(const MsgHeader&, const MgStopPayload&) only sees MG_STOP.
+template <MsgType T> struct EmptyPayload {};
+using HeartbeatPayload = EmptyPayload<MsgType::HEARTBEAT>;
+using GameStartPayload = EmptyPayload<MsgType::GAME_START>;
+using MgStopPayload    = EmptyPayload<MsgType::MG_STOP>;
+
+template <class P> struct IsEmptyPayload : std::false_type {};
+template <MsgType T> struct IsEmptyPayload<EmptyPayload<T>> : std::true_type {};
+
+// Old shared tag. A handler taking it would silently stop firing, so
+// MsgDispatcher rejects it at compile time.
+struct NoPayload {};
+
+template <MsgType T> struct MsgTraits;  // undefined => not registered
+
+// Hook for filling fields an older, shorter payload didn't carry. The bytes past
+// payloadLen are already zeroed when this runs.
+template <class P> inline void msgFillLegacy(P&, uint16_t /*payloadLen*/) {}
+
+template <> inline void msgFillLegacy<GameOverPayload>(GameOverPayload& p, uint16_t payloadLen) {
+  if (payloadLen < 2) p.blameSid = GAMEOVER_BLAME_ALL;  // legacy 1-byte GAME_OVER
+}
+
+#define TREX_MSG(TYPE, PAYLOAD, WIRE_SIZE, MIN_LEN)                                   \
+  static_assert(IsEmptyPayload<PAYLOAD>::value || sizeof(PAYLOAD) == (WIRE_SIZE),       \
+                #PAYLOAD " wire size changed");                                       \
+  template <> struct MsgTraits<MsgType::TYPE> {                                       \
+    using Payload = PAYLOAD;                                                          \
+    static constexpr uint16_t kSize   = (WIRE_SIZE);                                  \
+    static constexpr uint16_t kMinLen = (MIN_LEN);                                    \
+    static constexpr const char* kName = #TYPE;                                       \
+  };
+
+static_assert(sizeof(MsgHeader) == 8, "MsgHeader wire size changed");
+static_assert(sizeof(TrexUid)   == 11, "TrexUid wire size changed");
+
+//       type             payload                 size  min
+TREX_MSG(HELLO,           HelloPayload,           11,   11)
+TREX_MSG(HEARTBEAT,       HeartbeatPayload,        0,    0)
+TREX_MSG(STATE_TICK,      StateTickPayload,        5,    5)
+TREX_MSG(GAME_OVER,       GameOverPayload,         2,    1)
+TREX_MSG(SCORE_UPDATE,    ScoreUpdatePayload,      4,    4)
+TREX_MSG(STATION_UPDATE,  StationUpdatePayload,    5,    5)
+TREX_MSG(GAME_START,      GameStartPayload,        0,    0)
+TREX_MSG(ROUND_STATUS,    RoundStatusPayload,     16,   16)
+TREX_MSG(MG_START,        MgStartPayload,         10,   10)
+TREX_MSG(MG_STOP,         MgStopPayload,           0,    0)
+TREX_MSG(MG_RESULT,       MgResultPayload,        13,   13)
+TREX_MSG(LOOT_HOLD_START, LootHoldStartPayload,   16,   16)
+TREX_MSG(LOOT_HOLD_ACK,   LootHoldAckPayload,     13,   13)
+TREX_MSG(LOOT_TICK,       LootTickPayload,         7,    7)
+TREX_MSG(LOOT_HOLD_STOP,  LootHoldStopPayload,     4,    4)
+TREX_MSG(HOLD_END,        HoldEndPayload,          5,    5)
+TREX_MSG(DROP_REQUEST,    DropRequestPayload,     12,   12)
+TREX_MSG(DROP_RESULT,     DropResultPayload,       7,    7)
+TREX_MSG(CONFIG_UPDATE,   ConfigUpdatePayload,   136,  136)
+TREX_MSG(OTA_STATUS,      OtaStatusPayload,       18,   18)
+TREX_MSG(OTA_OFFER,       OtaOfferPayload,        23,   23)
+TREX_MSG(OTA_CHUNK,       OtaChunkPayload,       230,    7)   // variable length
+TREX_MSG(OTA_NACK,        OtaNackPayload,         71,    7)   // variable length
+TREX_MSG(BONUS_UPDATE,    BonusUpdatePayload,      4,    4)
+TREX_MSG(CONTROL_CMD,     ControlCmdPayload,       4,    4)
+TREX_MSG(GAME_STATUS,     GameStatusPayload,      16,   16)
+TREX_MSG(LIVES_UPDATE,    LivesUpdatePayload,      4,    4)
+TREX_MSG(SERVER_CMD,      ServerCmdPayload,        4,    4)
+TREX_MSG(RADIO_CFG,       RadioCfgPayload,         6,    4)
+TREX_MSG(STATUS_KEYFRAME, StatusKeyframePayload,  23,   23)
+TREX_MSG(STATUS_DELTA,    StatusDeltaPayload,     26,    6)   // variable length
+TREX_MSG(STATUS_KEYREQ,   StatusKeyReqPayload,     2,    2)
+TREX_MSG(REL_ACK,         RelAckPayload,           7,    7)
+TREX_MSG(STATS_SNAPSHOT,  StatsSnapshotPayload,  134,  134)
+TREX_MSG(TIME_PING,       TimePingPayload,         4,    4)
+TREX_MSG(TIME_PONG,       TimePongPayload,        13,   13)
+
+namespace trex_detail {
+template <class...> using void_t = void;
+
+template <MsgType T, class = void> struct IsRegistered : std::false_type {};
+template <MsgType T> struct IsRegistered<T, void_t<typename MsgTraits<T>::Payload>> : std::true_type {};
+
+template <class H, class P, class = void> struct HasOn : std::false_type {};
+template <class H, class P>
+struct HasOn<H, P, void_t<decltype(std::declval<H&>().on(std::declval<const MsgHeader&>(),
+                                                         std::declval<const P&>()))>> : std::true_type {};
+
+template <class H, class = void> struct HasUnhandled : std::false_type {};
+template <class H>
+struct HasUnhandled<H, void_t<decltype(std::declval<H&>().onUnhandled(std::declval<const MsgHeader&>(),
+                                                                      std::declval<const uint8_t*>(),
+                                                                      std::declval<uint16_t>()))>> : std::true_type {};
+} // namespace trex_detail
+
+// Compile-time lookups usable from other templates (e.g. encoders).
+template <MsgType T> constexpr bool     msgIsRegistered() { return trex_detail::IsRegistered<T>::value; }
+template <MsgType T> constexpr uint16_t msgWireSize()     { return MsgTraits<T>::kSize; }
+template <MsgType T> constexpr uint16_t msgMinLen()       { return MsgTraits<T>::kMinLen; }
+
+namespace trex_detail {
+struct NameTable {
+  const char* n[256];
+
+  template <size_t I>
+  static constexpr const char* entry() {
+    if constexpr (IsRegistered<(MsgType)I>::value) return MsgTraits<(MsgType)I>::kName;
+    else                                           return nullptr;
+  }
+  template <size_t... I>
+  static constexpr NameTable make(std::index_sequence<I...>) { return NameTable{{entry<I>()...}}; }
+};
+constexpr NameTable kNameTable = NameTable::make(std::make_index_sequence<256>{});
+} // namespace trex_detail
+
+// "GAME_STATUS" etc. for logs and tools; nullptr for unregistered types.
+inline const char* msgTypeName(uint8_t type) { return trex_detail::kNameTable.n[type]; }
+
+enum class DispatchResult : uint8_t {
+  HANDLED   = 0,
+  UNHANDLED = 1,   // well-formed, but no typed handler (or unregistered type)
+  SHORT     = 2,   // payloadLen below the registered minimum
+  MALFORMED = 3    // truncated header / payloadLen past end of buffer
+};
+
+namespace trex_detail {
+
+template <class H>
+inline DispatchResult unhandled(H& h, const MsgHeader& hdr, const uint8_t* p) {
+  if constexpr (HasUnhandled<H>::value) h.onUnhandled(hdr, p, hdr.payloadLen);
+  return DispatchResult::UNHANDLED;
+}
+
+template <class H, MsgType T>
+inline DispatchResult typed(H& h, const MsgHeader& hdr, const uint8_t* p) {
+  using Tr = MsgTraits<T>;
+  using P  = typename Tr::Payload;
+  if constexpr (!HasOn<H, P>::value) {
+    return unhandled(h, hdr, p);
+  } else {
+    if (hdr.payloadLen < Tr::kMinLen) return DispatchResult::SHORT;
+    P payload{};
+    if constexpr (!IsEmptyPayload<P>::value) {
+      // Newer senders may append fields; older ones may send fewer (zero-filled).
+      memcpy(&payload, p, hdr.payloadLen < sizeof(P) ? hdr.payloadLen : sizeof(P));
+      msgFillLegacy(payload, hdr.payloadLen);
+    }
+    h.on(hdr, static_cast<const P&>(payload));
+    return DispatchResult::HANDLED;
+  }
+}
+
+template <class H>
+struct DispatchTable {
+  using Thunk = DispatchResult (*)(H&, const MsgHeader&, const uint8_t*);
+  Thunk t[256];
+
+  template <size_t I>
+  static constexpr Thunk entry() {
+    if constexpr (IsRegistered<(MsgType)I>::value) return &typed<H, (MsgType)I>;
+    else                                           return &unhandled<H>;
+  }
+  template <size_t... I>
+  static constexpr DispatchTable make(std::index_sequence<I...>) { return DispatchTable{{entry<I>()...}}; }
+};
+
+template <class H>
+constexpr DispatchTable<H> kDispatchTable = DispatchTable<H>::make(std::make_index_sequence<256>{});
+
+} // namespace trex_detail
+
+template <class H>
+class MsgDispatcher {
+  static_assert(!trex_detail::HasOn<H, NoPayload>::value,
+                "on(const MsgHeader&, const NoPayload&) no longer matches anything: "
+                "use HeartbeatPayload, GameStartPayload or MgStopPayload");
+
+public:
+  explicit MsgDispatcher(H& handler) : h_(handler) {}
+
+  DispatchResult dispatch(const uint8_t* data, uint16_t len) {
+    if (!data || len < sizeof(MsgHeader)) return DispatchResult::MALFORMED;
+    MsgHeader hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+    if ((uint32_t)hdr.payloadLen + sizeof(MsgHeader) > len) return DispatchResult::MALFORMED;
+    return trex_detail::kDispatchTable<H>.t[hdr.type](h_, hdr, data + sizeof(MsgHeader));
+  }
+
+private:
+  H& h_;
+};
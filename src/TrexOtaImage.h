@@ -0,0 +1,306 @@
+#pragma once
+// TrexOtaImage.h — compressed and delta firmware images for the OTA campaign.
+//
+// A TRXZ artifact (built by extras/otaimage/trex_otaimage) is a Header followed
+// by a stream of ops, each a varint token (len << 2 | op) plus its argument:
+//
+//   LITERAL len, then len bytes
+//   COPY    len, varint dist    len bytes from dist back in the decoded output
+//                               (dist <= Header.window <= kWindow)
+//   BASE    len, zigzag delta   len bytes of the running firmware, starting
+//                               delta past where the previous BASE op ended
+//   END
+//
+// A compressed image uses LITERAL/COPY only; a delta also BASE-copies the
+// firmware it was made against (Header.baseMajor/baseMinor, which the server
+// puts in ConfigUpdatePayload.expectMajor/expectMinor). Decoding is
+// incremental (feed() takes the download in any split) and needs only the
+// kWindow-byte history, which doubles as the write buffer: flash gets aligned
+// kFlushBytes blocks. At the end the CRC-32 of the output is checked, then the
+// Sink's own verify runs (MeshOta::FlashSink reads the partition back and
+// lets esp_ota_end() validate the image).
+//
+// Anything that doesn't start with the TRXZ magic is a plain image and passes
+// through unchanged (its size must be known up front), so existing full-image
+// URLs keep working.
+//
+//   uint8_t err = OtaImage::httpUpdate(cfg.otaUrl, FW_MAJOR, FW_MINOR,
+//                                      [](uint32_t got, uint32_t total) { ...OTA_STATUS... });
+//   if (!err) ESP.restart();
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "TrexMeshOta.h"
+
+namespace OtaImage {
+
+static constexpr uint8_t  kMagic[4]      = {'T', 'R', 'X', 'Z'};
+static constexpr uint8_t  kFormatVersion = 1;
+static constexpr uint16_t kWindow        = 4096;   // decoder history (power of two)
+static constexpr uint16_t kFlushBytes    = 1024;   // sink write size (divides kWindow)
+
+enum Kind : uint8_t { KIND_LZ = 1, KIND_DELTA = 2 };
+enum Op   : uint8_t { OP_LITERAL = 0, OP_COPY = 1, OP_BASE = 2, OP_END = 3 };
+
+#pragma pack(push,1)
+struct Header {
+  uint8_t  magic[4];
+  uint8_t  version;               // kFormatVersion
+  uint8_t  kind;                  // Kind
+  uint8_t  fwMajor, fwMinor;      // version of the image inside
+  uint8_t  baseMajor, baseMinor;  // KIND_DELTA: firmware it applies to
+  uint16_t window;                // largest COPY distance used
+  uint32_t outSize;               // decoded image bytes
+  uint32_t outCrc;                // CRC-32 of the decoded image
+  uint32_t baseSize;              // KIND_DELTA: base bytes it may reference
+};
+#pragma pack(pop)
+static_assert(sizeof(Header) == 24, "OtaImage::Header size changed");
+
+// Sink: MeshOta's begin / write / finish / abort. Base: read(offset, dst, n)
+// over the running firmware (MeshOta::RunningImage).
+template <class Sink, class Base>
+class Decoder {
+public:
+  enum Result : uint8_t { MORE, DONE, FAILED };
+
+  Decoder(Sink& sink, Base& base) : sink_(sink), base_(base) {}
+
+  // fwMajor/fwMinor: what we run (a delta must match it). rawSize: byte count
+  // of a plain image, 0 if unknown.
+  void begin(uint8_t fwMajor, uint8_t fwMinor, uint32_t rawSize) {
+    fwMajor_ = fwMajor;
+    fwMinor_ = fwMinor;
+    rawSize_ = rawSize;
+    st_      = ST_HEADER;
+    got_ = out_ = flushed_ = crc_ = inBytes_ = 0;
+    var_ = shift_ = 0;
+    baseEnd_ = 0;
+    error_   = MeshOta::OTA_ERR_OK;
+    open_    = false;
+  }
+
+  Result feed(const uint8_t* d, size_t n) {
+    inBytes_ += (uint32_t)n;
+    while (n && st_ < ST_DONE) {
+      switch (st_) {
+        case ST_HEADER: {
+          const size_t take = sizeof(Header) - got_ < n ? sizeof(Header) - got_ : n;
+          memcpy((uint8_t*)&hdr_ + got_, d, take);
+          got_ += (uint16_t)take; d += take; n -= take;
+          if (memcmp(hdr_.magic, kMagic, got_ < 4 ? got_ : 4) != 0) { startRaw(); break; }
+          if (got_ == sizeof(Header)) startDecoded();
+          break;
+        }
+        case ST_RAW: {
+          const size_t take = rawSize_ - out_ < n ? rawSize_ - out_ : n;
+          emit(d, take);
+          d += take; n -= take;
+          if (out_ == rawSize_) finish(crc_);
+          break;
+        }
+        case ST_LITERAL: {
+          const size_t take = len_ < n ? len_ : n;
+          emit(d, take);
+          d += take; n -= take; len_ -= (uint32_t)take;
+          if (!len_) st_ = ST_TOKEN;
+          break;
+        }
+        case ST_TOKEN:
+        case ST_ARG: {
+          const uint8_t b = *d++; --n;
+          if (shift_ > 28) { fail(MeshOta::OTA_ERR_FORMAT); break; }
+          var_ |= (uint32_t)(b & 0x7F) << shift_;
+          shift_ = (uint8_t)(shift_ + 7);
+          if (b & 0x80) break;
+          const uint32_t v = var_;
+          var_ = shift_ = 0;
+          if (st_ == ST_TOKEN) onToken(v); else onArg(v);
+          break;
+        }
+        default:
+          break;
+      }
+    }
+    return st_ == ST_DONE ? DONE : st_ == ST_FAILED ? FAILED : MORE;
+  }
+
+  // Download cut short: drop what was written.
+  void abort() {
+    if (st_ < ST_DONE) fail(error_ ? error_ : (uint8_t)MeshOta::OTA_ERR_WRITE);
+  }
+
+  uint8_t  error()    const { return error_; }       // OtaStatusPayload.error
+  uint32_t inBytes()  const { return inBytes_; }
+  uint32_t outBytes() const { return out_; }
+  uint32_t outSize()  const { return st_ == ST_RAW || !isTrxz() ? rawSize_ : hdr_.outSize; }
+  bool     isTrxz()   const { return got_ == sizeof(Header) && memcmp(hdr_.magic, kMagic, 4) == 0; }
+  const Header& header() const { return hdr_; }
+
+private:
+  enum State : uint8_t { ST_HEADER, ST_RAW, ST_TOKEN, ST_ARG, ST_LITERAL, ST_DONE, ST_FAILED };
+
+  void startRaw() {
+    if (!rawSize_) { fail(MeshOta::OTA_ERR_NOLEN); return; }
+    if (!sink_.begin(rawSize_)) { fail(MeshOta::OTA_ERR_WRITE); return; }
+    open_ = true;
+    st_   = ST_RAW;
+    const uint16_t held = got_;
+    got_ = 0;
+    emit((const uint8_t*)&hdr_, held);   // the bytes we took for a header
+    if (out_ == rawSize_) finish(crc_);
+  }
+
+  void startDecoded() {
+    const Header& h = hdr_;
+    if (h.version != kFormatVersion || (h.kind != KIND_LZ && h.kind != KIND_DELTA) || h.window > kWindow) {
+      fail(MeshOta::OTA_ERR_FORMAT);
+      return;
+    }
+    if (h.kind == KIND_DELTA && (h.baseMajor != fwMajor_ || h.baseMinor != fwMinor_)) {
+      fail(MeshOta::OTA_ERR_BASE);
+      return;
+    }
+    if (!sink_.begin(h.outSize)) { fail(MeshOta::OTA_ERR_WRITE); return; }
+    open_ = true;
+    st_   = ST_TOKEN;
+  }
+
+  void onToken(uint32_t v) {
+    op_  = (uint8_t)(v & 3);
+    len_ = v >> 2;
+    if (op_ == OP_END) {
+      if (out_ != hdr_.outSize) fail(MeshOta::OTA_ERR_FORMAT);
+      else if (crc_ != hdr_.outCrc) fail(MeshOta::OTA_ERR_VERIFY);
+      else finish(hdr_.outCrc);
+      return;
+    }
+    if (!len_ || (uint64_t)out_ + len_ > hdr_.outSize) { fail(MeshOta::OTA_ERR_FORMAT); return; }
+    st_ = op_ == OP_LITERAL ? ST_LITERAL : ST_ARG;
+  }
+
+  void onArg(uint32_t v) {
+    st_ = ST_TOKEN;
+    if (op_ == OP_COPY) {
+      if (!v || v > hdr_.window || v > out_) { fail(MeshOta::OTA_ERR_FORMAT); return; }
+      for (uint32_t i = 0; i < len_ && st_ != ST_FAILED; ++i) {
+        const uint8_t b = ring_[(out_ - v) & (kWindow - 1)];
+        emit(&b, 1);
+      }
+      return;
+    }
+    if (hdr_.kind != KIND_DELTA) { fail(MeshOta::OTA_ERR_FORMAT); return; }
+    const int64_t from = (int64_t)baseEnd_ + (int32_t)((v >> 1) ^ (0u - (v & 1)));   // zigzag
+    if (from < 0 || from + len_ > hdr_.baseSize) { fail(MeshOta::OTA_ERR_FORMAT); return; }
+    uint8_t  buf[256];
+    uint32_t off = (uint32_t)from, left = len_;
+    while (left && st_ != ST_FAILED) {
+      const uint16_t k = (uint16_t)(left < sizeof(buf) ? left : sizeof(buf));
+      if (!base_.read(off, buf, k)) { fail(MeshOta::OTA_ERR_BASE); return; }
+      emit(buf, k);
+      off += k;
+      left -= k;
+    }
+    baseEnd_ = (uint32_t)from + len_;
+  }
+
+  // Output goes through the history ring; every aligned kFlushBytes block is
+  // written out as soon as it is complete.
+  void emit(const uint8_t* p, size_t n) {
+    crc_ = MeshOta::crc32Update(crc_, p, n);
+    while (n && st_ != ST_FAILED) {
+      const uint16_t at   = (uint16_t)(out_ & (kWindow - 1));
+      const uint16_t room = (uint16_t)(kFlushBytes - (out_ % kFlushBytes));
+      const uint16_t k    = (uint16_t)(n < room ? n : room);
+      memcpy(ring_ + at, p, k);
+      out_ += k; p += k; n -= k;
+      if (out_ % kFlushBytes == 0) flush();
+    }
+  }
+
+  void flush() {
+    if (out_ == flushed_) return;
+    if (!sink_.write(flushed_, ring_ + (flushed_ & (kWindow - 1)), (uint16_t)(out_ - flushed_)))
+      fail(MeshOta::OTA_ERR_WRITE);
+    flushed_ = out_;
+  }
+
+  void finish(uint32_t crc) {
+    flush();
+    if (st_ == ST_FAILED) return;
+    open_ = false;
+    if (!sink_.finish(out_, crc)) { st_ = ST_FAILED; error_ = MeshOta::OTA_ERR_VERIFY; return; }
+    st_ = ST_DONE;
+  }
+
+  void fail(uint8_t err) {
+    if (open_) sink_.abort();
+    open_  = false;
+    error_ = err;
+    st_    = ST_FAILED;
+  }
+
+  Sink&    sink_;
+  Base&    base_;
+  Header   hdr_{};
+  uint8_t  ring_[kWindow];
+  State    st_ = ST_HEADER;
+  uint8_t  op_ = 0, shift_ = 0, error_ = 0, fwMajor_ = 0, fwMinor_ = 0;
+  bool     open_ = false;
+  uint16_t got_ = 0;
+  uint32_t var_ = 0, len_ = 0, out_ = 0, flushed_ = 0, crc_ = 0, inBytes_ = 0, rawSize_ = 0, baseEnd_ = 0;
+};
+
+} // namespace OtaImage
+
+// ---------------------------------------------------------------- ESP32 glue
+#if defined(ARDUINO_ARCH_ESP32)
+#include <functional>
+#include <HTTPClient.h>
+#include <WiFi.h>
+
+namespace OtaImage {
+
+// Downloads url (plain image or TRXZ artifact) into the next OTA partition and
+// makes it the boot partition. Returns an OtaStatusPayload.error code (0 = OK).
+// progress(bytesIn, totalIn) runs as data arrives (totalIn 0 if unknown).
+inline uint8_t httpUpdate(const char* url, uint8_t fwMajor, uint8_t fwMinor,
+                          const std::function<void(uint32_t, uint32_t)>& progress = nullptr,
+                          uint32_t idleTimeoutMs = 10000) {
+  if (WiFi.status() != WL_CONNECTED) return 1;
+  HTTPClient http;
+  if (!http.begin(url) || http.GET() != HTTP_CODE_OK) { http.end(); return 2; }
+  const int   total = http.getSize();
+  WiFiClient* s     = http.getStreamPtr();
+
+  // Static, not on the stack: the decoder carries its kWindow history, too
+  // much for the loop task. One update at a time (not re-entrant).
+  static MeshOta::FlashSink    sink;
+  static MeshOta::RunningImage base;
+  static Decoder<MeshOta::FlashSink, MeshOta::RunningImage> dec(sink, base);
+  dec.begin(fwMajor, fwMinor, total > 0 ? (uint32_t)total : 0);
+
+  uint8_t  buf[512];
+  uint32_t lastMs = millis();
+  auto     r      = decltype(dec)::MORE;
+  while (r == decltype(dec)::MORE) {
+    const int avail = s->available();
+    if (avail <= 0) {
+      if (!http.connected() || millis() - lastMs > idleTimeoutMs) break;
+      delay(1);
+      continue;
+    }
+    const int n = s->readBytes(buf, avail < (int)sizeof(buf) ? (size_t)avail : sizeof(buf));
+    if (n <= 0) continue;
+    lastMs = millis();
+    r = dec.feed(buf, (size_t)n);
+    if (progress) progress(dec.inBytes(), total > 0 ? (uint32_t)total : 0);
+  }
+  http.end();
+  if (r == decltype(dec)::DONE) return 0;
+  if (r == decltype(dec)::MORE) { dec.abort(); return 2; }   // stream ended early
+  return dec.error();
+}
+
+} // namespace OtaImage
+#endif
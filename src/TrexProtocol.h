@@ -4,9 +4,11 @@
 // --- TRex wire framing (multi-game safety) ---
 // When enabled in TransportConfig, packets are sent as:
 //   [magic0][magic1][wireVersion][MsgHeader...]
+// or, with wireVersion 2, as compact records (see TrexCompact.h).
 #define TREX_WIRE_MAGIC0   'T'
 #define TREX_WIRE_MAGIC1   'X'
 #define TREX_WIRE_VERSION  1
+#define TREX_WIRE_VERSION_COMPACT 2
 
 #define TREX_PROTO_VERSION 2
 
@@ -23,22 +25,31 @@ enum class MsgType : uint8_t {
   LOOT_HOLD_START=20, LOOT_HOLD_ACK=21, LOOT_TICK=22, LOOT_HOLD_STOP=23, HOLD_END=24,
   DROP_REQUEST=30, DROP_RESULT=31,
   CONFIG_UPDATE=40,
-  OTA_STATUS=50,
+  OTA_STATUS=50, OTA_OFFER=51, OTA_CHUNK=52, OTA_NACK=53,
   BONUS_UPDATE=60,
   CONTROL_CMD=70,
   GAME_STATUS=71,
   LIVES_UPDATE=72,
   SERVER_CMD=73,
-  RADIO_CFG=80
+  STATUS_KEYFRAME=74, STATUS_DELTA=75, STATUS_KEYREQ=76,
+  REL_ACK=77,
+  STATS_SNAPSHOT=78,
+  RADIO_CFG=80,
+  TIME_PING=81, TIME_PONG=82
 };
 
 #pragma pack(push,1)
 
+// MsgHeader.flags bits
+#define TREX_MSGF_MORE     0x01   // another MsgHeader record follows in this frame (aggregation)
+#define TREX_MSGF_RELIABLE 0x02   // reliable channel: seq is per destination, last payload
+                                  // byte is the destination stationId (see TrexReliable.h)
+
 struct MsgHeader {
   uint8_t  version;       // = TREX_PROTO_VERSION
   uint8_t  type;          // MsgType
   uint8_t  srcStationId;  // 0=T-Rex
-  uint8_t  flags;         // reserved
+  uint8_t  flags;         // TREX_MSGF_* (0 from older firmware)
   uint16_t payloadLen;    // bytes after header
   uint16_t seq;           // per-sender sequence
 };
@@ -121,13 +132,55 @@ struct OtaStatusPayload {
   uint8_t   stationType;     // StationType (e.g., LOOT)
   uint32_t  campaignId;
   uint8_t   phase;           // OtaPhase
-  uint8_t   error;           // 0=OK, 1=WiFi, 2=HTTP, 3=NoLen, 4=Write, 5=Verify
+  uint8_t   error;           // 0=OK, 1=WiFi, 2=HTTP, 3=NoLen, 4=Write, 5=Verify, 6=Timeout, 7=Base, 8=Format
   uint8_t   fwMajor;         // running version at time of send
   uint8_t   fwMinor;
   uint32_t  bytes;           // bytes downloaded so far (SUCCESS sends total)
   uint32_t  total;           // total if known else 0
 };
 
+// -------- OTA over ESP-NOW broadcast (see TrexMeshOta.h) ----------
+// The sender streams the image once in numbered chunks; receivers NACK the
+// ranges they missed after each pass and report via OTA_STATUS.
+enum class OtaOfferState : uint8_t {
+  ANNOUNCE = 0,   // chunks follow after the lead time
+  PASS_END = 1,   // a pass is over: NACK what's missing
+  FINISHED = 2    // campaign over; whoever is incomplete fails
+};
+
+struct OtaOfferPayload {
+  uint32_t campaignId;
+  uint32_t imageSize;
+  uint32_t imageCrc;      // CRC-32 (IEEE) of the whole image
+  uint16_t chunkSize;     // bytes per OTA_CHUNK (the last one may be short)
+  uint16_t chunkCount;
+  uint8_t  stationType;   // 0 = all, else StationType (as CONFIG_UPDATE)
+  uint8_t  targetId;      // 0 = all IDs of that type, else specific stationId
+  uint8_t  fwMajor;       // version the image carries; stations on it skip
+  uint8_t  fwMinor;
+  uint8_t  senderId;      // stationId streaming the image (NACKs name it)
+  uint8_t  pass;          // increments at every PASS_END
+  uint8_t  state;         // OtaOfferState
+} __attribute__((packed));
+
+#define TREX_OTA_CHUNK_BYTES 224
+
+struct OtaChunkPayload {
+  uint32_t campaignId;
+  uint16_t index;
+  uint8_t  data[TREX_OTA_CHUNK_BYTES];   // variable: payloadLen - 6 bytes are sent
+} __attribute__((packed));
+
+struct OtaRange { uint16_t first; uint16_t count; } __attribute__((packed));
+
+struct OtaNackPayload {
+  uint32_t campaignId;
+  uint8_t  senderId;      // OtaOfferPayload.senderId being asked
+  uint8_t  stationId;     // who is missing chunks
+  uint8_t  count;         // ranges used; only 7 + 4 * count bytes are sent
+  OtaRange ranges[16];
+} __attribute__((packed));
+
 struct RoundStatusPayload {
   uint8_t  roundIndex;
   uint8_t  reserved;      // keep alignment tidy
@@ -142,7 +195,8 @@ enum class ControlOp : uint8_t {
   START       = 1,
   STOP        = 2,
   ENTER_MAINT = 3,
-  LOOT_OTA    = 4
+  LOOT_OTA    = 4,
+  REPORT_STATS = 5    // targets answer with STATS_SNAPSHOT (TrexStats::sendSnapshot)
 };
 
 // New: targeted control payload
@@ -189,14 +243,95 @@ struct LivesUpdatePayload {
   uint8_t blameSid;  // station id (0xFF = ALL)
 } __attribute__((packed));
 
+// -------- status sync (keyframe + delta) --------
+// Alternative to re-broadcasting GAME_STATUS + STATE_TICK every tick: the server
+// sends a full keyframe now and then, and in between a delta against the last
+// keyframe carrying only what changed. Deltas never chain, so losing one costs
+// nothing; a station that sees a delta for a keyframe it doesn't have sends
+// STATUS_KEYREQ. See TrexStatusSync.h.
+struct StatusKeyframePayload {
+  uint16_t          keySeq;
+  GameStatusPayload status;
+  StateTickPayload  tick;
+} __attribute__((packed));
+
+// Bits in StatusDeltaPayload.changed; the matching values follow in `fields`,
+// in bit order (u32 for scores/timers, u8 otherwise, little-endian).
+enum StatusDeltaField : uint8_t {
+  SD_TEAM_SCORE    = 0x01,  // u32
+  SD_MS_LEFT_GAME  = 0x02,  // u32 (omitted when == keyframe - elapsedMs)
+  SD_MS_LEFT_ROUND = 0x04,  // u32 (same rule)
+  SD_ROUND_INDEX   = 0x08,  // u8
+  SD_PHASE         = 0x10,  // u8
+  SD_LIGHT_STATE   = 0x20,  // u8
+  SD_TICK_STATE    = 0x40,  // u8
+  SD_TICK_MS_LEFT  = 0x80,  // u32 (same rule)
+};
+
+struct StatusDeltaPayload {
+  uint16_t keySeq;       // keyframe this delta is relative to
+  uint8_t  deltaSeq;     // increments per delta (diagnostics)
+  uint16_t elapsedMs;    // time since the keyframe; timers count down by this
+  uint8_t  changed;      // StatusDeltaField bits
+  uint8_t  fields[20];   // variable: only payloadLen - 6 bytes are sent
+} __attribute__((packed));
+
+struct StatusKeyReqPayload {
+  uint16_t haveKeySeq;   // last keyframe the station holds (0xFFFF = none)
+} __attribute__((packed));
+
+// -------- reliable channel --------
+// Sent by the receiver of a TREX_MSGF_RELIABLE message (header src = receiver).
+// Cumulative + selective: everything before cumSeq arrived, and bit i of
+// sackMask means cumSeq + 1 + i arrived too.
+struct RelAckPayload {
+  uint8_t  peerId;     // stationId whose stream is acknowledged (the data sender)
+  uint16_t cumSeq;     // next seq expected in order
+  uint32_t sackMask;
+} __attribute__((packed));
+
+// -------- telemetry --------
+// Transport counters of one station (see TrexStats.h). Counts are since boot or
+// the last "stats reset"; 16-bit fields saturate.
+struct StatsTypeCount { uint8_t type; uint16_t tx; uint16_t rx; } __attribute__((packed));
+
+struct StatsSnapshotPayload {
+  uint8_t  stationId;
+  uint8_t  version;         // = 1
+  uint32_t uptimeMs;
+  uint32_t txFrames, rxFrames, txBytes, rxBytes;
+  uint32_t txAcked;         // unicasts confirmed by the MAC layer
+  uint32_t rxForeign;       // non-TREX frames heard
+  uint32_t rxOverflow;      // RX queue overflows
+  uint32_t handlerMaxUs;
+  uint16_t txErr[8];        // TrexStats::TxErr
+  uint16_t rxDrop[8];       // TrexStats::RxDrop
+  uint16_t handlerHist[12]; // RxHandler time, bucket i = [2^i, 2^(i+1)) us
+  StatsTypeCount top[8];    // busiest MsgTypes, type 0 = unused
+} __attribute__((packed));
+
+// -------- clock sync (see TrexClockSync.h) --------
+// Times are the sender's TransportCommon::nowMs(). Consumed by the transport.
+struct TimePingPayload { uint32_t t1; } __attribute__((packed));   // station send time
+
+struct TimePongPayload {
+  uint8_t  dstStationId;  // pongs may go out as broadcast
+  uint32_t t1;            // echoed from the ping
+  uint32_t t2;            // server receive time
+  uint32_t t3;            // server send time
+} __attribute__((packed));
+
 // -------- radio config / facility management --------
 // Server broadcasts RADIO_CFG to move the whole TRex game onto a new channel,
-// and/or enable/disable wire framing.
+// and/or change wire framing / encoding. With switchInMs != 0 the change is armed
+// and every node applies it in place when the countdown ends, so the fleet
+// flips together (Transport::announceRadioCfg repeats it until then).
 struct RadioCfgPayload {
   uint8_t wifiChannel;   // 1..13
   uint8_t txFramed;      // 0 = legacy (no wire header), 1 = framed (magic header)
   uint8_t rxLegacy;      // 0 = drop legacy packets, 1 = accept legacy packets
-  uint8_t _pad;
+  uint8_t wireVersion;   // TX encoding when framed; 0 = keep (older servers)
+  uint16_t switchInMs;   // 0 = now (and from older servers, which send 4 bytes)
 } __attribute__((packed));
 
 // -------- minigame --------
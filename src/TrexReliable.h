@@ -0,0 +1,260 @@
+#pragma once
+// TrexReliable.h — opt-in reliable delivery for transactional messages
+// (LOOT_HOLD_ACK, DROP_RESULT, CONTROL_CMD, ...). Fire-and-forget traffic
+// keeps using broadcast()/sendToServer() untouched.
+//
+// Wire format: the message is sent with TREX_MSGF_RELIABLE set, MsgHeader.seq
+// taken from a per-destination stream, and one extra payload byte (counted in
+// payloadLen) holding the destination stationId. The receiver strips that byte
+// and the flag before the RxHandler sees the message, drops duplicates, and
+// answers with REL_ACK (cumulative seq + 32-bit selective mask).
+//
+// The sender keeps up to TREX_REL_WINDOW messages in flight, retransmits on an
+// adaptive RTO (RFC 6298 SRTT/RTTVAR per peer, Karn's rule, exponential
+// backoff) and fast-retransmits a hole as soon as a SACK shows later data got
+// through. Streams start at a random seq so a rebooted sender isn't mistaken
+// for duplicates. A seq the sender gave up on would hold the cumulative ack
+// back for good, so the receiver steps over a hole once it has been open
+// longer than the sender can possibly keep retrying (kHoleMs).
+//
+// This class is transport-agnostic (clock and output are passed in); the
+// Transport-level glue lives in TrexTransportCommon.cpp.
+#include <stdint.h>
+#include <string.h>
+#include "TrexBuildConfig.h"
+#include "TrexProtocol.h"
+#include "TrexAggregate.h"   // trexIsSingleRecord
+
+class TrexReliableChannel {
+public:
+  using SendFn = bool (*)(void* ctx, uint8_t dst, const uint8_t* msg, uint16_t len);
+
+  static constexpr uint16_t kMaxMsg    = 250 - 3 - 1;   // frame - wire header - dst byte
+  static constexpr uint16_t kInitRtoMs = 100;
+  static constexpr uint16_t kMinRtoMs  = 15;
+  static constexpr uint16_t kMaxRtoMs  = 2000;
+  static constexpr int16_t  kResync    = 128;           // seq jump treated as a new stream
+  static constexpr uint32_t kHoleMs    = (uint32_t)TREX_REL_MAX_TRIES * kMaxRtoMs;   // sender's longest retry span
+
+  enum class Rx : uint8_t {
+    PASS,      // not a reliable-channel message: deliver as received
+    DELIVER,   // new reliable message: deliver `out` (trailer stripped)
+    DROP       // duplicate, not addressed to us, or a REL_ACK (consumed)
+  };
+
+  struct Stats {
+    uint32_t sent, retransmits, fastRetransmits, giveUps, windowFull;
+    uint32_t acksSent, acksRx, delivered, duplicates;
+    uint32_t holesSkipped;   // seqs never received, stepped over after kHoleMs
+  };
+
+  void begin(uint8_t myStationId, uint32_t seed, SendFn send, void* ctx) {
+    myId_ = myStationId;
+    send_ = send;
+    ctx_  = ctx;
+    memset(win_,  0, sizeof(win_));
+    memset(rx_,   0, sizeof(rx_));
+    memset(rtt_,  0, sizeof(rtt_));
+    memset(&stats_, 0, sizeof(stats_));
+    for (int i = 0; i < 256; ++i) {
+      seed = seed * 1664525u + 1013904223u;   // LCG: distinct random start per stream
+      txSeq_[i] = (uint16_t)(seed >> 16);
+    }
+  }
+
+  uint8_t myId() const { return myId_; }
+  const Stats& stats() const { return stats_; }
+  uint8_t inFlight() const {
+    uint8_t n = 0;
+    for (const auto& e : win_) n += e.used;
+    return n;
+  }
+
+  // Queues msg (one MsgHeader record) for reliable delivery to dst and sends it.
+  // False if the window is full or the message is malformed / too large.
+  bool send(uint8_t dst, const uint8_t* msg, uint16_t len, uint32_t nowMs) {
+    if (!trexIsSingleRecord(msg, len) || len > kMaxMsg) return false;
+    Entry* e = nullptr;
+    for (auto& w : win_) if (!w.used) { e = &w; break; }
+    if (!e) { ++stats_.windowFull; return false; }
+
+    MsgHeader h;
+    memcpy(&h, msg, sizeof(h));
+    h.flags      |= TREX_MSGF_RELIABLE;
+    h.flags      &= (uint8_t)~TREX_MSGF_MORE;
+    h.payloadLen  = (uint16_t)(h.payloadLen + 1);
+    h.seq         = txSeq_[dst]++;
+    memcpy(e->buf, &h, sizeof(h));
+    memcpy(e->buf + sizeof(h), msg + sizeof(h), len - sizeof(h));
+    e->buf[len]   = dst;
+    e->len        = (uint16_t)(len + 1);
+    e->dst        = dst;
+    e->seq        = h.seq;
+    e->tries      = 1;
+    e->fastRetx   = false;
+    e->rtoMs      = rtoFor(dst);
+    e->sentMs     = nowMs;
+    e->used       = true;
+    ++stats_.sent;
+    transmit(*e);
+    return true;
+  }
+
+  // Retransmits whatever timed out. Call from the transport loop.
+  void poll(uint32_t nowMs) {
+    for (auto& e : win_) {
+      if (!e.used || (uint32_t)(nowMs - e.sentMs) < e.rtoMs) continue;
+      if (e.tries >= TREX_REL_MAX_TRIES) { e.used = false; ++stats_.giveUps; continue; }
+      ++e.tries;
+      ++stats_.retransmits;
+      e.rtoMs  = (uint16_t)((e.rtoMs * 2u > kMaxRtoMs) ? kMaxRtoMs : e.rtoMs * 2u);
+      e.sentMs = nowMs;
+      transmit(e);
+    }
+  }
+
+  // Receive filter for one message. For DELIVER, out (>= len bytes) holds the
+  // message as the sender built it and outLen its length.
+  Rx onRx(const uint8_t* msg, uint16_t len, uint32_t nowMs, uint8_t* out, uint16_t& outLen) {
+    if (!msg || len < sizeof(MsgHeader)) return Rx::PASS;
+    MsgHeader h;
+    memcpy(&h, msg, sizeof(h));
+    const uint32_t recLen = sizeof(MsgHeader) + (uint32_t)h.payloadLen;
+    if (recLen > len) return Rx::PASS;
+
+    if (h.type == (uint8_t)MsgType::REL_ACK) {
+      if (h.payloadLen >= sizeof(RelAckPayload)) {
+        RelAckPayload a;
+        memcpy(&a, msg + sizeof(h), sizeof(a));
+        if (a.peerId == myId_) onAck(h.srcStationId, a, nowMs);
+      }
+      return Rx::DROP;
+    }
+    if (!(h.flags & TREX_MSGF_RELIABLE)) return Rx::PASS;
+    if (h.payloadLen < 1 || msg[recLen - 1] != myId_) return Rx::DROP;
+
+    const bool fresh = accept(rx_[h.srcStationId], h.seq, nowMs);
+    sendAck(h.srcStationId);
+    if (!fresh) { ++stats_.duplicates; return Rx::DROP; }
+
+    h.flags      &= (uint8_t)~TREX_MSGF_RELIABLE;
+    h.payloadLen  = (uint16_t)(h.payloadLen - 1);
+    memcpy(out, &h, sizeof(h));
+    memcpy(out + sizeof(h), msg + sizeof(h), h.payloadLen);
+    outLen = (uint16_t)(sizeof(h) + h.payloadLen);
+    ++stats_.delivered;
+    return Rx::DELIVER;
+  }
+
+private:
+  struct Entry {
+    uint8_t  buf[kMaxMsg + 1];
+    uint16_t len;
+    uint16_t seq;
+    uint16_t rtoMs;
+    uint32_t sentMs;
+    uint8_t  dst;
+    uint8_t  tries;
+    bool     fastRetx;
+    bool     used;
+  };
+  // mask bit i => cum+1+i seen; while mask != 0, seq cum is a hole open since holeMs.
+  struct RxWindow { uint16_t cum; uint32_t mask; uint32_t holeMs; bool synced; };
+  struct Rtt      { uint16_t srtt, rttvar; };                     // ms; srtt 0 = no sample yet
+
+  // Moves cum past seq cum (received or given up) and anything held beyond it.
+  static void advance(RxWindow& w, uint32_t nowMs) {
+    ++w.cum;
+    while (w.mask & 1u) { w.mask >>= 1; ++w.cum; }
+    w.mask >>= 1;
+    w.holeMs = nowMs;   // the next hole, if any, is timed from here
+  }
+
+  bool accept(RxWindow& w, uint16_t seq, uint32_t nowMs) {
+    if (w.synced && w.mask && (uint32_t)(nowMs - w.holeMs) >= kHoleMs) {
+      advance(w, nowMs);   // the sender has given up on it by now
+      ++stats_.holesSkipped;
+    }
+    const int16_t d = (int16_t)(uint16_t)(seq - w.cum);
+    if (!w.synced || d > 32 || d < -kResync) {   // first contact, or sender restarted
+      w.synced = true;
+      w.cum    = (uint16_t)(seq + 1);
+      w.mask   = 0;
+      return true;
+    }
+    if (d < 0) return false;
+    if (d > 0) {
+      const uint32_t bit = 1u << (d - 1);
+      if (w.mask & bit) return false;
+      if (!w.mask) w.holeMs = nowMs;
+      w.mask |= bit;
+      return true;
+    }
+    advance(w, nowMs);   // in order
+    return true;
+  }
+
+  void sendAck(uint8_t peer) {
+    uint8_t m[sizeof(MsgHeader) + sizeof(RelAckPayload)];
+    MsgHeader h{TREX_PROTO_VERSION, (uint8_t)MsgType::REL_ACK, myId_, 0, sizeof(RelAckPayload), 0};
+    RelAckPayload a{peer, rx_[peer].cum, rx_[peer].mask};
+    memcpy(m, &h, sizeof(h));
+    memcpy(m + sizeof(h), &a, sizeof(a));
+    ++stats_.acksSent;
+    if (send_) send_(ctx_, peer, m, sizeof(m));
+  }
+
+  void onAck(uint8_t from, const RelAckPayload& a, uint32_t nowMs) {
+    ++stats_.acksRx;
+    for (auto& e : win_) {
+      if (!e.used || e.dst != from) continue;
+      const int16_t d = (int16_t)(uint16_t)(e.seq - a.cumSeq);
+      const bool acked = d < 0 || (d >= 1 && d <= 32 && ((a.sackMask >> (d - 1)) & 1u));
+      if (acked) {
+        if (e.tries == 1) sampleRtt(from, nowMs - e.sentMs);   // Karn: never from a retransmit
+        e.used = false;
+      } else if (!e.fastRetx && d >= 0 && d < 32 && (a.sackMask >> d)) {
+        // Later data made it but this didn't: it was lost, don't wait for the RTO.
+        e.fastRetx = true;
+        ++e.tries;
+        ++stats_.fastRetransmits;
+        e.sentMs = nowMs;
+        transmit(e);
+      }
+    }
+  }
+
+  void sampleRtt(uint8_t peer, uint32_t sampleMs) {
+    Rtt& r = rtt_[peer];
+    const uint16_t s = (uint16_t)(sampleMs > 0xFFFF ? 0xFFFF : (sampleMs ? sampleMs : 1));
+    if (!r.srtt) {
+      r.srtt   = s;
+      r.rttvar = (uint16_t)(s / 2);
+      return;
+    }
+    const uint16_t err = (uint16_t)(s > r.srtt ? s - r.srtt : r.srtt - s);
+    r.rttvar = (uint16_t)((3u * r.rttvar + err) / 4u);
+    r.srtt   = (uint16_t)((7u * r.srtt + s) / 8u);
+  }
+
+  uint16_t rtoFor(uint8_t peer) const {
+    const Rtt& r = rtt_[peer];
+    if (!r.srtt) return kInitRtoMs;
+    uint32_t rto = r.srtt + (4u * r.rttvar > 4u ? 4u * r.rttvar : 4u);
+    if (rto < kMinRtoMs) rto = kMinRtoMs;
+    if (rto > kMaxRtoMs) rto = kMaxRtoMs;
+    return (uint16_t)rto;
+  }
+
+  void transmit(const Entry& e) { if (send_) send_(ctx_, e.dst, e.buf, e.len); }
+
+  Entry    win_[TREX_REL_WINDOW];
+  RxWindow rx_[256];
+  Rtt      rtt_[256];
+  uint16_t txSeq_[256];
+  Stats    stats_{};
+  SendFn   send_ = nullptr;
+  void*    ctx_  = nullptr;
+  uint8_t  myId_ = 0;
+};
+
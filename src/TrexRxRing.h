@@ -0,0 +1,59 @@
+#pragma once
+// TrexRxRing.h — fixed-capacity, allocation-free SPSC ring of received frames.
+// Producer: the radio callback (Wi-Fi task). Consumer: Transport::loop().
+// push() never blocks; when full the frame is dropped and counted.
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+template <uint16_t Depth, uint16_t SlotBytes>
+class TrexRxRing {
+  static_assert(Depth >= 2 && (Depth & (Depth - 1)) == 0, "Depth must be a power of two");
+
+public:
+  struct Slot {
+    uint16_t len;
+    uint8_t  mac[6];        // sender MAC, zero if unknown
+    uint8_t  data[SlotBytes];
+  };
+
+  // Producer side. Frames longer than SlotBytes are dropped as truncated.
+  bool push(const uint8_t* data, uint16_t len, const uint8_t* mac) {
+    if (len > SlotBytes) { truncated_.fetch_add(1, std::memory_order_relaxed); return false; }
+    const uint16_t head = head_.load(std::memory_order_relaxed);
+    const uint16_t tail = tail_.load(std::memory_order_acquire);
+    if ((uint16_t)(head - tail) >= Depth) {
+      overflows_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    Slot& s = slots_[head & (Depth - 1)];
+    s.len = len;
+    if (mac) memcpy(s.mac, mac, 6); else memset(s.mac, 0, 6);
+    memcpy(s.data, data, len);
+    head_.store((uint16_t)(head + 1), std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: peek the oldest frame (nullptr if empty), then pop() it.
+  const Slot* peek() const {
+    const uint16_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) return nullptr;
+    return &slots_[tail & (Depth - 1)];
+  }
+  void pop() {
+    tail_.store((uint16_t)(tail_.load(std::memory_order_relaxed) + 1), std::memory_order_release);
+  }
+
+  uint16_t size() const {
+    return (uint16_t)(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+  }
+  uint32_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+  uint32_t truncated() const { return truncated_.load(std::memory_order_relaxed); }
+
+private:
+  Slot slots_[Depth];
+  std::atomic<uint16_t> head_{0};
+  std::atomic<uint16_t> tail_{0};
+  std::atomic<uint32_t> overflows_{0};
+  std::atomic<uint32_t> truncated_{0};
+};
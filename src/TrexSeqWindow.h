@@ -0,0 +1,76 @@
+#pragma once
+// TrexSeqWindow.h — per-sender anti-replay window over MsgHeader.seq.
+//
+// One 32-bit sliding bitmap per srcStationId (IPsec-style): a frame is accepted
+// if its seq is ahead of the highest seen, or inside the window and not yet
+// marked. Duplicates (retransmits, the same frame via UDP and ESP-NOW, echoes)
+// and frames that fell out of the back of the window are rejected before
+// dispatch. O(1) per frame, fixed memory (256 senders x 16 bytes).
+//
+// A sender that reboots restarts its seq; a jump backwards by more than
+// kRestartGap, or silence longer than idleResetMs, resyncs that sender's window
+// instead of rejecting everything it sends.
+//
+// Forward jumps are counted as lost frames (gaps), which gives a cheap
+// per-sender loss estimate.
+#include <stdint.h>
+#include <string.h>
+
+class TrexSeqWindow {
+public:
+  static constexpr int16_t kWindow     = 32;
+  static constexpr int16_t kRestartGap = 1024;
+
+  enum class Verdict : uint8_t { FRESH, DUPLICATE, STALE };
+
+  struct Sender {
+    uint32_t seen;       // bit i => seq (top - i) seen
+    uint32_t lastMs;
+    uint16_t top;        // highest seq seen
+    uint16_t lost;       // seq numbers skipped (saturating)
+    uint16_t dups;       // duplicates + stale rejected (saturating)
+    uint16_t _pad;
+  };
+
+  explicit TrexSeqWindow(uint32_t idleResetMs = 30000) : idleResetMs_(idleResetMs) { reset(); }
+
+  void reset() { memset(s_, 0, sizeof(s_)); memset(known_, 0, sizeof(known_)); }
+
+  Verdict check(uint8_t src, uint16_t seq, uint32_t nowMs) {
+    Sender& s = s_[src];
+    const bool known = known_[src >> 5] & (1u << (src & 31));
+    const int16_t d  = (int16_t)(uint16_t)(seq - s.top);
+    if (!known || d < -kRestartGap || (uint32_t)(nowMs - s.lastMs) > idleResetMs_) {
+      known_[src >> 5] |= (1u << (src & 31));
+      s.top    = seq;
+      s.seen   = 1;
+      s.lastMs = nowMs;
+      return Verdict::FRESH;
+    }
+    s.lastMs = nowMs;
+    if (d > 0) {
+      if (d > 1) bump(s.lost, (uint16_t)(d - 1));
+      s.seen = (d >= kWindow) ? 1 : ((s.seen << d) | 1);
+      s.top  = seq;
+      return Verdict::FRESH;
+    }
+    const int16_t back = (int16_t)-d;
+    if (back >= kWindow) { bump(s.dups, 1); return Verdict::STALE; }
+    const uint32_t bit = 1u << back;
+    if (s.seen & bit) { bump(s.dups, 1); return Verdict::DUPLICATE; }
+    s.seen |= bit;
+    // A late arrival filled a slot we had counted as lost.
+    if (s.lost) --s.lost;
+    return Verdict::FRESH;
+  }
+
+  const Sender& sender(uint8_t src) const { return s_[src]; }
+  bool known(uint8_t src) const { return known_[src >> 5] & (1u << (src & 31)); }
+
+private:
+  static void bump(uint16_t& c, uint16_t by) { c = (uint16_t)((uint32_t)c + by > 0xFFFF ? 0xFFFF : c + by); }
+
+  Sender   s_[256];
+  uint32_t known_[8];
+  uint32_t idleResetMs_;
+};
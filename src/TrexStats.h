@@ -0,0 +1,206 @@
+#pragma once
+// TrexStats.h — transport telemetry: one static block of relaxed atomic
+// counters, safe to bump from the Wi-Fi task and the app task alike.
+//
+//   - tx/rx messages per MsgType, frames and bytes
+//   - send failures by ESP-NOW error code, unacked unicasts from the send cb
+//   - rx rejects: unframed (legacy off), empty, truncated, queue full,
+//     duplicate/stale, foreign (non-TREX) frames
+//   - RxHandler run-time histogram (power-of-two µs buckets)
+//
+// Read it via the maintenance console ("stats", "stats reset"), writeReport(),
+// or as a STATS_SNAPSHOT message (buildSnapshot()).
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include "TrexProtocol.h"
+#include "TrexTransport.h"
+
+namespace TrexStats {
+
+constexpr uint8_t kTypes       = 128;   // MsgType values all fit below this
+constexpr uint8_t kHistBuckets = 12;    // <2us, <4us, ... <4ms, >=4ms
+
+enum TxErr : uint8_t {
+  TXERR_NO_MEM = 0,    // driver queue full (ESP_ERR_ESPNOW_NO_MEM)
+  TXERR_NOT_FOUND,     // peer not registered
+  TXERR_ARG,
+  TXERR_IF,            // wrong interface / channel
+  TXERR_NOT_INIT,
+  TXERR_OTHER,
+  TXERR_NO_ACK,        // unicast sent but not acknowledged (send callback)
+  TXERR_OVERSIZE,      // refused before reaching the driver
+  TXERR_COUNT
+};
+
+enum RxDrop : uint8_t {
+  RXDROP_LEGACY = 0,   // unframed while rxAcceptLegacy == false
+  RXDROP_EMPTY,        // wire header with nothing after it
+  RXDROP_TRUNCATED,    // payloadLen past the end of the frame / buffer too small
+  RXDROP_QUEUE_FULL,   // RX ring overflow
+  RXDROP_DUPLICATE,    // seq window or reliable-channel duplicate
+  RXDROP_OVERSIZE,     // datagram larger than the receive buffer (UDP / host)
+  RXDROP_COUNT
+};
+
+using Counter = std::atomic<uint32_t>;
+
+struct Block {
+  Counter txFrames{0}, txBytes{0}, rxFrames{0}, rxBytes{0};
+  Counter txAcked{0};                 // unicasts the send callback confirmed
+  Counter rxForeign{0};               // frames that aren't TREX at all
+  Counter txQueued{0};                // frames that waited in the TX scheduler
+  Counter txQueueDrops{0};            // refused: their priority class was full
+  Counter txByType[kTypes];
+  Counter rxByType[kTypes];
+  Counter txErr[TXERR_COUNT];
+  Counter rxDrop[RXDROP_COUNT];
+  Counter handlerHist[kHistBuckets];
+  Counter handlerMaxUs{0};
+};
+
+inline Block& get() {                 // single instance across the program
+  static Block b;
+  return b;
+}
+
+inline void bump(Counter& c, uint32_t by = 1) { c.fetch_add(by, std::memory_order_relaxed); }
+inline uint32_t read(const Counter& c)       { return c.load(std::memory_order_relaxed); }
+
+inline uint8_t typeIndex(const uint8_t* msg, uint16_t len) {
+  return (len >= 2 && msg[1] < kTypes) ? msg[1] : 0;   // slot 0 = unknown / out of range
+}
+
+inline void noteTxMsg(const uint8_t* msg, uint16_t len) { bump(get().txByType[typeIndex(msg, len)]); }
+inline void noteRxMsg(const uint8_t* msg, uint16_t len) { bump(get().rxByType[typeIndex(msg, len)]); }
+inline void noteTxFrame(uint16_t len) { bump(get().txFrames); bump(get().txBytes, len); }
+inline void noteRxFrame(uint16_t len) { bump(get().rxFrames); bump(get().rxBytes, len); }
+inline void noteTxErr(TxErr e)        { bump(get().txErr[e]); }
+inline void noteRxDrop(RxDrop d)      { bump(get().rxDrop[d]); }
+
+inline void noteHandlerUs(uint32_t us) {
+  uint8_t b = 0;
+  while (b < kHistBuckets - 1 && us >= (2u << b)) ++b;
+  Block& s = get();
+  bump(s.handlerHist[b]);
+  uint32_t prev = read(s.handlerMaxUs);
+  while (us > prev && !s.handlerMaxUs.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+}
+
+inline void reset() {
+  Block& s = get();
+  auto z = [](Counter& c) { c.store(0, std::memory_order_relaxed); };
+  z(s.txFrames); z(s.txBytes); z(s.rxFrames); z(s.rxBytes); z(s.txAcked); z(s.rxForeign);
+  z(s.txQueued); z(s.txQueueDrops);
+  for (auto& c : s.txByType)    z(c);
+  for (auto& c : s.rxByType)    z(c);
+  for (auto& c : s.txErr)       z(c);
+  for (auto& c : s.rxDrop)      z(c);
+  for (auto& c : s.handlerHist) z(c);
+  z(s.handlerMaxUs);
+}
+
+inline const char* txErrName(uint8_t e) {
+  static const char* const n[TXERR_COUNT] = {"no_mem", "not_found", "arg", "if", "not_init", "other", "no_ack", "oversize"};
+  return e < TXERR_COUNT ? n[e] : "?";
+}
+inline const char* rxDropName(uint8_t d) {
+  static const char* const n[RXDROP_COUNT] = {"legacy", "empty", "truncated", "queue_full", "duplicate", "oversize"};
+  return d < RXDROP_COUNT ? n[d] : "?";
+}
+
+// Appends to a report line, keeping n <= cap - 3 so the "\r\n" always fits;
+// a field that doesn't fit is cut, never written past the buffer.
+inline void appendf(char* line, size_t cap, size_t& n, const char* fmt, ...) __attribute__((format(printf, 4, 5)));
+inline void appendf(char* line, size_t cap, size_t& n, const char* fmt, ...) {
+  if (n + 3 >= cap) return;
+  va_list ap;
+  va_start(ap, fmt);
+  const int k = vsnprintf(line + n, cap - 2 - n, fmt, ap);
+  va_end(ap);
+  if (k > 0) n += (size_t)k < cap - 3 - n ? (size_t)k : cap - 3 - n;
+}
+
+// Human-readable report, one line per emit() call ("\r\n"-terminated).
+template <class Emit>
+inline void writeReport(Emit emit) {
+  const Block& s = get();
+  char   line[192];
+  size_t n = 0;
+  auto end = [&]() { memcpy(line + n, "\r\n", 3); emit(line); n = 0; };
+  appendf(line, sizeof(line), n, "tx frames=%u bytes=%u acked=%u | rx frames=%u bytes=%u foreign=%u",
+          (unsigned)read(s.txFrames), (unsigned)read(s.txBytes), (unsigned)read(s.txAcked),
+          (unsigned)read(s.rxFrames), (unsigned)read(s.rxBytes), (unsigned)read(s.rxForeign));
+  end();
+  appendf(line, sizeof(line), n, "tx queue: waited=%u dropped=%u",
+          (unsigned)read(s.txQueued), (unsigned)read(s.txQueueDrops));
+  end();
+  appendf(line, sizeof(line), n, "tx errors:");
+  for (uint8_t i = 0; i < TXERR_COUNT; ++i)
+    appendf(line, sizeof(line), n, " %s=%u", txErrName(i), (unsigned)read(s.txErr[i]));
+  end();
+  appendf(line, sizeof(line), n, "rx drops:");
+  for (uint8_t i = 0; i < RXDROP_COUNT; ++i)
+    appendf(line, sizeof(line), n, " %s=%u", rxDropName(i), (unsigned)read(s.rxDrop[i]));
+  end();
+  emit("type   tx       rx\r\n");
+  for (uint8_t t = 0; t < kTypes; ++t) {
+    const uint32_t tx = read(s.txByType[t]), rx = read(s.rxByType[t]);
+    if (!tx && !rx) continue;
+    appendf(line, sizeof(line), n, "%-6u %-8u %u", (unsigned)t, (unsigned)tx, (unsigned)rx);
+    end();
+  }
+  appendf(line, sizeof(line), n, "handler us (<2,<4,..):");
+  for (uint8_t i = 0; i < kHistBuckets; ++i)
+    appendf(line, sizeof(line), n, " %u", (unsigned)read(s.handlerHist[i]));
+  appendf(line, sizeof(line), n, " max=%u", (unsigned)read(s.handlerMaxUs));
+  end();
+}
+
+inline uint16_t sat16(uint32_t v) { return v > 0xFFFF ? 0xFFFF : (uint16_t)v; }
+
+// Compact binary snapshot for STATS_SNAPSHOT (top message types by traffic).
+inline void buildSnapshot(StatsSnapshotPayload& p, uint8_t stationId, uint32_t uptimeMs, uint32_t rxOverflow) {
+  const Block& s = get();
+  memset(&p, 0, sizeof(p));
+  p.stationId    = stationId;
+  p.version      = 1;
+  p.uptimeMs     = uptimeMs;
+  p.txFrames     = read(s.txFrames);
+  p.rxFrames     = read(s.rxFrames);
+  p.txBytes      = read(s.txBytes);
+  p.rxBytes      = read(s.rxBytes);
+  p.txAcked      = read(s.txAcked);
+  p.rxForeign    = read(s.rxForeign);
+  p.rxOverflow   = rxOverflow;
+  p.handlerMaxUs = read(s.handlerMaxUs);
+  for (uint8_t i = 0; i < TXERR_COUNT && i < 8; ++i)   p.txErr[i]  = sat16(read(s.txErr[i]));
+  for (uint8_t i = 0; i < RXDROP_COUNT && i < 8; ++i)  p.rxDrop[i] = sat16(read(s.rxDrop[i]));
+  for (uint8_t i = 0; i < kHistBuckets; ++i)           p.handlerHist[i] = sat16(read(s.handlerHist[i]));
+  // Top-N by tx+rx (N is tiny; selection sort is fine).
+  for (uint8_t slot = 0; slot < 8; ++slot) {
+    uint8_t best = 0; uint32_t bestN = 0;
+    for (uint8_t t = 1; t < kTypes; ++t) {
+      bool taken = false;
+      for (uint8_t k = 0; k < slot; ++k) taken |= (p.top[k].type == t);
+      const uint32_t n = read(s.txByType[t]) + read(s.rxByType[t]);
+      if (!taken && n > bestN) { best = t; bestN = n; }
+    }
+    if (!bestN) break;
+    p.top[slot].type = best;
+    p.top[slot].tx   = sat16(read(s.txByType[best]));
+    p.top[slot].rx   = sat16(read(s.rxByType[best]));
+  }
+}
+
+// Sends this station's snapshot to the server (e.g. on ControlOp::REPORT_STATS).
+inline bool sendSnapshot(uint8_t stationId, uint32_t uptimeMs) {
+  TxFrame f;
+  auto* p = f.begin<StatsSnapshotPayload>(MsgType::STATS_SNAPSHOT, stationId);
+  buildSnapshot(*p, stationId, uptimeMs, Transport::rxOverflowCount());
+  return Transport::sendToServer(f);
+}
+
+} // namespace TrexStats
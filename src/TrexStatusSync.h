@@ -0,0 +1,200 @@
+#pragma once
+// TrexStatusSync.h — keyframe + delta encoding of GAME_STATUS / STATE_TICK.
+//
+// Server:
+//   static StatusSync::Encoder enc;             // keyframe every 20 ticks by default
+//   static TxFrame f;
+//   if (enc.build(f, status, tick, millis())) Transport::broadcast(f);
+//   ... on STATUS_KEYREQ:  enc.requestKeyframe();
+//
+// Station (e.g. from a MsgDispatcher handler):
+//   StatusSync::Decoder dec;
+//   on(hdr, const StatusKeyframePayload& k)  -> dec.onKeyframe(k)
+//   on(hdr, const StatusDeltaPayload& d)     -> dec.onDelta(d, hdr.payloadLen)
+//   if (dec.wantKeyframe(millis()) && dec.buildKeyRequest(f, myId)) Transport::sendToServer(f);
+//   dec.status() / dec.tick() hold the reconstructed state.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "TrexProtocol.h"
+#include "TrexTransport.h"
+
+namespace StatusSync {
+
+// Timers in a delta count down from the keyframe by elapsedMs (floored at 0).
+inline uint32_t predictTimer(uint32_t atKeyframe, uint16_t elapsedMs) {
+  return atKeyframe > elapsedMs ? atKeyframe - elapsedMs : 0;
+}
+
+class Encoder {
+public:
+  explicit Encoder(uint16_t keyframeEvery = 20) : every_(keyframeEvery ? keyframeEvery : 1) {}
+
+  // Next message goes out as a keyframe (STATUS_KEYREQ, new round, ...).
+  void requestKeyframe() { forceKey_ = true; }
+
+  // Builds a keyframe or a delta into frame. False only if frame is unusable.
+  bool build(TxFrame& frame, const GameStatusPayload& st, const StateTickPayload& tk,
+             uint32_t nowMs, uint8_t srcStationId = 0) {
+    const uint32_t elapsed = nowMs - keyMs_;
+    if (forceKey_ || !haveKey_ || sinceKey_ >= every_ || elapsed > 0xFFFF) {
+      auto* k = frame.begin<StatusKeyframePayload>(MsgType::STATUS_KEYFRAME, srcStationId);
+      if (!k) return false;
+      key_.keySeq = ++keySeq_;
+      key_.status = st;
+      key_.tick   = tk;
+      *k = key_;
+      keyMs_    = nowMs;
+      sinceKey_ = 0;
+      deltaSeq_ = 0;
+      haveKey_  = true;
+      forceKey_ = false;
+      return true;
+    }
+
+    StatusDeltaPayload d{};
+    d.keySeq    = key_.keySeq;
+    d.deltaSeq  = ++deltaSeq_;
+    d.elapsedMs = (uint16_t)elapsed;
+    uint8_t* w  = d.fields;
+    auto put32 = [&](uint8_t bit, uint32_t v, uint32_t ref) { if (v != ref) { d.changed |= bit; memcpy(w, &v, 4); w += 4; } };
+    auto put8  = [&](uint8_t bit, uint8_t v,  uint8_t ref)  { if (v != ref) { d.changed |= bit; *w++ = v; } };
+    const GameStatusPayload& ks = key_.status;
+    put32(SD_TEAM_SCORE,    st.teamScore,   ks.teamScore);
+    put32(SD_MS_LEFT_GAME,  st.msLeftGame,  predictTimer(ks.msLeftGame,  d.elapsedMs));
+    put32(SD_MS_LEFT_ROUND, st.msLeftRound, predictTimer(ks.msLeftRound, d.elapsedMs));
+    put8 (SD_ROUND_INDEX,   st.roundIndex,  ks.roundIndex);
+    put8 (SD_PHASE,         st.phase,       ks.phase);
+    put8 (SD_LIGHT_STATE,   st.lightState,  ks.lightState);
+    put8 (SD_TICK_STATE,    tk.state,       key_.tick.state);
+    put32(SD_TICK_MS_LEFT,  tk.msLeft,      predictTimer(key_.tick.msLeft, d.elapsedMs));
+
+    const uint16_t len = (uint16_t)(offsetof(StatusDeltaPayload, fields) + (w - d.fields));
+    uint8_t* out = frame.begin(MsgType::STATUS_DELTA, srcStationId, len);
+    if (!out) return false;
+    memcpy(out, &d, len);
+    ++sinceKey_;
+    return true;
+  }
+
+private:
+  StatusKeyframePayload key_{};
+  uint16_t every_;
+  uint16_t keySeq_   = 0;
+  uint16_t sinceKey_ = 0;
+  uint8_t  deltaSeq_ = 0;
+  uint32_t keyMs_    = 0;
+  bool     haveKey_  = false;
+  bool     forceKey_ = false;
+};
+
+class Decoder {
+public:
+  static constexpr uint16_t kNoKey = 0xFFFF;
+
+  explicit Decoder(uint16_t keyReqIntervalMs = 250) : reqEveryMs_(keyReqIntervalMs) {}
+
+  bool valid() const { return haveKey_; }
+  const GameStatusPayload& status() const { return status_; }
+  const StateTickPayload&  tick()   const { return tick_; }
+  uint32_t gaps() const { return gaps_; }     // deltas that arrived without their keyframe
+
+  uint32_t stale() const { return stale_; }  // reordered keyframes / deltas dropped
+
+  // Returns false for a keyframe that isn't newer than the one held (a late,
+  // reordered copy). kStaleRun of those in a row means the encoder restarted
+  // its numbering, so the next one is taken anyway.
+  bool onKeyframe(const StatusKeyframePayload& k) {
+    if (haveKey_ && !newer16(k.keySeq, key_.keySeq) && ++staleKeys_ < kStaleRun) {
+      ++stale_;
+      return false;
+    }
+    key_       = k;
+    status_    = k.status;
+    tick_      = k.tick;
+    lastDelta_ = 0;
+    staleKeys_ = 0;
+    haveKey_   = true;
+    needKey_   = false;
+    return true;
+  }
+
+  // Returns false if the delta is stale (older keyframe, or not newer than the
+  // last delta applied) or its keyframe is missing; the latter arms a key request.
+  bool onDelta(const StatusDeltaPayload& d, uint16_t payloadLen) {
+    if (haveKey_ && (d.keySeq == key_.keySeq ? (int8_t)(d.deltaSeq - lastDelta_) <= 0
+                                             : !newer16(d.keySeq, key_.keySeq))) {
+      ++stale_;
+      return false;
+    }
+    if (!haveKey_ || d.keySeq != key_.keySeq) {
+      ++gaps_;
+      needKey_ = true;
+      return false;
+    }
+    const uint8_t* r   = d.fields;
+    const uint8_t* end = reinterpret_cast<const uint8_t*>(&d) +
+                         (payloadLen < sizeof(d) ? payloadLen : sizeof(d));
+    bool ok = true;
+    auto get32 = [&](uint8_t bit, uint32_t predicted) -> uint32_t {
+      if (!(d.changed & bit)) return predicted;
+      if (r + 4 > end) { ok = false; return predicted; }
+      uint32_t v; memcpy(&v, r, 4); r += 4; return v;
+    };
+    auto get8 = [&](uint8_t bit, uint8_t base) -> uint8_t {
+      if (!(d.changed & bit)) return base;
+      if (r + 1 > end) { ok = false; return base; }
+      return *r++;
+    };
+    const GameStatusPayload& ks = key_.status;
+    GameStatusPayload st = ks;
+    StateTickPayload  tk = key_.tick;
+    st.teamScore   = get32(SD_TEAM_SCORE,    ks.teamScore);
+    st.msLeftGame  = get32(SD_MS_LEFT_GAME,  predictTimer(ks.msLeftGame,  d.elapsedMs));
+    st.msLeftRound = get32(SD_MS_LEFT_ROUND, predictTimer(ks.msLeftRound, d.elapsedMs));
+    st.roundIndex  = get8 (SD_ROUND_INDEX,   ks.roundIndex);
+    st.phase       = get8 (SD_PHASE,         ks.phase);
+    st.lightState  = get8 (SD_LIGHT_STATE,   ks.lightState);
+    tk.state       = get8 (SD_TICK_STATE,    key_.tick.state);
+    tk.msLeft      = get32(SD_TICK_MS_LEFT,  predictTimer(key_.tick.msLeft, d.elapsedMs));
+    if (!ok) return false;  // truncated delta: keep the previous state
+    status_    = st;
+    tick_      = tk;
+    lastDelta_ = d.deltaSeq;
+    return true;
+  }
+
+  // True when a STATUS_KEYREQ should go out now (rate-limited).
+  bool wantKeyframe(uint32_t nowMs) {
+    if (!needKey_ || (uint32_t)(nowMs - lastReqMs_) < reqEveryMs_) return false;
+    lastReqMs_ = nowMs;
+    return true;
+  }
+
+  bool buildKeyRequest(TxFrame& frame, uint8_t srcStationId) const {
+    auto* r = frame.begin<StatusKeyReqPayload>(MsgType::STATUS_KEYREQ, srcStationId);
+    if (!r) return false;
+    r->haveKeySeq = haveKey_ ? key_.keySeq : kNoKey;
+    return true;
+  }
+
+private:
+  static constexpr uint8_t kStaleRun = 4;
+
+  // Serial-number order, so keySeq may wrap.
+  static bool newer16(uint16_t a, uint16_t b) { return (int16_t)(a - b) > 0; }
+
+  StatusKeyframePayload key_{};
+  GameStatusPayload status_{};
+  StateTickPayload  tick_{};
+  uint16_t reqEveryMs_;
+  uint32_t lastReqMs_ = 0;
+  uint32_t gaps_      = 0;
+  uint32_t stale_     = 0;
+  uint8_t  lastDelta_ = 0;   // deltaSeq of the last delta applied (encoder starts at 1)
+  uint8_t  staleKeys_ = 0;
+  bool     haveKey_   = false;
+  bool     needKey_   = false;
+};
+
+} // namespace StatusSync
@@ -1,9 +1,25 @@
 #pragma once
 #include <stdint.h>
+#include <string.h>
 #include <functional>
+#include "TrexProtocol.h"
+
+// Link (backend) bits for TransportConfig.links / route.
+enum : uint8_t {
+  TREX_LINK_ESPNOW = 0x01,
+  TREX_LINK_UDP    = 0x02,
+  TREX_LINK_HOST   = 0x04
+};
+
+// Node role for TransportConfig.role.
+enum : uint8_t {
+  TREX_ROLE_UNSET   = 0,   // from stationId: != 0 is a station, 0 is left undecided
+  TREX_ROLE_SERVER  = 1,
+  TREX_ROLE_STATION = 2
+};
 
 struct TransportConfig {
-  bool    maintenanceMode;   // true = prefer Wi-Fi/UDP; we’ll start with ESP-NOW
+  bool    maintenanceMode;   // true = route everything over UDP while its link is up
   uint8_t wifiChannel;       // ESPNOW channel (e.g. 6)
 
   // --- Multi-game safety / upgrade support ---
@@ -14,13 +30,178 @@ struct TransportConfig {
   // If false, drop packets that do not have the wire header.
   // During rollout you can keep this true for backwards compatibility with older firmware.
   bool    rxAcceptLegacy = true;
+
+  // Framed TX encoding: TREX_WIRE_VERSION, or TREX_WIRE_VERSION_COMPACT for the
+  // short header / varint form of TrexCompact.h. Receivers accept both, so
+  // switch once the fleet understands it (e.g. with an armed RADIO_CFG).
+  uint8_t wireVersion    = TREX_WIRE_VERSION;
+
+  // --- Frame aggregation ---
+  // If true, small messages are coalesced into one frame (up to the 250-byte
+  // ESP-NOW limit) and sent when full or after aggFlushMs; loop() must be
+  // called for the deadline flush. Receivers always split aggregate frames;
+  // pre-aggregation firmware only sees the first message, so enable this after
+  // the fleet is updated.
+  bool     txAggregate = false;
+  uint16_t aggFlushMs  = 5;
+
+  // If true, drop frames whose MsgHeader.seq was already seen from that sender
+  // (or is too far behind to tell) before the RxHandler runs; see
+  // TrexSeqWindow.h. Only enable once every sender fills seq (TxFrame does).
+  bool     rxDedupe = false;
+
+  // Our stationId (0 = T-Rex server). Needed by the reliable channel to pick
+  // out messages addressed to us and to stamp REL_ACKs.
+  uint8_t  stationId = 0;
+
+  // TREX_ROLE_*. The ESP-NOW link only learns peer MACs for unicast once the
+  // role is known: the server (TREX_ROLE_SERVER) learns stations, a station
+  // (non-zero stationId) learns the server. Left unset with stationId 0,
+  // everything is broadcast, so a station that never set its id can't
+  // mistake itself for the server.
+  uint8_t  role = TREX_ROLE_UNSET;
+
+  // --- UDP backend addressing ---
+  // udpGroup: multicast group for broadcast(), e.g. "239.84.88.1"; nullptr
+  // keeps limited broadcast (255.255.255.255). With udpUnicast, sendToServer()
+  // and sendToStation() go straight to the address the peer last sent from,
+  // and fall back to limited broadcast until it has been heard (discovery) or
+  // after TREX_UDP_PEER_TTL_MS of silence.
+  const char* udpGroup   = nullptr;
+  bool        udpUnicast = false;
+  uint16_t    udpPort    = 33333;
+
+  // --- Links ---
+  // With both TREX_USE_ESPNOW and TREX_USE_UDP built in, links picks which to
+  // bring up (TREX_LINK_* mask, 0 = all compiled in) and route[] picks, per
+  // TrexTxClass (critical, normal, bulk), which link(s) carry it. 0 or a link
+  // that is down falls back to the first link that is up (ESP-NOW, then UDP).
+  // E.g. gameplay over ESP-NOW, telemetry over UDP when Wi-Fi is up:
+  //   route = {TREX_LINK_ESPNOW, TREX_LINK_ESPNOW, TREX_LINK_UDP}
+  // Copies of one message arriving over two links are delivered once. When
+  // ESP-NOW shares the radio with a Wi-Fi association it runs on the AP's channel.
+  uint8_t links    = 0;
+  uint8_t route[3] = {0, 0, 0};
+
+  // Stations (resolved role STATION): keep an estimate of the server clock by pinging
+  // it every TREX_CLOCK_PING_MS (see TrexClockSync.h and Transport::toLocalMs).
+  // The server (resolved role SERVER) always answers pings.
+  bool    clockSync = false;
 };
 
 using RxHandler = std::function<void(const uint8_t* data, uint16_t len)>;
 
+namespace Transport {
+  uint16_t nextSeq();                                     // per-sender MsgHeader.seq
+}
+
+// --- Zero-copy TX frame ---
+// Reserves headroom for the wire header and the MsgHeader, so the payload is
+// built in place and the backend hands the buffer straight to the driver.
+// Keep one per hot message (e.g. a static for GAME_STATUS) and reuse it.
+//
+//   static TxFrame f;
+//   auto* gs = f.begin<GameStatusPayload>(MsgType::GAME_STATUS, 0);
+//   gs->teamScore = score; ...
+//   Transport::broadcast(f);
+struct TxFrame {
+  static constexpr uint16_t kCapacity   = 250;   // ESP-NOW payload limit
+  static constexpr uint16_t kWireHdrLen = 3;
+  static constexpr uint16_t kMaxPayload = kCapacity - kWireHdrLen - sizeof(MsgHeader);
+
+  uint8_t buf[kCapacity];
+
+  MsgHeader* header()  { return reinterpret_cast<MsgHeader*>(buf + kWireHdrLen); }
+  uint8_t*   payload() { return buf + kWireHdrLen + sizeof(MsgHeader); }
+
+  // Fills the MsgHeader and returns the zeroed payload area (nullptr if too big).
+  uint8_t* begin(MsgType type, uint8_t srcStationId, uint16_t payloadLen) {
+    if (payloadLen > kMaxPayload) return nullptr;
+    MsgHeader* h    = header();
+    h->version      = TREX_PROTO_VERSION;
+    h->type         = (uint8_t)type;
+    h->srcStationId = srcStationId;
+    h->flags        = 0;
+    h->payloadLen   = payloadLen;
+    h->seq          = Transport::nextSeq();
+    memset(payload(), 0, payloadLen);
+    return payload();
+  }
+
+  template <class P>
+  P* begin(MsgType type, uint8_t srcStationId) {
+    static_assert(sizeof(P) <= kMaxPayload, "payload does not fit one frame");
+    return reinterpret_cast<P*>(begin(type, srcStationId, (uint16_t)sizeof(P)));
+  }
+
+  // Bytes to put on the air. Framed mode writes the wire header into the
+  // headroom; legacy mode simply starts after it.
+  const uint8_t* wire(bool framed, uint16_t& len) {
+    len = (uint16_t)(sizeof(MsgHeader) + header()->payloadLen);
+    if (!framed) return buf + kWireHdrLen;
+    buf[0] = (uint8_t)TREX_WIRE_MAGIC0;
+    buf[1] = (uint8_t)TREX_WIRE_MAGIC1;
+    buf[2] = (uint8_t)TREX_WIRE_VERSION;
+    len += kWireHdrLen;
+    return buf;
+  }
+};
+
+// One channel's result from Transport::surveyChannels(). The caller sets
+// channel; the rest is measured while listening promiscuously for dwellMs.
+struct ChannelSurvey {
+  uint8_t  channel;
+  int8_t   maxRssi;        // strongest frame heard (dBm), -128 if none
+  int8_t   noiseFloor;     // last reported noise floor (dBm)
+  uint16_t frames;         // every 802.11 mgmt/data frame
+  uint16_t espNowFrames;   // ESP-NOW action frames among them
+  uint16_t trexFrames;     // ESP-NOW frames carrying the TREX wire header
+  uint32_t busyUs;         // estimated airtime of everything heard
+  uint32_t dwellMs;
+};
+
+// Quietest surveyed channel: least busy airtime, then fewest non-TREX frames.
+inline uint8_t trexQuietestChannel(const ChannelSurvey* s, uint8_t n) {
+  uint8_t best = 0;
+  for (uint8_t i = 1; i < n; ++i) {
+    const uint64_t bi = (uint64_t)s[i].busyUs * s[best].dwellMs, bb = (uint64_t)s[best].busyUs * s[i].dwellMs;
+    const uint16_t fi = (uint16_t)(s[i].frames - s[i].trexFrames), fb = (uint16_t)(s[best].frames - s[best].trexFrames);
+    if (bi < bb || (bi == bb && fi < fb)) best = i;
+  }
+  return n ? s[best].channel : 0;
+}
+
 namespace Transport {
   bool init(const TransportConfig& cfg, RxHandler onRx);
+  // Applies wifiChannel / txFramed / wireVersion / rxAcceptLegacy / aggregation in place:
+  // no driver restart, peers and queues kept.
+  void reconfigure(const TransportConfig& cfg);
+  // Server side: broadcast RADIO_CFG with p.switchInMs != 0, repeat it every
+  // TREX_RADIO_ANNOUNCE_MS with the remaining time, and switch ourselves at the
+  // same moment. Receivers arm the change on their own (no sketch code needed).
+  bool announceRadioCfg(const RadioCfgPayload& p);
+  // Listens on each out[i].channel for dwellMs (ESP-NOW only, blocking, no game
+  // traffic meanwhile; not possible while associated to an AP or while another
+  // promiscuous capture is running). The promiscuous filter is restored
+  // afterwards. False if no link can survey.
+  bool surveyChannels(ChannelSurvey* out, uint8_t count, uint16_t dwellMs);
+  // Server clock (clockSync): serverNowMs() = our estimate of the server's
+  // TransportCommon::nowMs(); toLocalMs() turns a server deadline into ours.
+  // Both fall back to the local clock until clockSynced().
+  bool     clockSynced();
+  uint32_t serverNowMs();
+  uint32_t toLocalMs(uint32_t serverMs);
   bool sendToServer(const uint8_t* data, uint16_t len);   // station → server
   bool broadcast(const uint8_t* data, uint16_t len);      // server → all (or general)
-  void loop();                                            // pump background if needed
+  bool sendToStation(uint8_t stationId, const uint8_t* data, uint16_t len); // server → one station
+  bool sendToServer(TxFrame& frame);                      // zero-copy variants
+  bool broadcast(TxFrame& frame);
+  bool sendToStation(uint8_t stationId, TxFrame& frame);
+  // Reliable channel (see TrexReliable.h): retransmitted until dst acknowledges.
+  // dst is a stationId (0 = server). False if the window is full.
+  bool sendReliable(uint8_t dstStationId, const uint8_t* data, uint16_t len);
+  bool sendReliable(uint8_t dstStationId, TxFrame& frame);
+  void loop();                                            // call every loop(): all received
+                                                          // frames are delivered from here
+  uint32_t rxOverflowCount();                             // RX frames dropped on a full queue
 }
@@ -0,0 +1,379 @@
+// TrexTransportCommon.cpp — the Transport front end and everything shared by
+// the backends: link selection and per-class routing, the receive pipeline
+// (anti-replay window -> reliable channel -> cross-link merge -> RxHandler)
+// and the reliable channel.
+#include "TrexTransportCommon.h"
+#include "TrexLinks.h"
+#include "TrexStats.h"
+#include "TrexTxQueue.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static uint32_t seedRandom() { return esp_random(); }
+#else
+#include <time.h>
+#include <unistd.h>
+static uint32_t seedRandom() {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint32_t)ts.tv_nsec ^ ((uint32_t)getpid() << 16);
+}
+#endif
+
+static TrexReliableChannel g_rel;
+static TrexSeqWindow       g_seq;
+static TrexClockSync       g_clock;
+static bool                g_rxDedupe = false;
+static uint16_t            g_txSeq    = 0;
+
+// ---- Links ----
+static RxHandler g_userRx;
+static uint8_t   g_links = 0;               // TREX_LINK_* whose init() succeeded
+static uint8_t   g_route[TREX_TXC_COUNT];
+static bool      g_maintenance = false;
+static TransportConfig g_cfg;               // as last applied
+
+// ---- Armed radio switch (RADIO_CFG with switchInMs) ----
+struct ArmedSwitch {
+  bool            armed;
+  bool            announcing;   // we're the origin: repeat until the switch
+  uint32_t        atMs;
+  uint32_t        nextAnnounceMs;
+  RadioCfgPayload cfg;
+};
+static ArmedSwitch g_switch;
+
+static void armSwitch(const RadioCfgPayload& p, uint32_t now) {
+  g_switch.armed = true;
+  g_switch.cfg   = p;
+  g_switch.atMs  = now + p.switchInMs;
+}
+
+// Links that can carry traffic right now.
+static uint8_t linksUp() {
+  uint8_t up = 0;
+  trexForEachLink([&](auto link) {
+    using L = decltype(link);
+    if ((g_links & L::kMask) && L::up()) up |= L::kMask;
+  });
+  return up;
+}
+
+static uint8_t routeFor(const uint8_t* msg, uint16_t len) {
+  const uint8_t up   = linksUp();
+  const uint8_t want = (g_maintenance && (up & TREX_LINK_UDP)) ? (uint8_t)TREX_LINK_UDP
+                                                              : g_route[trexTxClassOf(msg, len)];
+  if (want & up) return want & up;
+  // Default / fallback: first link that is up, in trexForEachLink() order.
+  uint8_t first = 0;
+  trexForEachLink([&](auto link) {
+    using L = decltype(link);
+    if (!first && (up & L::kMask)) first = L::kMask;
+  });
+  return first ? first : g_links;
+}
+
+// Sends on every link in mask; true if any took it.
+template <class Send>
+static bool sendVia(uint8_t mask, Send&& send) {
+  bool ok = false;
+  trexForEachLink([&](auto link) {
+    if (mask & decltype(link)::kMask) ok |= send(link);
+  });
+  return ok;
+}
+
+// ---- Cross-link merge ----
+// The same message heard on two links is delivered once. Keyed by a hash of
+// the whole message (header incl. seq) and only against a copy from a
+// *different* link, so repeats on one link still go through untouched.
+struct MergeSlot { uint32_t hash; uint32_t ms; uint8_t link; };
+static MergeSlot g_merge[TREX_MERGE_SLOTS];
+static uint8_t   g_mergeNext = 0;
+
+static bool mergedCopy(uint8_t link, const uint8_t* msg, uint16_t len, uint32_t now) {
+  if (!(g_links & (g_links - 1))) return false;   // single link: nothing to merge
+  uint32_t h = 2166136261u;                       // FNV-1a
+  for (uint16_t i = 0; i < len; ++i) h = (h ^ msg[i]) * 16777619u;
+  for (const MergeSlot& s : g_merge) {
+    if (s.link && s.hash == h && s.link != link && (uint32_t)(now - s.ms) <= TREX_MERGE_WINDOW_MS) return true;
+  }
+  g_merge[g_mergeNext] = {h, now, link};
+  g_mergeNext = (uint8_t)((g_mergeNext + 1) % TREX_MERGE_SLOTS);
+  return false;
+}
+
+// ---- Clock sync ----
+// TIME_PING / TIME_PONG never reach the sketch.
+static bool clockMessage(const uint8_t* msg, uint16_t len, uint32_t now) {
+  if (len < sizeof(MsgHeader)) return false;
+  MsgHeader h;
+  memcpy(&h, msg, sizeof(h));
+  if (h.type == (uint8_t)MsgType::TIME_PING) {
+    if (TransportCommon::role(g_cfg) == TREX_ROLE_SERVER && h.payloadLen >= sizeof(TimePingPayload) &&
+        len >= sizeof(h) + sizeof(TimePingPayload)) {
+      TimePingPayload in;
+      memcpy(&in, msg + sizeof(h), sizeof(in));
+      TxFrame f;
+      auto* out = f.begin<TimePongPayload>(MsgType::TIME_PONG, 0);
+      TrexClockSync::answer(*out, in, h.srcStationId, now, TransportCommon::nowMs());
+      Transport::sendToStation(h.srcStationId, f);
+    }
+    return true;
+  }
+  if (h.type == (uint8_t)MsgType::TIME_PONG) {
+    if (g_cfg.clockSync && h.payloadLen >= sizeof(TimePongPayload) &&
+        len >= sizeof(h) + sizeof(TimePongPayload)) {
+      TimePongPayload p;
+      memcpy(&p, msg + sizeof(h), sizeof(p));
+      if (p.dstStationId == g_cfg.stationId) g_clock.onPong(p, now);
+    }
+    return true;
+  }
+  return false;
+}
+
+static void pingServerIfDue() {
+  if (!g_cfg.clockSync || TransportCommon::role(g_cfg) != TREX_ROLE_STATION) return;
+  const uint32_t now = TransportCommon::nowMs();
+  if (!g_clock.pingDue(now, TREX_CLOCK_PING_MS)) return;
+  TxFrame f;
+  auto* p = f.begin<TimePingPayload>(MsgType::TIME_PING, g_cfg.stationId);
+  g_clock.buildPing(*p, now);
+  Transport::sendToServer(f);
+}
+
+static void linkRx(uint8_t link, const uint8_t* msg, uint16_t len) {
+  const uint32_t now = TransportCommon::nowMs();
+  if (mergedCopy(link, msg, len, now)) {
+    TrexStats::noteRxDrop(TrexStats::RXDROP_DUPLICATE);
+    return;
+  }
+  if (clockMessage(msg, len, now)) return;
+  // An armed RADIO_CFG is applied by the transport itself; the sketch still
+  // sees it (e.g. to log it) but mustn't re-init on it.
+  MsgHeader h;
+  if (len >= sizeof(h) + sizeof(RadioCfgPayload)) {
+    memcpy(&h, msg, sizeof(h));
+    RadioCfgPayload p;
+    memcpy(&p, msg + sizeof(h), sizeof(p));
+    if (h.type == (uint8_t)MsgType::RADIO_CFG && h.payloadLen >= sizeof(p) && p.switchInMs && !g_switch.announcing)
+      armSwitch(p, now);
+  }
+  if (g_userRx) g_userRx(msg, len);
+}
+
+// Data and ACKs go to the one peer they concern (unicast where the backend can).
+static bool relSend(void*, uint8_t dst, const uint8_t* msg, uint16_t len) {
+  return dst == 0 ? Transport::sendToServer(msg, len) : Transport::sendToStation(dst, msg, len);
+}
+
+// Reliable-channel traffic has its own per-destination seq space and its own
+// duplicate handling, so it bypasses the anti-replay window.
+static bool duplicateOrStale(const uint8_t* msg, uint16_t len, uint32_t now) {
+  if (!g_rxDedupe || len < sizeof(MsgHeader)) return false;
+  MsgHeader h;
+  memcpy(&h, msg, sizeof(h));
+  if ((h.flags & TREX_MSGF_RELIABLE) || h.type == (uint8_t)MsgType::REL_ACK) return false;
+  return g_seq.check(h.srcStationId, h.seq, now) != TrexSeqWindow::Verdict::FRESH;
+}
+
+namespace TransportCommon {
+
+uint32_t nowMs() {
+#ifdef ARDUINO
+  return millis();
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u);
+#endif
+}
+
+uint32_t nowUs() {
+#ifdef ARDUINO
+  return micros();
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u);
+#endif
+}
+
+void begin(const TransportConfig& cfg) {
+  g_rel.begin(cfg.stationId, seedRandom(), relSend, nullptr);
+  g_seq.reset();
+  g_rxDedupe = cfg.rxDedupe;
+  g_maintenance = cfg.maintenanceMode;
+  for (uint8_t c = 0; c < TREX_TXC_COUNT; ++c) g_route[c] = cfg.route[c];
+  memset(g_merge, 0, sizeof(g_merge));
+}
+
+// Counts the message and times the sketch's handler.
+static void runHandler(const RxHandler& onRx, const uint8_t* msg, uint16_t len) {
+  TrexStats::noteRxMsg(msg, len);
+  if (!onRx) return;
+  const uint32_t t0 = nowUs();
+  onRx(msg, len);
+  TrexStats::noteHandlerUs(nowUs() - t0);
+}
+
+void deliver(const uint8_t* msg, uint16_t len, const RxHandler& onRx) {
+  const uint32_t now = nowMs();
+  if (duplicateOrStale(msg, len, now)) {
+    TrexStats::noteRxDrop(TrexStats::RXDROP_DUPLICATE);
+    return;
+  }
+
+  uint8_t  out[TrexReliableChannel::kMaxMsg + 1];
+  uint16_t outLen = 0;
+  const uint32_t dupsBefore = g_rel.stats().duplicates;
+  switch (g_rel.onRx(msg, len, now, out, outLen)) {
+    case TrexReliableChannel::Rx::PASS:    runHandler(onRx, msg, len);    break;
+    case TrexReliableChannel::Rx::DELIVER: runHandler(onRx, out, outLen); break;
+    case TrexReliableChannel::Rx::DROP:
+      if (g_rel.stats().duplicates != dupsBefore) TrexStats::noteRxDrop(TrexStats::RXDROP_DUPLICATE);
+      break;
+  }
+}
+
+void poll() {
+  g_rel.poll(nowMs());
+}
+
+const TrexReliableChannel::Stats& reliableStats() { return g_rel.stats(); }
+const TrexSeqWindow&              seqWindow()     { return g_seq; }
+const TrexClockSync&              clock()         { return g_clock; }
+
+} // namespace TransportCommon
+
+namespace Transport {
+
+bool init(const TransportConfig& cfg, RxHandler onRx) {
+  g_userRx = onRx;
+  g_cfg    = cfg;
+  memset(&g_switch, 0, sizeof(g_switch));
+  g_clock.reset();
+  TransportCommon::begin(cfg);
+  g_links = 0;
+  trexForEachLink([&](auto link) {
+    using L = decltype(link);
+    if (cfg.links && !(cfg.links & L::kMask)) return;
+    RxHandler tagged = [](const uint8_t* m, uint16_t n) { linkRx(L::kMask, m, n); };
+    if (L::init(cfg, tagged)) g_links |= L::kMask;
+  });
+  return g_links != 0;
+}
+
+void reconfigure(const TransportConfig& cfg) {
+  g_cfg.wifiChannel    = cfg.wifiChannel;
+  g_cfg.txFramed       = cfg.txFramed;
+  g_cfg.wireVersion    = cfg.wireVersion;
+  g_cfg.rxAcceptLegacy = cfg.rxAcceptLegacy;
+  g_cfg.txAggregate    = cfg.txAggregate;
+  g_cfg.aggFlushMs     = cfg.aggFlushMs;
+  trexForEachLink([&](auto link) {
+    if (g_links & decltype(link)::kMask) link.reconfigure(g_cfg);
+  });
+}
+
+static void sendRadioCfg(uint32_t now) {
+  TxFrame f;
+  auto* p = f.begin<RadioCfgPayload>(MsgType::RADIO_CFG, g_cfg.stationId);
+  *p = g_switch.cfg;
+  const uint32_t left = (int32_t)(g_switch.atMs - now) > 0 ? g_switch.atMs - now : 1;
+  p->switchInMs = (uint16_t)(left > 0xFFFF ? 0xFFFF : left);
+  broadcast(f);
+  g_switch.nextAnnounceMs = now + TREX_RADIO_ANNOUNCE_MS;
+}
+
+bool announceRadioCfg(const RadioCfgPayload& p) {
+  if (!p.switchInMs) return false;
+  const uint32_t now = TransportCommon::nowMs();
+  armSwitch(p, now);
+  g_switch.announcing = true;
+  sendRadioCfg(now);
+  return true;
+}
+
+bool surveyChannels(ChannelSurvey* out, uint8_t count, uint16_t dwellMs) {
+  bool ok = false;
+  trexForEachLink([&](auto link) {
+    if (!ok && (g_links & decltype(link)::kMask)) ok = link.survey(out, count, dwellMs);
+  });
+  return ok;
+}
+
+uint16_t nextSeq() { return g_txSeq++; }
+
+bool sendToServer(const uint8_t* data, uint16_t len) {
+  return sendVia(routeFor(data, len), [&](auto link) { return link.sendToServer(data, len); });
+}
+
+bool broadcast(const uint8_t* data, uint16_t len) {
+  return sendVia(routeFor(data, len), [&](auto link) { return link.broadcast(data, len); });
+}
+
+bool sendToStation(uint8_t stationId, const uint8_t* data, uint16_t len) {
+  return sendVia(routeFor(data, len), [&](auto link) { return link.sendToStation(stationId, data, len); });
+}
+
+bool sendToServer(TxFrame& frame) {
+  return sendVia(routeFor((const uint8_t*)frame.header(), sizeof(MsgHeader)),
+                 [&](auto link) { return link.sendToServer(frame); });
+}
+
+bool broadcast(TxFrame& frame) {
+  return sendVia(routeFor((const uint8_t*)frame.header(), sizeof(MsgHeader)),
+                 [&](auto link) { return link.broadcast(frame); });
+}
+
+bool sendToStation(uint8_t stationId, TxFrame& frame) {
+  return sendVia(routeFor((const uint8_t*)frame.header(), sizeof(MsgHeader)),
+                 [&](auto link) { return link.sendToStation(stationId, frame); });
+}
+
+bool     clockSynced()               { return g_clock.synced(); }
+uint32_t serverNowMs()               { const uint32_t now = TransportCommon::nowMs();
+                                       return g_clock.synced() ? g_clock.toServer(now) : now; }
+uint32_t toLocalMs(uint32_t serverMs) { return g_clock.synced() ? g_clock.toLocal(serverMs) : serverMs; }
+
+void loop() {
+  TransportCommon::poll();
+  pingServerIfDue();
+  if (g_switch.armed) {
+    const uint32_t now = TransportCommon::nowMs();
+    if ((int32_t)(now - g_switch.atMs) >= 0) {
+      TransportConfig c = g_cfg;
+      c.wifiChannel    = g_switch.cfg.wifiChannel;
+      c.txFramed       = g_switch.cfg.txFramed != 0;
+      if (g_switch.cfg.wireVersion) c.wireVersion = g_switch.cfg.wireVersion;
+      c.rxAcceptLegacy = g_switch.cfg.rxLegacy != 0;
+      g_switch.armed = g_switch.announcing = false;
+      reconfigure(c);
+    } else if (g_switch.announcing && (int32_t)(now - g_switch.nextAnnounceMs) >= 0) {
+      sendRadioCfg(now);
+    }
+  }
+  trexForEachLink([&](auto link) {
+    if (g_links & decltype(link)::kMask) link.loop();
+  });
+}
+
+uint32_t rxOverflowCount() {
+  uint32_t n = 0;
+  trexForEachLink([&](auto link) { n += link.rxOverflowCount(); });
+  return n;
+}
+
+bool sendReliable(uint8_t dstStationId, const uint8_t* data, uint16_t len) {
+  return g_rel.send(dstStationId, data, len, TransportCommon::nowMs());
+}
+
+bool sendReliable(uint8_t dstStationId, TxFrame& frame) {
+  return g_rel.send(dstStationId, (const uint8_t*)frame.header(),
+                    (uint16_t)(sizeof(MsgHeader) + frame.header()->payloadLen),
+                    TransportCommon::nowMs());
+}
+
+} // namespace Transport
@@ -0,0 +1,30 @@
+#pragma once
+// TrexTransportCommon.h — backend-independent parts of the receive/transmit
+// path. The Transport front end (TrexTransportCommon.cpp) calls begin() and
+// poll() and dispatches to the links in TrexLinks.h; each link hands every
+// received message (after wire-header stripping and aggregate splitting) to
+// deliver() with the RxHandler it was given at init.
+#include <stdint.h>
+#include "TrexTransport.h"
+#include "TrexReliable.h"
+#include "TrexSeqWindow.h"
+#include "TrexClockSync.h"
+
+namespace TransportCommon {
+  void     begin(const TransportConfig& cfg);
+  void     deliver(const uint8_t* msg, uint16_t len, const RxHandler& onRx);
+  void     poll();
+  uint32_t nowMs();
+  uint32_t nowUs();
+
+  const TrexReliableChannel::Stats& reliableStats();
+  const TrexSeqWindow&              seqWindow();   // per-sender loss / duplicate counts
+  const TrexClockSync&              clock();       // rtt / drift of the server clock estimate
+
+  // cfg.role with UNSET resolved from stationId; stays UNSET (links don't
+  // learn peers) when neither says which end we are.
+  inline uint8_t role(const TransportConfig& cfg) {
+    if (cfg.role == TREX_ROLE_SERVER) return TREX_ROLE_SERVER;
+    return cfg.stationId != 0 ? TREX_ROLE_STATION : TREX_ROLE_UNSET;
+  }
+}
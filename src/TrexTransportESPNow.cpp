@@ -2,7 +2,15 @@
 #if TREX_USE_ESPNOW
 
 #include "TrexTransport.h"
+#include "TrexLinks.h"
 #include "TrexProtocol.h"
+#include "TrexRxRing.h"
+#include "TrexTxQueue.h"
+#include "TrexAggregate.h"
+#include "TrexCapture.h"
+#include "TrexCompact.h"
+#include "TrexTransportCommon.h"
+#include "TrexStats.h"
 #include <Arduino.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
@@ -14,68 +22,307 @@ static RxHandler g_onRx = nullptr;
 static uint8_t   g_broadcastAddr[6] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
 
 static bool g_txFramed        = false;
+static bool g_txCompact       = false;   // framed TX uses TREX_WIRE_VERSION_COMPACT
 static bool g_rxAcceptLegacy  = true;
+static bool g_txAggregate     = false;
+static TrexAggregator<250> g_agg;   // pending messages, all for g_aggDst
+static uint8_t g_aggDst[6];
+#if TREX_TX_QUEUE
+// Frames waiting for room in the driver; in-flight count drops in onEspNowSend.
+static TrexTxQueue<TREX_TX_QUEUE_DEPTH, 250> g_txq;
+#endif
+static uint8_t g_role         = TREX_ROLE_UNSET;   // resolved in init(); UNSET = don't learn peers
+static bool    g_up           = false;
+static uint8_t g_channel      = 0;
+static bool    g_followRadio  = false;   // broadcast peer on channel 0 (Wi-Fi owns the radio)
+
+// ---- Learned peers ----
+// Every received frame teaches us sender stationId -> MAC (HELLO's mac field
+// wins over the radio source address). Stations only keep the server's; the
+// server keeps all of them. Unicast needs a registered ESP-NOW peer, and the
+// driver's peer table is small, so registrations live in an LRU cache and are
+// (re)made lazily from the send path, never from the Wi-Fi task. Only the app
+// task writes g_peers; it does so under g_peerMux, which the send callback
+// takes to read them.
+struct PeerSlot {
+  uint8_t  mac[6];
+  uint8_t  stationId;
+  bool     used;
+  uint32_t lastUseMs;
+  volatile uint8_t fails;   // consecutive unacked unicasts (send callback)
+};
+static uint8_t  g_macById[256][6];
+static uint32_t g_macKnown[8];          // bitmap over stationId
+static PeerSlot g_peers[TREX_PEER_CACHE];
+static portMUX_TYPE g_peerMux = portMUX_INITIALIZER_UNLOCKED;
+
+static inline bool macKnown(uint8_t id) { return g_macKnown[id >> 5] & (1u << (id & 31)); }
+static inline void setMacKnown(uint8_t id, bool on) {
+  if (on) g_macKnown[id >> 5] |=  (1u << (id & 31));
+  else    g_macKnown[id >> 5] &= ~(1u << (id & 31));
+}
+
+static void learnPeer(uint8_t stationId, const uint8_t* mac) {
+  if (!mac || (mac[0] & 0x01)) return;                  // unknown / group address
+  if (g_role == TREX_ROLE_UNSET) return;
+  if (g_role == TREX_ROLE_SERVER ? stationId == 0 : stationId != 0) return;
+  memcpy(g_macById[stationId], mac, 6);
+  setMacKnown(stationId, true);
+}
+
+static void learnFromRecord(const uint8_t* srcMac, const uint8_t* m, uint16_t n) {
+  if (n < sizeof(MsgHeader)) return;
+  MsgHeader h;
+  memcpy(&h, m, sizeof(h));
+  if (h.type == (uint8_t)MsgType::HELLO && h.payloadLen >= sizeof(HelloPayload) &&
+      n >= sizeof(MsgHeader) + sizeof(HelloPayload)) {
+    HelloPayload hp;
+    memcpy(&hp, m + sizeof(MsgHeader), sizeof(hp));
+    learnPeer(h.srcStationId, hp.mac);
+    return;
+  }
+  learnPeer(h.srcStationId, srcMac);
+}
+
+// Frames for mac still waiting in the TX queue or the pending aggregate.
+static bool peerHasQueued(const uint8_t* mac) {
+  if (!g_agg.empty() && memcmp(g_aggDst, mac, 6) == 0) return true;
+#if TREX_TX_QUEUE
+  if (g_txq.queuedFor(mac)) return true;
+#endif
+  return false;
+}
+
+// Unregisters a cached peer. Frames already waiting for it would fail with
+// ESP_ERR_ESPNOW_NOT_FOUND once the driver forgets the MAC, so they go out as
+// broadcast instead, like any frame for a station without a peer.
+static void dropPeer(PeerSlot& s) {
+  portENTER_CRITICAL(&g_peerMux);
+  s.used = false;
+  portEXIT_CRITICAL(&g_peerMux);
+  esp_now_del_peer(s.mac);
+  if (!g_agg.empty() && memcmp(g_aggDst, s.mac, 6) == 0) memcpy(g_aggDst, g_broadcastAddr, 6);
+#if TREX_TX_QUEUE
+  g_txq.readdress(s.mac, g_broadcastAddr);
+#endif
+}
+
+// Registered unicast MAC for stationId, or nullptr (caller falls back to broadcast).
+static const uint8_t* unicastPeer(uint8_t stationId) {
+  if (!macKnown(stationId)) return nullptr;
+  const uint8_t* mac = g_macById[stationId];
+  const uint32_t now = millis();
+  PeerSlot* victim = nullptr;
+  for (auto& s : g_peers) {
+    if (s.used && s.stationId == stationId) {
+      if (memcmp(s.mac, mac, 6) == 0 && s.fails < TREX_PEER_MAX_FAILS) {
+        s.lastUseMs = now;
+        return s.mac;
+      }
+      // Moved to a new MAC or stopped acking: drop it; if it stopped acking,
+      // forget the MAC too so we broadcast until we hear from it again.
+      if (s.fails >= TREX_PEER_MAX_FAILS) setMacKnown(stationId, false);
+      dropPeer(s);
+      if (!macKnown(stationId)) return nullptr;
+      victim = &s;
+      break;
+    }
+  }
+  if (!victim) {
+    // Free slot, else the least recently used peer with nothing queued, else
+    // the least recently used one (its queued frames fall back to broadcast).
+    PeerSlot* idle = nullptr;
+    for (auto& s : g_peers) {
+      if (!s.used) { victim = &s; break; }
+      if (!victim || (int32_t)(s.lastUseMs - victim->lastUseMs) < 0) victim = &s;
+      if (!peerHasQueued(s.mac) && (!idle || (int32_t)(s.lastUseMs - idle->lastUseMs) < 0)) idle = &s;
+    }
+    if (victim->used && idle) victim = idle;
+    if (victim->used) dropPeer(*victim);
+  }
+
+  esp_now_peer_info_t peer;
+  memset(&peer, 0, sizeof(peer));
+  memcpy(peer.peer_addr, mac, 6);
+  peer.channel = 0;           // 0 = whatever channel we're on
+  peer.encrypt = false;
+  #if ESP_IDF_VERSION_MAJOR >= 4
+  peer.ifidx   = WIFI_IF_STA;
+  #endif
+  if (esp_now_add_peer(&peer) != ESP_OK) return nullptr;
+  portENTER_CRITICAL(&g_peerMux);
+  memcpy(victim->mac, mac, 6);
+  victim->stationId = stationId;
+  victim->lastUseMs = now;
+  victim->fails     = 0;
+  victim->used      = true;
+  portEXIT_CRITICAL(&g_peerMux);
+  return victim->mac;
+}
+
+// Send callback (Wi-Fi task): unicast delivery status from the MAC-layer ACK.
+static void notePeerTxStatus(const uint8_t* mac, bool ok) {
+  if (!mac || (mac[0] & 0x01)) return;
+  if (ok) TrexStats::bump(TrexStats::get().txAcked);
+  else    TrexStats::noteTxErr(TrexStats::TXERR_NO_ACK);
+  portENTER_CRITICAL(&g_peerMux);
+  for (auto& s : g_peers) {
+    if (s.used && memcmp(s.mac, mac, 6) == 0) {
+      if (ok) s.fails = 0;
+      else if (s.fails < 0xFF) s.fails = (uint8_t)(s.fails + 1);
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&g_peerMux);
+}
+
+// Filled from the Wi-Fi task, drained by Transport::loop().
+static TrexRxRing<TREX_RX_RING_DEPTH, 250> g_rxRing;
+
+// Send callback (Wi-Fi task), broadcast and unicast alike.
+static void onTxComplete(const uint8_t* mac, bool ok) {
+#if TREX_TX_QUEUE
+  g_txq.onComplete(millis());
+#endif
+  notePeerTxStatus(mac, ok);
+}
 
 static inline bool isFramedPacket(const uint8_t* data, int len) {
   return data && len >= 3 &&
          data[0] == (uint8_t)TREX_WIRE_MAGIC0 &&
          data[1] == (uint8_t)TREX_WIRE_MAGIC1 &&
-         data[2] == (uint8_t)TREX_WIRE_VERSION;
+         (data[2] == (uint8_t)TREX_WIRE_VERSION || data[2] == (uint8_t)TREX_WIRE_VERSION_COMPACT);
 }
 
-static inline void deliverRx(const uint8_t* data, int len) {
+static inline void deliverRx(const uint8_t* mac, const uint8_t* data, int len) {
   if (!g_onRx || !data || len <= 0) return;
+  TrexStats::noteRxFrame((uint16_t)len);
+  TrexCapture::rx(TREX_LINK_ESPNOW, data, (size_t)len, mac);
+
+  auto deliver = [mac](const uint8_t* m, uint16_t n) {
+    learnFromRecord(mac, m, n);
+    TransportCommon::deliver(m, n, g_onRx);
+  };
 
   if (isFramedPacket(data, len)) {
     const uint8_t* payload = data + 3;
     const int      payLen  = len - 3;
-    if (payLen > 0) g_onRx(payload, (uint16_t)payLen);
+    if (payLen <= 0) TrexStats::noteRxDrop(TrexStats::RXDROP_EMPTY);
+    else if (!trexForEachWireRecord(data[2], payload, (uint16_t)payLen, deliver))
+      TrexStats::noteRxDrop(TrexStats::RXDROP_TRUNCATED);
     return;
   }
 
-  if (g_rxAcceptLegacy) {
-    g_onRx(data, (uint16_t)len);
+  if (len < (int)sizeof(MsgHeader)) {
+    TrexStats::bump(TrexStats::get().rxForeign);
+  } else if (!g_rxAcceptLegacy) {
+    TrexStats::noteRxDrop(TrexStats::RXDROP_LEGACY);
+  } else if (!trexForEachRecord(data, (uint16_t)len, deliver)) {
+    TrexStats::noteRxDrop(TrexStats::RXDROP_TRUNCATED);
   }
 }
 
+// Runs in the Wi-Fi task: only enqueues. Parsing, peer learning and the
+// RxHandler all run from Transport::loop().
+static inline void onRadioRx(const uint8_t* mac, const uint8_t* data, int len) {
+  if (data && len > 0 && !g_rxRing.push(data, (uint16_t)len, mac))
+    TrexStats::noteRxDrop(len > 250 ? TrexStats::RXDROP_TRUNCATED : TrexStats::RXDROP_QUEUE_FULL);
+}
+
 #if ESP_IDF_VERSION_MAJOR >= 5
 // ---- IDF v5.x callback signatures ----
 static void onEspNowRecv(const esp_now_recv_info_t* info,
                          const uint8_t* data, int len) {
-  (void)info; // src info optional
-  deliverRx(data, len);
+  onRadioRx(info ? info->src_addr : nullptr, data, len);
 }
 
 static void onEspNowSend(const wifi_tx_info_t* info,
                          esp_now_send_status_t status) {
-  (void)info; (void)status; // hook for optional debug
+  onTxComplete(info ? info->des_addr : nullptr, status == ESP_NOW_SEND_SUCCESS);
 }
 #else
 // ---- IDF v4.x callback signatures ----
 static void onEspNowRecv(const uint8_t* mac, const uint8_t* data, int len) {
-  (void)mac;
-  deliverRx(data, len);
+  onRadioRx(mac, data, len);
 }
 
 static void onEspNowSend(const uint8_t* mac, esp_now_send_status_t status) {
-  (void)mac; (void)status;
+  onTxComplete(mac, status == ESP_NOW_SEND_SUCCESS);
 }
 #endif
 
-namespace Transport {
+static bool flushAggregate();
+
+// Wi-Fi associated or serving a SoftAP: the channel isn't ours to pick.
+static bool wifiBusy() {
+  const wifi_mode_t m = WiFi.getMode();
+  return WiFi.status() == WL_CONNECTED || m == WIFI_MODE_AP || m == WIFI_MODE_APSTA;
+}
+
+static void lockChannel(uint8_t ch) {
+  esp_wifi_set_promiscuous(true);
+  esp_wifi_set_channel(ch, WIFI_SECOND_CHAN_NONE);
+  esp_wifi_set_promiscuous(false);
+}
 
-bool init(const TransportConfig& cfg, RxHandler onRx) {
+// The broadcast peer: channel 0 follows the radio (while Wi-Fi owns it),
+// anything else pins it. Peers registered for unicast always use 0.
+static bool setBroadcastPeer(uint8_t ch, bool add) {
+  esp_now_peer_info_t peer;
+  memset(&peer, 0, sizeof(peer));
+  memcpy(peer.peer_addr, g_broadcastAddr, 6);
+  peer.channel = ch;
+  peer.encrypt = false;
+  #if ESP_IDF_VERSION_MAJOR >= 4
+  peer.ifidx = WIFI_IF_STA;
+  #endif
+  if (!add) return esp_now_mod_peer(&peer) == ESP_OK;
+  esp_now_del_peer(g_broadcastAddr); // in case it already exists
+  return esp_now_add_peer(&peer) == ESP_OK;
+}
+
+// Wi-Fi may associate (UDP link, maintenance) or drop after init. A pinned
+// broadcast peer then no longer matches the radio and every send fails, so
+// follow the radio while Wi-Fi is busy and go back to our channel after.
+static void syncBroadcastPeer() {
+  const bool busy = wifiBusy();
+  if (busy == g_followRadio) return;
+  if (!busy) lockChannel(g_channel);
+  if (setBroadcastPeer(busy ? 0 : g_channel, false)) g_followRadio = busy;
+}
+
+bool EspNowLink::init(const TransportConfig& cfg, RxHandler onRx) {
   g_onRx          = onRx;
+  g_up            = false;
   g_txFramed      = cfg.txFramed;
+  g_txCompact     = cfg.txFramed && cfg.wireVersion == TREX_WIRE_VERSION_COMPACT;
   g_rxAcceptLegacy= cfg.rxAcceptLegacy;
+  g_txAggregate   = cfg.txAggregate;
+  g_agg.clear();
+  g_agg.setFlushMs(cfg.aggFlushMs);
+  g_role          = TransportCommon::role(cfg);
+  for (auto& s : g_peers) {
+    if (!s.used) continue;
+    portENTER_CRITICAL(&g_peerMux);
+    s.used = false;
+    portEXIT_CRITICAL(&g_peerMux);
+    esp_now_del_peer(s.mac);
+  }
+  memset(g_macKnown, 0, sizeof(g_macKnown));
+#if TREX_TX_QUEUE
+  g_txq.clear();
+  g_txq.resetInFlight();
+#endif
 
-  // ESPNOW requires STA mode and a fixed channel
-  WiFi.mode(WIFI_STA);
+  // ESPNOW requires the STA interface and a fixed channel. If Wi-Fi is
+  // already up for the UDP link, keep it and share its channel instead.
+  const bool busy = wifiBusy();
+  if (WiFi.getMode() == WIFI_MODE_AP) WiFi.mode(WIFI_AP_STA);
+  else if (!busy)                     WiFi.mode(WIFI_STA);
 
   // Lock channel before esp_now_init()
-  esp_wifi_set_promiscuous(true);
-  esp_wifi_set_channel(cfg.wifiChannel, WIFI_SECOND_CHAN_NONE);
-  esp_wifi_set_promiscuous(false);
+  if (!busy) lockChannel(cfg.wifiChannel);
+  g_channel = cfg.wifiChannel;
 
   if (esp_now_init() != ESP_OK) return false;
 
@@ -84,26 +331,217 @@ bool init(const TransportConfig& cfg, RxHandler onRx) {
   esp_now_register_send_cb(onEspNowSend);
 
   // Add a broadcast peer so we can send without knowing peers yet
-  esp_now_peer_info_t peer;
-  memset(&peer, 0, sizeof(peer));
-  memcpy(peer.peer_addr, g_broadcastAddr, 6);
-  peer.channel = cfg.wifiChannel;
-  peer.encrypt = false;
-  #if ESP_IDF_VERSION_MAJOR >= 4
-  peer.ifidx = WIFI_IF_STA;
-  #endif
+  setBroadcastPeer(busy ? 0 : cfg.wifiChannel, true);
+  g_followRadio = busy;
 
-  esp_now_del_peer(g_broadcastAddr); // in case it already exists
-  esp_now_add_peer(&peer);
+  g_up = true;
+  return true;
+}
+
+bool EspNowLink::up() { return g_up; }
+
+void EspNowLink::reconfigure(const TransportConfig& cfg) {
+  // Whatever is pending goes out with the framing it was built for.
+  flushAggregate();
+  g_txFramed       = cfg.txFramed;
+  g_txCompact      = cfg.txFramed && cfg.wireVersion == TREX_WIRE_VERSION_COMPACT;
+  g_rxAcceptLegacy = cfg.rxAcceptLegacy;
+  g_txAggregate    = cfg.txAggregate;
+  g_agg.setFlushMs(cfg.aggFlushMs);
+  if (!g_up || cfg.wifiChannel == g_channel) return;
+  if (wifiBusy()) { g_channel = cfg.wifiChannel; return; }   // taken up when Wi-Fi lets go
+
+  // Peers registered with channel 0 follow the radio; only the broadcast
+  // peer carries an explicit channel.
+  lockChannel(cfg.wifiChannel);
+  g_channel = cfg.wifiChannel;
+  setBroadcastPeer(g_channel, false);
+  g_followRadio = false;
+}
+
+// ---- Channel survey ----
+// Promiscuous capture of every mgmt/data frame on the surveyed channel.
+// Airtime is estimated from length and PHY rate; ESP-NOW frames are vendor
+// action frames, whose body we check for the TREX wire header.
+struct SurveyAcc {
+  volatile uint32_t busyUs;
+  volatile uint16_t frames, espNow, trex;
+  volatile int8_t   maxRssi, noise;
+};
+static SurveyAcc g_survey;
+
+// Rate in 100 kbit/s units.
+static uint16_t phyRate(const wifi_pkt_rx_ctrl_t& rx) {
+  if (rx.sig_mode == 0) {   // 802.11b/g, wifi_phy_rate_t codes
+    static const uint16_t kLegacy[16] = {10, 20, 55, 110, 0, 20, 55, 110,
+                                         480, 240, 120, 60, 540, 360, 180, 90};
+    const uint16_t r = kLegacy[rx.rate & 0x0F];
+    return r ? r : 10;
+  }
+  static const uint16_t kHt20[8] = {65, 130, 195, 260, 390, 520, 585, 650};
+  const uint16_t r = kHt20[rx.mcs & 0x07];
+  return rx.cwb ? (uint16_t)(r * 2) : r;
+}
+
+static void onPromiscuous(void* buf, wifi_promiscuous_pkt_type_t type) {
+  const auto* pkt = (const wifi_promiscuous_pkt_t*)buf;
+  const wifi_pkt_rx_ctrl_t& rx = pkt->rx_ctrl;
+  const uint16_t rate = phyRate(rx);
+  const uint32_t preambleUs = (rx.sig_mode == 0 && rate <= 110) ? 192 : 20;
+  g_survey.busyUs = g_survey.busyUs + preambleUs + (uint32_t)rx.sig_len * 80u / rate;
+  g_survey.frames = (uint16_t)(g_survey.frames + 1);
+  if (rx.rssi > g_survey.maxRssi) g_survey.maxRssi = (int8_t)rx.rssi;
+  g_survey.noise = (int8_t)rx.noise_floor;
+
+  // ESP-NOW: action frame (FC 0xD0), vendor category 127, Espressif OUI,
+  // vendor element 0xDD of type 4; body starts at offset 39.
+  const uint8_t* f = pkt->payload;
+  const int len = (int)rx.sig_len - 4;   // minus FCS
+  if (type != WIFI_PKT_MGMT || len < 39 || f[0] != 0xD0 || f[24] != 127 || f[32] != 0xDD || f[37] != 4) return;
+  g_survey.espNow = (uint16_t)(g_survey.espNow + 1);
+  const int bodyLen = (int)f[33] - 5;
+  if (bodyLen > 0 && 39 + bodyLen <= len && isFramedPacket(f + 39, bodyLen))
+    g_survey.trex = (uint16_t)(g_survey.trex + 1);
+}
+
+bool EspNowLink::survey(ChannelSurvey* out, uint8_t count, uint16_t dwellMs) {
+  if (!g_up || wifiBusy() || !out) return false;
+  // Someone else's sniffer is running: its RX callback can't be read back, so
+  // it couldn't be restored afterwards.
+  bool wasPromiscuous = false;
+  esp_wifi_get_promiscuous(&wasPromiscuous);
+  if (wasPromiscuous) return false;
+  wifi_promiscuous_filter_t prevFilter = {WIFI_PROMIS_FILTER_MASK_ALL};
+  esp_wifi_get_promiscuous_filter(&prevFilter);
+  flushAggregate();
+  const wifi_promiscuous_filter_t filter = {WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_DATA};
+  esp_wifi_set_promiscuous_filter(&filter);
+  esp_wifi_set_promiscuous_rx_cb(onPromiscuous);
+  esp_wifi_set_promiscuous(true);
+  for (uint8_t i = 0; i < count; ++i) {
+    esp_wifi_set_channel(out[i].channel, WIFI_SECOND_CHAN_NONE);
+    memset((void*)&g_survey, 0, sizeof(g_survey));
+    g_survey.maxRssi = -128;
+    delay(dwellMs);
+    out[i].maxRssi      = g_survey.maxRssi;
+    out[i].noiseFloor   = g_survey.noise;
+    out[i].frames       = g_survey.frames;
+    out[i].espNowFrames = g_survey.espNow;
+    out[i].trexFrames   = g_survey.trex;
+    out[i].busyUs       = g_survey.busyUs;
+    out[i].dwellMs      = dwellMs;
+  }
+  // Back on our channel (set while still promiscuous, as lockChannel does),
+  // then the filter and sniffer state as we found them.
+  esp_wifi_set_channel(g_channel, WIFI_SECOND_CHAN_NONE);
+  esp_wifi_set_promiscuous(false);
+  esp_wifi_set_promiscuous_rx_cb(nullptr);
+  esp_wifi_set_promiscuous_filter(&prevFilter);
+  return true;
+}
+
+// The one place frames reach the driver: counts it, or the driver's reason for
+// refusing it.
+static esp_err_t driverSend(const uint8_t* dst, const uint8_t* data, uint16_t len) {
+#if TREX_TX_QUEUE
+  // Count the slot first: the send callback can run (Wi-Fi task, maybe the
+  // other core) before esp_now_send() returns, and must find it counted.
+  g_txq.reserve(millis());
+#endif
+  const esp_err_t err = esp_now_send(dst, data, len);
+  if (err == ESP_OK) {
+    TrexStats::noteTxFrame(len);
+    return err;
+  }
+#if TREX_TX_QUEUE
+  g_txq.cancel();
+#endif
+  switch (err) {
+    case ESP_ERR_ESPNOW_NO_MEM:    TrexStats::noteTxErr(TrexStats::TXERR_NO_MEM);    break;
+    case ESP_ERR_ESPNOW_NOT_FOUND: TrexStats::noteTxErr(TrexStats::TXERR_NOT_FOUND); break;
+    case ESP_ERR_ESPNOW_ARG:       TrexStats::noteTxErr(TrexStats::TXERR_ARG);       break;
+    case ESP_ERR_ESPNOW_IF:        TrexStats::noteTxErr(TrexStats::TXERR_IF);        break;
+    case ESP_ERR_ESPNOW_NOT_INIT:  TrexStats::noteTxErr(TrexStats::TXERR_NOT_INIT);  break;
+    default:                       TrexStats::noteTxErr(TrexStats::TXERR_OTHER);     break;
+  }
+  return err;
+}
+
+#if TREX_TX_QUEUE
+// Hands queued frames to the driver, most urgent class first, while fewer than
+// TREX_TX_INFLIGHT are outstanding. A frame the driver has no room for stays
+// at the head; any other refusal drops it (already counted).
+static void pumpTx() {
+  if (g_txq.stalled(millis(), TREX_TX_STALL_MS)) g_txq.resetInFlight();
+  while (g_txq.canSend(TREX_TX_INFLIGHT)) {
+    const auto* s = g_txq.front();
+    if (!s) return;
+    if (driverSend(s->dst, s->data, s->len) == ESP_ERR_ESPNOW_NO_MEM) return;
+    g_txq.pop();
+  }
+}
+#endif
+
+// Queue-or-send one frame. With the scheduler on, true means "accepted": the
+// frame went to the driver or is waiting behind at most TREX_TX_INFLIGHT others
+// of its class or more urgent ones. With compact encoding on, framed frames are
+// re-encoded here, so every path (raw, TxFrame, aggregate) gets it.
+static bool radioSend(TrexTxClass cls, const uint8_t* dst, const uint8_t* data, uint16_t len) {
+  uint8_t compact[250];
+  if (g_txCompact) data = trexCompactWire(data, len, compact, sizeof(compact));
+  TrexCapture::tx(TREX_LINK_ESPNOW, data, len, nullptr, 0, dst);
+#if TREX_TX_QUEUE
+  if (g_txq.empty() && g_txq.canSend(TREX_TX_INFLIGHT)) {
+    const esp_err_t err = driverSend(dst, data, len);
+    if (err != ESP_ERR_ESPNOW_NO_MEM) return err == ESP_OK;
+  }
+  if (!g_txq.push(cls, dst, data, len)) {
+    TrexStats::bump(TrexStats::get().txQueueDrops);
+    return false;
+  }
+  TrexStats::bump(TrexStats::get().txQueued);
+  pumpTx();
+  return true;
+#else
+  (void)cls;
+  return driverSend(dst, data, len) == ESP_OK;
+#endif
+}
 
+static bool flushAggregate() {
+  if (g_agg.empty()) return true;
+  uint16_t len = 0;
+  const uint8_t* wire = g_agg.wire(g_txFramed, len);
+  const bool ok = radioSend(TREX_TXC_NORMAL, g_aggDst, wire, len);
+  g_agg.clear();
+  return ok;
+}
+
+// Appends a message to the pending aggregate frame. Returns false if it has to
+// go out on its own; anything already pending is flushed first (also when the
+// destination changes) so messages never overtake each other.
+static bool queueAggregate(const uint8_t* dst, const uint8_t* msg, uint16_t len) {
+  if (!g_txAggregate) return false;
+  if (!trexIsSingleRecord(msg, len)) { flushAggregate(); return false; }
+  if (!g_agg.empty() && memcmp(g_aggDst, dst, 6) != 0) flushAggregate();
+  if (!g_agg.fits(len)) {
+    flushAggregate();
+    if (!g_agg.fits(len)) return false;
+  }
+  memcpy(g_aggDst, dst, 6);
+  g_agg.add(msg, len, millis());
   return true;
 }
 
 static bool sendRaw(const uint8_t* dst, const uint8_t* data, uint16_t len) {
   if (!dst || !data || !len) return false;
+  TrexStats::noteTxMsg(data, len);
+  // Critical messages skip the aggregate so they never wait for a flush.
+  const TrexTxClass cls = trexTxClassOf(data, len);
+  if (cls != TREX_TXC_CRITICAL && queueAggregate(dst, data, len)) return true;
 
   if (!g_txFramed) {
-    return esp_now_send(dst, data, len) == ESP_OK;
+    return radioSend(cls, dst, data, len);
   }
 
   // ESPNOW max payload is limited; keep a small fixed buffer to avoid heap use.
@@ -111,7 +549,10 @@ static bool sendRaw(const uint8_t* dst, const uint8_t* data, uint16_t len) {
   constexpr size_t kMaxEspNowPayload = 250;
   constexpr size_t kWireHdrLen = 3;
 
-  if ((size_t)len + kWireHdrLen > kMaxEspNowPayload) return false;
+  if ((size_t)len + kWireHdrLen > kMaxEspNowPayload) {
+    TrexStats::noteTxErr(TrexStats::TXERR_OVERSIZE);
+    return false;
+  }
 
   uint8_t buf[kMaxEspNowPayload];
   buf[0] = (uint8_t)TREX_WIRE_MAGIC0;
@@ -119,22 +560,74 @@ static bool sendRaw(const uint8_t* dst, const uint8_t* data, uint16_t len) {
   buf[2] = (uint8_t)TREX_WIRE_VERSION;
   memcpy(buf + kWireHdrLen, data, len);
 
-  return esp_now_send(dst, buf, (uint16_t)(len + kWireHdrLen)) == ESP_OK;
+  return radioSend(cls, dst, buf, (uint16_t)(len + kWireHdrLen));
 }
 
-bool sendToServer(const uint8_t* data, uint16_t len) {
-  // Early phase: broadcast; the server filters by MsgType/source.
-  return sendRaw(g_broadcastAddr, data, len);
+// Zero-copy path: the wire header goes into the frame's headroom.
+static bool sendFrame(const uint8_t* dst, TxFrame& frame) {
+  if (frame.header()->payloadLen > TxFrame::kMaxPayload) {
+    TrexStats::noteTxErr(TrexStats::TXERR_OVERSIZE);
+    return false;
+  }
+  const uint16_t msgLen = (uint16_t)(sizeof(MsgHeader) + frame.header()->payloadLen);
+  TrexStats::noteTxMsg((const uint8_t*)frame.header(), msgLen);
+  const TrexTxClass cls = trexTxClassOf(frame.header()->type);
+  if (cls != TREX_TXC_CRITICAL && queueAggregate(dst, (const uint8_t*)frame.header(), msgLen)) return true;
+  uint16_t len = 0;
+  const uint8_t* wire = frame.wire(g_txFramed, len);
+  return radioSend(cls, dst, wire, len);
+}
+
+// Unicast once we've learned the station's MAC (MAC-layer ACK/retry, no
+// wake-ups elsewhere); broadcast until then.
+static const uint8_t* dstFor(uint8_t stationId) {
+  const uint8_t* mac = unicastPeer(stationId);
+  return mac ? mac : g_broadcastAddr;
 }
 
-bool broadcast(const uint8_t* data, uint16_t len) {
+bool EspNowLink::sendToServer(const uint8_t* data, uint16_t len) {
+  return sendRaw(dstFor(0), data, len);
+}
+
+bool EspNowLink::broadcast(const uint8_t* data, uint16_t len) {
   return sendRaw(g_broadcastAddr, data, len);
 }
 
-void loop() {
-  // ESPNOW is ISR/task-driven; nothing to pump here
+bool EspNowLink::sendToStation(uint8_t stationId, const uint8_t* data, uint16_t len) {
+  return sendRaw(dstFor(stationId), data, len);
+}
+
+bool EspNowLink::sendToServer(TxFrame& frame) {
+  return sendFrame(dstFor(0), frame);
+}
+
+bool EspNowLink::broadcast(TxFrame& frame) {
+  return sendFrame(g_broadcastAddr, frame);
+}
+
+bool EspNowLink::sendToStation(uint8_t stationId, TxFrame& frame) {
+  return sendFrame(dstFor(stationId), frame);
+}
+
+void EspNowLink::loop() {
+  if (g_up) syncBroadcastPeer();
+  if (g_agg.due(millis())) flushAggregate();
+#if TREX_TX_QUEUE
+  pumpTx();
+#endif
+
+  // Bounded batch so a burst can't starve the sketch loop.
+  for (int i = 0; i < TREX_RX_BATCH; ++i) {
+    const auto* slot = g_rxRing.peek();
+    if (!slot) break;
+    deliverRx(slot->mac, slot->data, slot->len);
+    g_rxRing.pop();
+  }
+}
+
+uint32_t EspNowLink::rxOverflowCount() {
+  return g_rxRing.overflows();
 }
 
-} // namespace Transport
 
 #endif // TREX_USE_ESPNOW
@@ -0,0 +1,381 @@
+#include "TrexBuildConfig.h"
+#if TREX_USE_HOST
+
+// Linux host backend: one UDP multicast group on the loopback interface stands
+// in for the radio channel. Every process that calls Transport::init() joins the
+// group, so N processes (or one simulator process with many sockets) see each
+// other's traffic the way stations on one ESP-NOW channel do.
+//
+//   group : TREX_HOST_GROUP env var, default 239.84.88.1
+//   port  : TREX_HOST_PORT env var (default 33333) + wifiChannel, so two
+//           "channels" never hear each other
+//
+// Like ESP-NOW, a sender does not receive its own frames: we transmit from a
+// separate ephemeral-port socket and drop anything arriving from that port.
+//
+// Receive uses recvmmsg() (TREX_NET_RX_BATCH datagrams per syscall); with
+// TREX_HOST_TX_BATCH > 0 sends are batched into sendmmsg() as well, which is
+// what lets one process stand in for a server with hundreds of stations.
+
+#include "TrexTransport.h"
+#include "TrexLinks.h"
+#include "TrexProtocol.h"
+#include "TrexAggregate.h"
+#include "TrexCapture.h"
+#include "TrexCompact.h"
+#include "TrexTransportCommon.h"
+#include "TrexStats.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static RxHandler g_onRx = nullptr;
+static int       g_rxSock = -1;
+static int       g_txSock = -1;
+static uint16_t  g_txPort = 0;     // our own source port (self-filter)
+static uint16_t  g_portBase = 0;   // channel 0 port; wifiChannel is added
+static sockaddr_in g_group;
+
+static bool g_txFramed       = false;
+static bool g_txCompact      = false;   // framed TX uses TREX_WIRE_VERSION_COMPACT
+static bool g_rxAcceptLegacy = true;
+static bool g_txAggregate    = false;
+static TrexAggregator<250> g_agg;
+
+static const char*    HOST_GROUP_DEFAULT = "239.84.88.1";
+static const uint16_t HOST_PORT_DEFAULT  = 33333;
+
+static inline bool isFramedPacket(const uint8_t* data, int len) {
+  return data && len >= 3 &&
+         data[0] == (uint8_t)TREX_WIRE_MAGIC0 &&
+         data[1] == (uint8_t)TREX_WIRE_MAGIC1 &&
+         (data[2] == (uint8_t)TREX_WIRE_VERSION || data[2] == (uint8_t)TREX_WIRE_VERSION_COMPACT);
+}
+
+static inline void deliverRx(const uint8_t* data, int len) {
+  if (!g_onRx || !data || len <= 0) return;
+  TrexStats::noteRxFrame((uint16_t)len);
+  TrexCapture::rx(TREX_LINK_HOST, data, (size_t)len);
+  auto deliver = [](const uint8_t* m, uint16_t n) { TransportCommon::deliver(m, n, g_onRx); };
+
+  if (isFramedPacket(data, len)) {
+    const uint8_t* payload = data + 3;
+    const int      payLen  = len - 3;
+    if (payLen <= 0) TrexStats::noteRxDrop(TrexStats::RXDROP_EMPTY);
+    else if (!trexForEachWireRecord(data[2], payload, (uint16_t)payLen, deliver))
+      TrexStats::noteRxDrop(TrexStats::RXDROP_TRUNCATED);
+    return;
+  }
+  if (len < (int)sizeof(MsgHeader)) {
+    TrexStats::bump(TrexStats::get().rxForeign);
+  } else if (!g_rxAcceptLegacy) {
+    TrexStats::noteRxDrop(TrexStats::RXDROP_LEGACY);
+  } else if (!trexForEachRecord(data, (uint16_t)len, deliver)) {
+    TrexStats::noteRxDrop(TrexStats::RXDROP_TRUNCATED);
+  }
+}
+
+// Counts the outcome of one datagram send.
+static bool noteSent(ssize_t sent, size_t len) {
+  if (sent == (ssize_t)len) { TrexStats::noteTxFrame((uint16_t)len); return true; }
+  TrexStats::noteTxErr(errno == ENOBUFS || errno == EAGAIN ? TrexStats::TXERR_NO_MEM : TrexStats::TXERR_OTHER);
+  return false;
+}
+
+#if TREX_HOST_TX_BATCH
+struct TxSlot { uint16_t len; uint8_t data[253]; };   // wire header + 250
+static TxSlot   g_txBatch[TREX_HOST_TX_BATCH];
+static uint16_t g_txBatchN = 0;
+
+static void flushTxBatch() {
+  mmsghdr msgs[TREX_HOST_TX_BATCH];
+  iovec   iov[TREX_HOST_TX_BATCH];
+  memset(msgs, 0, sizeof(msgs));
+  for (uint16_t i = 0; i < g_txBatchN; ++i) {
+    iov[i] = {g_txBatch[i].data, g_txBatch[i].len};
+    msgs[i].msg_hdr.msg_name    = &g_group;
+    msgs[i].msg_hdr.msg_namelen = sizeof(g_group);
+    msgs[i].msg_hdr.msg_iov     = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen  = 1;
+  }
+  uint16_t done = 0;
+  while (done < g_txBatchN) {
+    const int n = sendmmsg(g_txSock, msgs + done, g_txBatchN - done, 0);
+    if (n <= 0) {   // first unsent datagram failed: count it, skip it, go on
+      noteSent(-1, g_txBatch[done].len);
+      ++done;
+      continue;
+    }
+    for (int i = 0; i < n; ++i) noteSent((ssize_t)msgs[done + i].msg_len, g_txBatch[done + i].len);
+    done = (uint16_t)(done + n);
+  }
+  g_txBatchN = 0;
+}
+#endif
+
+// One datagram: head (may be the wire header) followed by body.
+static bool sendDatagram(const uint8_t* head, size_t headLen, const uint8_t* body, size_t bodyLen) {
+  TrexCapture::tx(TREX_LINK_HOST, head, headLen, body, bodyLen);
+#if TREX_HOST_TX_BATCH
+  if (headLen + bodyLen > sizeof(TxSlot::data)) { TrexStats::noteTxErr(TrexStats::TXERR_OVERSIZE); return false; }
+  TxSlot& s = g_txBatch[g_txBatchN++];
+  memcpy(s.data, head, headLen);
+  if (bodyLen) memcpy(s.data + headLen, body, bodyLen);
+  s.len = (uint16_t)(headLen + bodyLen);
+  if (g_txBatchN == TREX_HOST_TX_BATCH) flushTxBatch();
+  return true;
+#else
+  iovec iov[2] = {{(void*)head, headLen}, {(void*)body, bodyLen}};
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name    = &g_group;
+  msg.msg_namelen = sizeof(g_group);
+  msg.msg_iov     = iov;
+  msg.msg_iovlen  = bodyLen ? 2 : 1;
+  return noteSent(sendmsg(g_txSock, &msg, 0), headLen + bodyLen);
+#endif
+}
+
+static uint32_t hostMillis() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u);
+}
+
+static void closeSockets() {
+  if (g_rxSock >= 0) close(g_rxSock);
+  if (g_txSock >= 0) close(g_txSock);
+  g_rxSock = g_txSock = -1;
+}
+
+// RX: bound to the group port, shared with every other node on this host.
+static bool openRxSocket() {
+  if (g_rxSock >= 0) close(g_rxSock);
+  g_rxSock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (g_rxSock < 0) return false;
+  int one = 1;
+  setsockopt(g_rxSock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in bindAddr;
+  memset(&bindAddr, 0, sizeof(bindAddr));
+  bindAddr.sin_family      = AF_INET;
+  bindAddr.sin_port        = g_group.sin_port;
+  bindAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+  ip_mreq mreq;
+  mreq.imr_multiaddr        = g_group.sin_addr;
+  mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(g_rxSock, (sockaddr*)&bindAddr, sizeof(bindAddr)) != 0 ||
+      setsockopt(g_rxSock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+    close(g_rxSock);
+    g_rxSock = -1;
+    return false;
+  }
+  fcntl(g_rxSock, F_SETFL, fcntl(g_rxSock, F_GETFL, 0) | O_NONBLOCK);
+  return true;
+}
+
+bool HostLink::init(const TransportConfig& cfg, RxHandler onRx) {
+  g_onRx           = onRx;
+  g_txFramed       = cfg.txFramed;
+  g_txCompact      = cfg.txFramed && cfg.wireVersion == TREX_WIRE_VERSION_COMPACT;
+  g_rxAcceptLegacy = cfg.rxAcceptLegacy;
+  g_txAggregate    = cfg.txAggregate;
+  g_agg.clear();
+  g_agg.setFlushMs(cfg.aggFlushMs);
+
+  closeSockets();
+
+  const char* grp  = getenv("TREX_HOST_GROUP");
+  const char* port = getenv("TREX_HOST_PORT");
+  memset(&g_group, 0, sizeof(g_group));
+  g_group.sin_family = AF_INET;
+  if (inet_pton(AF_INET, grp ? grp : HOST_GROUP_DEFAULT, &g_group.sin_addr) != 1) return false;
+
+  g_portBase = (uint16_t)(port ? atoi(port) : HOST_PORT_DEFAULT);
+  g_group.sin_port = htons((uint16_t)(g_portBase + cfg.wifiChannel));
+  if (!openRxSocket()) { closeSockets(); return false; }
+
+  in_addr loop;
+  loop.s_addr = htonl(INADDR_LOOPBACK);
+  int one = 1;
+
+  // TX: ephemeral port, multicast out of lo with loopback enabled.
+  g_txSock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (g_txSock < 0) { closeSockets(); return false; }
+  setsockopt(g_txSock, IPPROTO_IP, IP_MULTICAST_IF, &loop, sizeof(loop));
+  setsockopt(g_txSock, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+  sockaddr_in any;
+  memset(&any, 0, sizeof(any));
+  any.sin_family = AF_INET;
+  socklen_t alen = sizeof(any);
+  if (bind(g_txSock, (sockaddr*)&any, sizeof(any)) != 0 ||
+      getsockname(g_txSock, (sockaddr*)&any, &alen) != 0) {
+    closeSockets();
+    return false;
+  }
+  g_txPort = ntohs(any.sin_port);
+  return true;
+}
+
+bool HostLink::up() { return g_rxSock >= 0; }
+
+static bool flushAggregate();
+
+// A "channel" is a port offset here: moving just rebinds the RX socket.
+void HostLink::reconfigure(const TransportConfig& cfg) {
+  flushAggregate();
+#if TREX_HOST_TX_BATCH
+  if (g_txBatchN) flushTxBatch();
+#endif
+  g_txFramed       = cfg.txFramed;
+  g_txCompact      = cfg.txFramed && cfg.wireVersion == TREX_WIRE_VERSION_COMPACT;
+  g_rxAcceptLegacy = cfg.rxAcceptLegacy;
+  g_txAggregate    = cfg.txAggregate;
+  g_agg.setFlushMs(cfg.aggFlushMs);
+  const uint16_t port = (uint16_t)(g_portBase + cfg.wifiChannel);
+  if (g_rxSock < 0 || port == ntohs(g_group.sin_port)) return;
+  g_group.sin_port = htons(port);
+  openRxSocket();
+}
+
+bool HostLink::survey(ChannelSurvey*, uint8_t, uint16_t) { return false; }
+
+static bool flushAggregate() {
+  if (g_agg.empty()) return true;
+  uint16_t len = 0;
+  uint8_t compact[250];
+  const uint8_t* wire = g_agg.wire(g_txFramed, len);
+  if (g_txCompact) wire = trexCompactWire(wire, len, compact, sizeof(compact));
+  const bool ok = sendDatagram(wire, len, nullptr, 0);
+  g_agg.clear();
+  return ok;
+}
+
+static bool queueAggregate(const uint8_t* msg, uint16_t len) {
+  if (!g_txAggregate) return false;
+  if (!trexIsSingleRecord(msg, len)) { flushAggregate(); return false; }
+  if (!g_agg.fits(len)) {
+    flushAggregate();
+    if (!g_agg.fits(len)) return false;
+  }
+  g_agg.add(msg, len, hostMillis());
+  return true;
+}
+
+static bool sendRaw(const uint8_t* data, uint16_t len) {
+  if (!data || !len || g_txSock < 0) return false;
+  TrexStats::noteTxMsg(data, len);
+  if (queueAggregate(data, len)) return true;
+
+  // Same limit as ESP-NOW so host runs catch oversize messages too.
+  constexpr size_t kMaxPayload = 250;
+  constexpr size_t kWireHdrLen = 3;
+
+  if (!g_txFramed) {
+    if (len > kMaxPayload) { TrexStats::noteTxErr(TrexStats::TXERR_OVERSIZE); return false; }
+    return sendDatagram(data, len, nullptr, 0);
+  }
+  if ((size_t)len + kWireHdrLen > kMaxPayload) { TrexStats::noteTxErr(TrexStats::TXERR_OVERSIZE); return false; }
+
+  if (g_txCompact) {
+    uint8_t buf[kMaxPayload];
+    const uint16_t n = trexCompactFrame(data, len, buf, sizeof(buf));
+    if (n) return sendDatagram(buf, n, nullptr, 0);
+  }
+  const uint8_t hdr[kWireHdrLen] = {(uint8_t)TREX_WIRE_MAGIC0, (uint8_t)TREX_WIRE_MAGIC1, (uint8_t)TREX_WIRE_VERSION};
+  return sendDatagram(hdr, kWireHdrLen, data, len);
+}
+
+static bool sendFrame(TxFrame& frame) {
+  if (g_txSock < 0) return false;
+  if (frame.header()->payloadLen > TxFrame::kMaxPayload) {
+    TrexStats::noteTxErr(TrexStats::TXERR_OVERSIZE);
+    return false;
+  }
+  const uint16_t msgLen = (uint16_t)(sizeof(MsgHeader) + frame.header()->payloadLen);
+  TrexStats::noteTxMsg((const uint8_t*)frame.header(), msgLen);
+  if (queueAggregate((const uint8_t*)frame.header(), msgLen)) return true;
+  uint16_t len = 0;
+  uint8_t compact[TxFrame::kCapacity];
+  const uint8_t* wire = frame.wire(g_txFramed, len);
+  if (g_txCompact) wire = trexCompactWire(wire, len, compact, sizeof(compact));
+  return sendDatagram(wire, len, nullptr, 0);
+}
+
+bool HostLink::sendToServer(const uint8_t* data, uint16_t len) {
+  // Mirrors ESP-NOW: everything is a broadcast on the shared group.
+  return sendRaw(data, len);
+}
+
+bool HostLink::broadcast(const uint8_t* data, uint16_t len) {
+  return sendRaw(data, len);
+}
+
+bool HostLink::sendToServer(TxFrame& frame) {
+  return sendFrame(frame);
+}
+
+bool HostLink::broadcast(TxFrame& frame) {
+  return sendFrame(frame);
+}
+
+// No per-station addressing on this backend yet: everyone hears it.
+bool HostLink::sendToStation(uint8_t stationId, const uint8_t* data, uint16_t len) {
+  (void)stationId;
+  return sendRaw(data, len);
+}
+
+bool HostLink::sendToStation(uint8_t stationId, TxFrame& frame) {
+  (void)stationId;
+  return sendFrame(frame);
+}
+
+void HostLink::loop() {
+  if (g_rxSock < 0) return;
+  if (g_agg.due(hostMillis())) flushAggregate();
+
+  // Up to TREX_NET_RX_BATCH datagrams per recvmmsg(); stop at the batch or
+  // time budget. MSG_TRUNC in msg_flags marks datagrams that didn't fit.
+  static uint8_t     bufs[TREX_NET_RX_BATCH][TREX_NET_MAX_DATAGRAM];
+  static sockaddr_in from[TREX_NET_RX_BATCH];
+  mmsghdr msgs[TREX_NET_RX_BATCH];
+  iovec   iov[TREX_NET_RX_BATCH];
+  const uint32_t t0 = TransportCommon::nowUs();
+  int handled = 0;
+  while (handled < TREX_NET_RX_BATCH) {
+    const int want = TREX_NET_RX_BATCH - handled;
+    memset(msgs, 0, sizeof(mmsghdr) * want);
+    for (int i = 0; i < want; ++i) {
+      iov[i] = {bufs[i], sizeof(bufs[i])};
+      msgs[i].msg_hdr.msg_name    = &from[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+      msgs[i].msg_hdr.msg_iov     = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen  = 1;
+    }
+    const int n = recvmmsg(g_rxSock, msgs, (unsigned)want, MSG_DONTWAIT, nullptr);
+    if (n <= 0) break;  // EAGAIN: drained
+    for (int i = 0; i < n; ++i) {
+      if (ntohs(from[i].sin_port) == g_txPort) continue;  // our own transmission
+      if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) { TrexStats::noteRxDrop(TrexStats::RXDROP_OVERSIZE); continue; }
+      deliverRx(bufs[i], (int)msgs[i].msg_len);
+    }
+    handled += n;
+    if (n < want || (uint32_t)(TransportCommon::nowUs() - t0) >= TREX_NET_RX_BUDGET_US) break;
+  }
+
+#if TREX_HOST_TX_BATCH
+  if (g_txBatchN) flushTxBatch();
+#endif
+}
+
+uint32_t HostLink::rxOverflowCount() {
+  return 0;  // polled from loop(); the socket buffer is the only queue
+}
+
+
+#endif // TREX_USE_HOST
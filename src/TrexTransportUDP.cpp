@@ -2,7 +2,13 @@
 #if TREX_USE_UDP
 
 #include "TrexTransport.h"
+#include "TrexLinks.h"
 #include "TrexProtocol.h"
+#include "TrexAggregate.h"
+#include "TrexCapture.h"
+#include "TrexCompact.h"
+#include "TrexTransportCommon.h"
+#include "TrexStats.h"
 #include <Arduino.h>
 #include <WiFi.h>
 #include <WiFiUdp.h>
@@ -10,87 +16,271 @@
 
 static RxHandler g_onRx = nullptr;
 static WiFiUDP   g_udp;
-static const uint16_t UDP_PORT = 33333;
+static uint16_t  g_port = 33333;
+static const IPAddress kLimitedBcast(255, 255, 255, 255);
+static IPAddress g_bcastDst(255, 255, 255, 255);   // multicast group if configured
 
 static bool g_txFramed       = false;
+static bool g_txCompact      = false;   // framed TX uses TREX_WIRE_VERSION_COMPACT
 static bool g_rxAcceptLegacy = true;
+static bool g_txAggregate    = false;
+static TrexAggregator<250> g_agg;   // pending messages, all for g_aggDst
+static IPAddress g_aggDst;
+static uint16_t  g_aggPort    = 0;
+static uint8_t   g_role       = TREX_ROLE_UNSET;   // UNSET = don't learn endpoints
+static bool      g_udpUnicast = false;
+
+// ---- Learned endpoints ----
+// Source address of each station's last frame. As on ESP-NOW, stations only
+// keep the server's and the server keeps everyone's.
+struct Endpoint {
+  uint32_t ip;        // 0 = unknown
+  uint16_t port;
+  uint32_t lastMs;
+};
+static Endpoint g_peers[256];
+
+static void learnPeer(uint8_t stationId, IPAddress ip, uint16_t port) {
+  if (!g_udpUnicast || g_role == TREX_ROLE_UNSET) return;
+  if (g_role == TREX_ROLE_SERVER ? stationId == 0 : stationId != 0) return;
+  Endpoint& e = g_peers[stationId];
+  e.ip     = (uint32_t)ip;
+  e.port   = port;
+  e.lastMs = millis();
+}
+
+// Learned endpoint for stationId, or limited broadcast while unknown / stale.
+static IPAddress dstFor(uint8_t stationId, uint16_t& port) {
+  port = g_port;
+  const Endpoint& e = g_peers[stationId];
+  if (!g_udpUnicast || !e.ip || (uint32_t)(millis() - e.lastMs) > TREX_UDP_PEER_TTL_MS) return kLimitedBcast;
+  port = e.port;
+  return IPAddress(e.ip);
+}
 
 static inline bool isFramedPacket(const uint8_t* data, int len) {
   return data && len >= 3 &&
          data[0] == (uint8_t)TREX_WIRE_MAGIC0 &&
          data[1] == (uint8_t)TREX_WIRE_MAGIC1 &&
-         data[2] == (uint8_t)TREX_WIRE_VERSION;
+         (data[2] == (uint8_t)TREX_WIRE_VERSION || data[2] == (uint8_t)TREX_WIRE_VERSION_COMPACT);
 }
 
 static inline void deliverRx(const uint8_t* data, int len) {
   if (!g_onRx || !data || len <= 0) return;
+  TrexStats::noteRxFrame((uint16_t)len);
+  TrexCapture::rx(TREX_LINK_UDP, data, (size_t)len);
+  auto deliver = [](const uint8_t* m, uint16_t n) {
+    if (n >= sizeof(MsgHeader)) learnPeer(m[offsetof(MsgHeader, srcStationId)], g_udp.remoteIP(), g_udp.remotePort());
+    TransportCommon::deliver(m, n, g_onRx);
+  };
 
   if (isFramedPacket(data, len)) {
     const uint8_t* payload = data + 3;
     const int      payLen  = len - 3;
-    if (payLen > 0) g_onRx(payload, (uint16_t)payLen);
+    if (payLen <= 0) TrexStats::noteRxDrop(TrexStats::RXDROP_EMPTY);
+    else if (!trexForEachWireRecord(data[2], payload, (uint16_t)payLen, deliver))
+      TrexStats::noteRxDrop(TrexStats::RXDROP_TRUNCATED);
     return;
   }
-  if (g_rxAcceptLegacy) {
-    g_onRx(data, (uint16_t)len);
+  if (len < (int)sizeof(MsgHeader)) {
+    TrexStats::bump(TrexStats::get().rxForeign);
+  } else if (!g_rxAcceptLegacy) {
+    TrexStats::noteRxDrop(TrexStats::RXDROP_LEGACY);
+  } else if (!trexForEachRecord(data, (uint16_t)len, deliver)) {
+    TrexStats::noteRxDrop(TrexStats::RXDROP_TRUNCATED);
   }
 }
 
-namespace Transport {
-
-bool init(const TransportConfig& cfg, RxHandler onRx) {
-  (void)cfg;
+bool UdpLink::init(const TransportConfig& cfg, RxHandler onRx) {
   g_onRx           = onRx;
   g_txFramed       = cfg.txFramed;
+  g_txCompact      = cfg.txFramed && cfg.wireVersion == TREX_WIRE_VERSION_COMPACT;
   g_rxAcceptLegacy = cfg.rxAcceptLegacy;
+  g_txAggregate    = cfg.txAggregate;
+  g_agg.clear();
+  g_agg.setFlushMs(cfg.aggFlushMs);
+  g_role           = TransportCommon::role(cfg);
+  g_udpUnicast     = cfg.udpUnicast;
+  g_port           = cfg.udpPort;
+  memset(g_peers, 0, sizeof(g_peers));
 
   // Let the sketch handle Wi-Fi connection/AP. We just bind the socket.
   if (WiFi.getMode() == WIFI_MODE_NULL) {
     WiFi.mode(WIFI_STA); // safe default; works for STA or after AP start in sketch
   }
-  g_udp.begin(UDP_PORT);
+  g_udp.stop();
+  g_bcastDst = kLimitedBcast;
+  IPAddress group;
+  if (cfg.udpGroup && group.fromString(cfg.udpGroup)) {
+    // Joins the group and still receives limited broadcast on the same port,
+    // so discovery from (and replies to) not-yet-learned peers keep working.
+    if (!g_udp.beginMulticast(group, g_port)) return false;
+    g_bcastDst = group;
+  } else if (!g_udp.begin(g_port)) {
+    return false;
+  }
   return true;
 }
 
-static bool sendRaw(const uint8_t* data, uint16_t len) {
+static bool flushAggregate();
+
+// Framing and aggregation only: the IP network has no channel of ours.
+void UdpLink::reconfigure(const TransportConfig& cfg) {
+  flushAggregate();
+  g_txFramed       = cfg.txFramed;
+  g_txCompact      = cfg.txFramed && cfg.wireVersion == TREX_WIRE_VERSION_COMPACT;
+  g_rxAcceptLegacy = cfg.rxAcceptLegacy;
+  g_txAggregate    = cfg.txAggregate;
+  g_agg.setFlushMs(cfg.aggFlushMs);
+}
+
+bool UdpLink::survey(ChannelSurvey*, uint8_t, uint16_t) { return false; }
+
+// Associated to an AP, or running our own SoftAP.
+bool UdpLink::up() {
+  const wifi_mode_t m = WiFi.getMode();
+  return WiFi.status() == WL_CONNECTED || m == WIFI_MODE_AP || m == WIFI_MODE_APSTA;
+}
+
+// One datagram, counted; compact-encoded first when enabled.
+static bool udpSend(IPAddress dst, uint16_t port, const uint8_t* data, uint16_t len) {
+  uint8_t compact[253];
+  if (g_txCompact) data = trexCompactWire(data, len, compact, sizeof(compact));
+  TrexCapture::tx(TREX_LINK_UDP, data, len);
+  g_udp.beginPacket(dst, port);
+  size_t n = g_udp.write(data, len);
+  const bool ok = g_udp.endPacket() && n == len;
+  if (ok) TrexStats::noteTxFrame(len);
+  else    TrexStats::noteTxErr(TrexStats::TXERR_OTHER);
+  return ok;
+}
+
+static bool flushAggregate() {
+  if (g_agg.empty()) return true;
+  uint16_t len = 0;
+  const uint8_t* wire = g_agg.wire(g_txFramed, len);
+  const bool ok = udpSend(g_aggDst, g_aggPort, wire, len);
+  g_agg.clear();
+  return ok;
+}
+
+// See the ESP-NOW backend: pending messages are flushed before anything that
+// can't join the aggregate, so ordering is preserved.
+static bool queueAggregate(IPAddress dst, uint16_t port, const uint8_t* msg, uint16_t len) {
+  if (!g_txAggregate) return false;
+  if (!trexIsSingleRecord(msg, len)) { flushAggregate(); return false; }
+  if (!g_agg.empty() && (g_aggDst != dst || g_aggPort != port)) flushAggregate();
+  if (!g_agg.fits(len)) {
+    flushAggregate();
+    if (!g_agg.fits(len)) return false;
+  }
+  g_aggDst  = dst;
+  g_aggPort = port;
+  g_agg.add(msg, len, millis());
+  return true;
+}
+
+static bool sendRaw(IPAddress dst, uint16_t port, const uint8_t* data, uint16_t len) {
   if (!data || !len) return false;
+  TrexStats::noteTxMsg(data, len);
+  if (queueAggregate(dst, port, data, len)) return true;
 
-  IPAddress bcast(255, 255, 255, 255);
-  g_udp.beginPacket(bcast, UDP_PORT);
+  if (g_txCompact) {
+    uint8_t buf[253];
+    const uint16_t n = trexCompactFrame(data, len, buf, sizeof(buf));
+    if (n) return udpSend(dst, port, buf, n);
+  }
 
+  g_udp.beginPacket(dst, port);
+
+  bool ok;
   if (!g_txFramed) {
+    TrexCapture::tx(TREX_LINK_UDP, data, len);
     size_t n = g_udp.write(data, len);
-    g_udp.endPacket();
-    return n == len;
+    ok = g_udp.endPacket() && n == len;
+  } else {
+    uint8_t hdr[3] = {(uint8_t)TREX_WIRE_MAGIC0, (uint8_t)TREX_WIRE_MAGIC1, (uint8_t)TREX_WIRE_VERSION};
+    TrexCapture::tx(TREX_LINK_UDP, hdr, sizeof(hdr), data, len);
+    size_t n0 = g_udp.write(hdr, sizeof(hdr));
+    size_t n1 = g_udp.write(data, len);
+    ok = g_udp.endPacket() && (n0 == sizeof(hdr)) && (n1 == len);
+  }
+  if (ok) TrexStats::noteTxFrame((uint16_t)(len + (g_txFramed ? 3 : 0)));
+  else    TrexStats::noteTxErr(TrexStats::TXERR_OTHER);
+  return ok;
+}
+
+// Zero-copy path: wire header already sits in the frame's headroom, so the
+// whole datagram goes out in a single write.
+static bool sendFrame(IPAddress dst, uint16_t port, TxFrame& frame) {
+  if (frame.header()->payloadLen > TxFrame::kMaxPayload) {
+    TrexStats::noteTxErr(TrexStats::TXERR_OVERSIZE);
+    return false;
   }
+  const uint16_t msgLen = (uint16_t)(sizeof(MsgHeader) + frame.header()->payloadLen);
+  TrexStats::noteTxMsg((const uint8_t*)frame.header(), msgLen);
+  if (queueAggregate(dst, port, (const uint8_t*)frame.header(), msgLen)) return true;
+  uint16_t len = 0;
+  const uint8_t* wire = frame.wire(g_txFramed, len);
+  return udpSend(dst, port, wire, len);
+}
 
-  uint8_t hdr[3] = {(uint8_t)TREX_WIRE_MAGIC0, (uint8_t)TREX_WIRE_MAGIC1, (uint8_t)TREX_WIRE_VERSION};
-  size_t n0 = g_udp.write(hdr, sizeof(hdr));
-  size_t n1 = g_udp.write(data, len);
-  g_udp.endPacket();
-  return (n0 == sizeof(hdr)) && (n1 == len);
+bool UdpLink::sendToServer(const uint8_t* data, uint16_t len) {
+  uint16_t port;
+  const IPAddress dst = dstFor(0, port);
+  return sendRaw(dst, port, data, len);
 }
 
-bool sendToServer(const uint8_t* data, uint16_t len) {
-  return sendRaw(data, len);
+bool UdpLink::broadcast(const uint8_t* data, uint16_t len) {
+  return sendRaw(g_bcastDst, g_port, data, len);
 }
 
-bool broadcast(const uint8_t* data, uint16_t len) {
-  // Same as sendToServer in UDP mode: broadcast to everyone
-  return sendRaw(data, len);
+bool UdpLink::sendToStation(uint8_t stationId, const uint8_t* data, uint16_t len) {
+  uint16_t port;
+  const IPAddress dst = dstFor(stationId, port);
+  return sendRaw(dst, port, data, len);
 }
 
-void loop() {
-  int pktLen = g_udp.parsePacket();
-  if (pktLen <= 0) return;
+bool UdpLink::sendToServer(TxFrame& frame) {
+  uint16_t port;
+  const IPAddress dst = dstFor(0, port);
+  return sendFrame(dst, port, frame);
+}
 
-  uint8_t buf[512];
-  int n = g_udp.read(buf, (pktLen < (int)sizeof(buf)) ? pktLen : (int)sizeof(buf));
-  if (n > 0) {
-    deliverRx(buf, n);
+bool UdpLink::broadcast(TxFrame& frame) {
+  return sendFrame(g_bcastDst, g_port, frame);
+}
+
+bool UdpLink::sendToStation(uint8_t stationId, TxFrame& frame) {
+  uint16_t port;
+  const IPAddress dst = dstFor(stationId, port);
+  return sendFrame(dst, port, frame);
+}
+
+void UdpLink::loop() {
+  if (g_agg.due(millis())) flushAggregate();
+
+  // Drain what's queued, within budget, so backlog doesn't add a loop period
+  // of latency per packet. Oversize datagrams are skipped whole (the next
+  // parsePacket() discards the unread rest), never delivered truncated.
+  static uint8_t buf[TREX_NET_MAX_DATAGRAM];
+  const uint32_t t0 = micros();
+  for (int i = 0; i < TREX_NET_RX_BATCH; ++i) {
+    int pktLen = g_udp.parsePacket();
+    if (pktLen <= 0) break;
+    if (pktLen > (int)sizeof(buf)) {
+      TrexStats::noteRxDrop(TrexStats::RXDROP_OVERSIZE);
+    } else {
+      int n = g_udp.read(buf, pktLen);
+      if (n > 0) deliverRx(buf, n);
+    }
+    if ((uint32_t)(micros() - t0) >= TREX_NET_RX_BUDGET_US) break;
   }
 }
 
-} // namespace Transport
+uint32_t UdpLink::rxOverflowCount() {
+  return 0;  // polled from loop(); the socket buffer is the only queue
+}
+
 
 #endif // TREX_USE_UDP
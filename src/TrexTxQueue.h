@@ -0,0 +1,154 @@
+#pragma once
+// TrexTxQueue.h — bounded, allocation-free transmit scheduler.
+//
+// Frames wait in one FIFO per priority class; the backend takes the oldest
+// frame of the most urgent non-empty class whenever the driver has room
+// (in-flight count below the limit, decremented by the send-complete
+// callback). A full class refuses new frames without touching the others, so
+// a telemetry burst can never push a GAME_OVER out or delay it by more than
+// the frames already in flight.
+//
+// Single producer/consumer (the application task); only the in-flight count
+// and its progress time are touched from the Wi-Fi task, both atomics.
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "TrexProtocol.h"
+
+enum TrexTxClass : uint8_t {
+  TREX_TXC_CRITICAL = 0,   // game outcome / acks / control: never waits behind others
+  TREX_TXC_NORMAL,         // game state
+  TREX_TXC_BULK,           // heartbeats, telemetry, OTA progress and images
+  TREX_TXC_COUNT
+};
+
+inline TrexTxClass trexTxClassOf(uint8_t type) {
+  switch ((MsgType)type) {
+    case MsgType::GAME_OVER:
+    case MsgType::LOOT_HOLD_ACK:
+    case MsgType::LOOT_HOLD_START:
+    case MsgType::LOOT_HOLD_STOP:
+    case MsgType::DROP_RESULT:
+    case MsgType::CONTROL_CMD:
+    case MsgType::SERVER_CMD:
+    case MsgType::REL_ACK:
+    case MsgType::RADIO_CFG:
+    case MsgType::TIME_PING:   // queueing delay would skew the clock estimate
+    case MsgType::TIME_PONG:
+      return TREX_TXC_CRITICAL;
+    case MsgType::HELLO:
+    case MsgType::HEARTBEAT:
+    case MsgType::OTA_STATUS:
+    case MsgType::OTA_CHUNK:        // image stream yields to game traffic
+    case MsgType::STATS_SNAPSHOT:
+      return TREX_TXC_BULK;
+    default:
+      return TREX_TXC_NORMAL;
+  }
+}
+
+// Class of an outgoing message (MsgHeader.type is byte 1).
+inline TrexTxClass trexTxClassOf(const uint8_t* msg, uint16_t len) {
+  return len >= 2 ? trexTxClassOf(msg[1]) : TREX_TXC_NORMAL;
+}
+
+template <uint8_t Depth, uint16_t FrameBytes>
+class TrexTxQueue {
+  static_assert(Depth >= 1, "Depth must be at least 1");
+
+public:
+  struct Slot {
+    uint8_t  dst[6];
+    uint16_t len;
+    uint8_t  data[FrameBytes];
+  };
+
+  // Copies the frame in; false if its class is full or it doesn't fit.
+  bool push(TrexTxClass c, const uint8_t* dst, const uint8_t* data, uint16_t len) {
+    Fifo& q = q_[c];
+    if (len > FrameBytes || q.count >= Depth) return false;
+    Slot& s = q.slots[(uint8_t)((q.head + q.count) % Depth)];
+    memcpy(s.dst, dst, 6);
+    memcpy(s.data, data, len);
+    s.len = len;
+    ++q.count;
+    if (q.count > highWater_) highWater_ = q.count;
+    return true;
+  }
+
+  // Oldest frame of the most urgent non-empty class, or nullptr.
+  const Slot* front() const {
+    for (const Fifo& q : q_)
+      if (q.count) return &q.slots[q.head];
+    return nullptr;
+  }
+  void pop() {
+    for (Fifo& q : q_) {
+      if (!q.count) continue;
+      q.head = (uint8_t)((q.head + 1) % Depth);
+      --q.count;
+      return;
+    }
+  }
+
+  // Whether any queued frame is addressed to dst.
+  bool queuedFor(const uint8_t* dst) const {
+    for (const Fifo& q : q_)
+      for (uint8_t i = 0; i < q.count; ++i)
+        if (memcmp(q.slots[(uint8_t)((q.head + i) % Depth)].dst, dst, 6) == 0) return true;
+    return false;
+  }
+  // Points every queued frame for `from` at `to` (e.g. broadcast once the
+  // driver has forgotten `from`); returns how many were changed.
+  uint8_t readdress(const uint8_t* from, const uint8_t* to) {
+    uint8_t n = 0;
+    for (Fifo& q : q_)
+      for (uint8_t i = 0; i < q.count; ++i) {
+        Slot& s = q.slots[(uint8_t)((q.head + i) % Depth)];
+        if (memcmp(s.dst, from, 6) == 0) { memcpy(s.dst, to, 6); ++n; }
+      }
+    return n;
+  }
+
+  bool     empty() const            { return !front(); }
+  uint8_t  size(TrexTxClass c) const { return q_[c].count; }
+  uint8_t  highWater() const        { return highWater_; }
+  void     clear() { for (Fifo& q : q_) q.head = q.count = 0; }
+
+  // In-flight accounting: reserve() before handing a frame to the driver (the
+  // send callback may run before the driver call even returns), cancel() if
+  // the driver refused it, onComplete() from the send callback. stalled()
+  // lets the owner recover if completions stop arriving while frames are out.
+  bool canSend(uint8_t limit) const { return inFlight_.load(std::memory_order_acquire) < limit; }
+  void reserve(uint32_t nowMs) {
+    if (inFlight_.fetch_add(1, std::memory_order_acq_rel) == 0)
+      progressMs_.store(nowMs, std::memory_order_relaxed);
+  }
+  void cancel() { release(); }
+  void onComplete(uint32_t nowMs) {
+    progressMs_.store(nowMs, std::memory_order_relaxed);
+    release();
+  }
+  bool stalled(uint32_t nowMs, uint32_t timeoutMs) const {
+    return inFlight_.load(std::memory_order_acquire) &&
+           (uint32_t)(nowMs - progressMs_.load(std::memory_order_relaxed)) >= timeoutMs;
+  }
+  void resetInFlight() { inFlight_.store(0, std::memory_order_release); }
+  uint8_t inFlight() const { return inFlight_.load(std::memory_order_acquire); }
+
+private:
+  void release() {
+    uint8_t n = inFlight_.load(std::memory_order_relaxed);
+    while (n && !inFlight_.compare_exchange_weak(n, (uint8_t)(n - 1), std::memory_order_acq_rel)) {}
+  }
+
+  struct Fifo {
+    Slot    slots[Depth];
+    uint8_t head  = 0;
+    uint8_t count = 0;
+  };
+  Fifo q_[TREX_TXC_COUNT];
+  uint8_t highWater_ = 0;
+  std::atomic<uint32_t> progressMs_{0};   // last completion, or when the first frame went out
+  std::atomic<uint8_t>  inFlight_{0};
+};